@@ -2,18 +2,37 @@
 #include <GLFW/glfw3.h>
 
 #include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <random>
+#include <string>
 #include <vector>
 
 #include "utils/core.h"
+#include "utils/bvh.h"
+#include "utils/gl_state.h"
+#include "utils/instance_buffer.h"
 #include "utils/shader.h"
 #include "utils/camera.h"
 #include "utils/stb_image.h"
+#include "utils/light_markers.h"
 #include "utils/model.h"
+#include "utils/model_loader.h"
+#include "utils/occlusion_culler.h"
+#include "utils/render_queue.h"
+#include "utils/resolution_controller.h"
+#include "utils/software_occlusion.h"
+#include "utils/texture_registry.h"
+#include "utils/uniforms.h"
+#include "utils/texture_streamer.h"
+#include "utils/uniform_buffers.h"
 #include "utils/water_frame_buffers.h"
+#include "utils/water_view_cache.h"
 
 #include "utils/stb_image.h"
 
@@ -26,12 +45,27 @@
     6. Render 
 */
 
+// ----------- SCENE OBJECTS ----------- //
+// palm trees scattered over the island, see SCATTER PALM TREES
+const unsigned int kPalmTreeCount = 12;
+// objects of the scene bvh, by index: the island, the water, the point light's marker, then the palm trees
+const uint32_t kIslandObject = 0;
+const uint32_t kWaterObject = 1;
+const uint32_t kPointLightObject = 2;
+const uint32_t kPalmTreeObjects = 3;
+const uint32_t kNumSceneObjects = kPalmTreeObjects + kPalmTreeCount;
+// how far a click picks
+const float kPickDistance = 100.0f;
+// light the lit shaders can no longer show (1 / 256, under one step of an 8 bit channel)
+const float kLightCutoff = 1.0f / 256.0f;
+
 // ----------- FUNCTION HEADERS ----------- //
-void RenderScene(const std::vector<Model> models, Shader shader, glm::vec3 camera_pos, glm::mat4 view, glm::mat4 projection);
-void RenderWater(Shader shader, Model model, glm::mat4 view, glm::mat4 projection, unsigned int refl_tex_id, unsigned int refr_tex_id, unsigned int dudv_map_id, unsigned int normal_map_id);
+void RenderWater(const Shader &shader, const Model &model, glm::mat4 view, glm::mat4 projection, WaterFrameBuffers &water_fbos, const WaterViewCache &water_views, unsigned int dudv_map_id, unsigned int normal_map_id);
+bool ProjectWater(const Model &model, const glm::mat4 &view_projection, glm::vec4 &rect);
 void RenderWaterGui(Shader shader, unsigned int VAO, unsigned int texture_id, unsigned int index_offset);
 void RenderDebugAxes(Shader shader, unsigned int VAO);
-void RenderLightOrbs(Shader shader, Model model, glm::mat4 model_mat, glm::mat4 view, glm::mat4 projection, glm::vec3 light_color);
+float GetLightRange(float intensity, float constant, float linear, float quadratic);
+std::string GetSceneObjectName(uint32_t object);
 
 int main() 
 {
@@ -70,42 +104,102 @@ int main()
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
     //stbi_set_flip_vertically_on_load(true);
 
+    // where the water's refraction comes from: copied from the main pass rather than drawn again. R cycles
+    // through the modes, e.g. to REFRACTION_MODE_LAYERED, where reflection and refraction are drawn together by
+    // the LAYERED shaders.
+    eRefractionMode refraction_mode = REFRACTION_MODE_MAIN_PASS;
+    bool refraction_mode_key_held = false;
+    // redraw the water views in turns and reproject the stale one, rather than drawing both every frame
+    const bool cache_water_views = true;
+
     // ----------- CONSTRUCT SHADER PROGRAMS ----------- //
     Shader terrain_shader = Shader("src/shaders/terrain.vert", "src/shaders/terrain.frag");
+    Shader terrain_instanced_shader = Shader("src/shaders/terrain.vert", "src/shaders/terrain.frag", nullptr, "#define INSTANCED\n");
     Shader water_shader = Shader("src/shaders/water.vert", "src/shaders/water.frag");
+    Shader water_layered_shader = Shader("src/shaders/water.vert", "src/shaders/water.frag", nullptr, "#define LAYERED\n");
     Shader island_cap_refraction_shader = Shader("src/shaders/island-cap.vert", "src/shaders/island-cap.frag", "src/shaders/island-cap-refract.geom");
     Shader island_cap_reflection_shader = Shader("src/shaders/island-cap.vert", "src/shaders/island-cap.frag", "src/shaders/island-cap-reflect.geom");
+    Shader terrain_layered_shader = Shader("src/shaders/terrain.vert", "src/shaders/terrain.frag", "src/shaders/water-layers.geom", "#define LAYERED\n");
+    Shader terrain_instanced_layered_shader = Shader("src/shaders/terrain.vert", "src/shaders/terrain.frag", "src/shaders/water-layers.geom", "#define INSTANCED\n#define LAYERED\n");
+    Shader island_cap_layered_shader = Shader("src/shaders/island-cap.vert", "src/shaders/island-cap.frag", "src/shaders/island-cap-layers.geom", "#define LAYERED\n");
     Shader gui_debug_shader = Shader("src/shaders/gui.vert", "src/shaders/gui.frag");
     Shader axes_debug_shader("src/shaders/axes.vert", "src/shaders/axes.frag");
-    Shader light_orb_shader("src/shaders/light_orb.vert", "src/shaders/light_orb.frag");
+    Shader light_marker_shader("src/shaders/light_marker.vert", "src/shaders/light_marker.frag");
+    Shader occlusion_box_shader("src/shaders/occlusion_box.vert", "src/shaders/occlusion_box.frag");
 
-    const std::vector<Shader> lit_shaders = { terrain_shader, water_shader, island_cap_reflection_shader, island_cap_refraction_shader };
+    const std::vector<Shader> lit_shaders = { terrain_shader, terrain_instanced_shader, water_shader, island_cap_reflection_shader, island_cap_refraction_shader,
+                                              terrain_layered_shader, terrain_instanced_layered_shader, island_cap_layered_shader, water_layered_shader };
+    // the water is drawn by the one matching the refraction mode
+    const std::vector<Shader> water_shaders = { water_shader, water_layered_shader };
 
     // ----------- LOAD MODELS ----------- //
-    Model palm_tree("src/resources/models/palm_tree/palm-tree.obj");
+    // import all models in parallel, then upload them together on this thread. each model's vertices are packed
+    // for the attributes read by the shaders that draw it.
+    const unsigned int terrain_attributes = terrain_shader.getVertexAttributes();
+    const unsigned int island_attributes = terrain_attributes | island_cap_reflection_shader.getVertexAttributes();
+    std::vector<Model> loaded_models = LoadModels({
+        { "src/resources/models/palm_tree/palm-tree.obj", terrain_attributes | terrain_instanced_shader.getVertexAttributes() },
+        { "src/resources/models/island/island.obj", island_attributes },
+        { "src/resources/models/water/water.obj", water_shader.getVertexAttributes() | water_layered_shader.getVertexAttributes() }
+    });
+
+    Model palm_tree = loaded_models[0];
     glm::mat4 model = glm::mat4(1.0f);
     model = glm::scale(model, glm::vec3(0.25f, 0.25f, 0.25f));
     model = glm::translate(model, glm::vec3(-4.0f, 2.0f, 2.0f));
     palm_tree.SetModelMatrix(model);
     palm_tree.SetSpecularIntensity(1.0f);
 
-    Model island("src/resources/models/island/island.obj");
+    Model island = loaded_models[1];
     model = glm::mat4(1.0f);
     model = glm::scale(model, glm::vec3(2.0f));
     model = glm::translate(model, glm::vec3(0.0f, -10.0f, 0.0f));
     island.SetModelMatrix(model);
     island.SetSpecularIntensity(0.0f);
 
-    Model water("src/resources/models/water/water.obj");
+    Model water = loaded_models[2];
     model = glm::mat4(1.0f);
     model = glm::scale(model, glm::vec3(10.0f));
     water.SetModelMatrix(model);
     water.SetSpecularIntensity(1.0f);
 
-    Model light_orb("src/resources/models/light_orb/light_orb.obj");
+    // both are the island, object kIslandObject of the scene bvh
+    const std::vector<Model> terrain_models = { island };
+    const std::vector<Model> island_cap_models = { island };
+
+    // ----------- SCATTER PALM TREES ----------- //
+    // the original palm plus kPalmTreeCount - 1 copies around the island's crown, drawn in one instanced
+    // draw per mesh. fixed seed, so the scatter is the same every run.
+    std::vector<glm::mat4> palm_matrices = { palm_tree.model_matrix };
+    std::mt19937 palm_rng(1337);
+    std::uniform_real_distribution<float> palm_unit(0.0f, 1.0f);
+    while (palm_matrices.size() < kPalmTreeCount) {
+        float angle = palm_unit(palm_rng) * glm::two_pi<float>();
+        float distance = std::sqrt(palm_unit(palm_rng)) * 1.5f;
+        glm::vec3 position = glm::vec3(-1.4f, 0.5f, 0.4f) + distance * glm::vec3(std::cos(angle), 0.0f, std::sin(angle));
+        model = glm::translate(glm::mat4(1.0f), position);
+        model = glm::rotate(model, palm_unit(palm_rng) * glm::two_pi<float>(), glm::vec3(0.0f, 1.0f, 0.0f));
+        model = glm::scale(model, glm::vec3(0.15f + 0.1f * palm_unit(palm_rng)));
+        palm_matrices.push_back(model);
+    }
+    InstanceBuffer palm_instances;
+    palm_instances.Upload(palm_matrices);
+    palm_instances.Attach(palm_tree);
+
+    // ----------- BUILD SCENE BVH ----------- //
+    // over the world box of every scene object (see kIslandObject), so the passes only visit what is in view,
+    // and picking and light assignment only what is near. the point light moves, and is refit every frame.
+    std::vector<BoundingBox> object_boxes(kNumSceneObjects);
+    object_boxes[kIslandObject] = TransformBounds(island.bounds, island.model_matrix);
+    object_boxes[kWaterObject] = TransformBounds(water.bounds, water.model_matrix);
+    object_boxes[kPointLightObject] = BoundingBox{ glm::vec3(0.0f), glm::vec3(0.0f) };
+    for (unsigned int i = 0; i < kPalmTreeCount; i++)
+        object_boxes[kPalmTreeObjects + i] = TransformBounds(palm_tree.bounds, palm_matrices[i]);
+    Bvh scene_bvh;
+    scene_bvh.Build(object_boxes);
+    std::vector<uint32_t> lit_objects;
+    bool pick_held = false;
 
-    const std::vector<Model> terrain_models = { island, palm_tree };
-    
 
     // ----------- DEFINE LIGHTING UNIFORMS ----------- // 
 
@@ -125,10 +219,7 @@ int main()
     // point lights
     glm::vec3 light_position = glm::vec3(3.0f, 3.0f, -3.0f);
     glm::vec3 pl_position = light_position;
-    light_orb_shader.use();
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, pl_position);
-    light_orb_shader.setMat4("model", model);
+    float pl_marker_radius = 1.0f;
 
     glm::vec3 pl_ambient = glm::vec3(0.1f, 0.1f, 0.1f);
     glm::vec3 pl_diffuse = glm::vec3(1.0f, 0.2f, 0.0f);
@@ -156,56 +247,60 @@ int main()
     float sl_quadratic = 0.032f;
     float sl_inner_cut_off = glm::cos(glm::radians(12.5f));
     float sl_outer_cut_off = glm::cos(glm::radians(15.0f));
+    bool spot_light_on = sl_ambient + sl_diffuse + sl_specular != glm::vec3(0.0f);
 
 
     // ----------- SET LIGHTING UNIFORMS ----------- // 
     for (const Shader& shader : lit_shaders) {
-        // activate shader 
         shader.use();
-        // global
-        shader.setBool("directional_only", directional_only);
-        shader.setFloat("material.shininess", reflectivity);
-        // directional
-        shader.setVec3("directional_light.direction", dl_direction);
-        shader.setVec3("directional_light.ambient", dl_ambient);
-        shader.setVec3("directional_light.diffuse", dl_diffuse);
-        shader.setVec3("directional_light.specular", dl_specular);
-        // point lights
-        shader.setVec3("point_light[0].position", pl_position);
-        shader.setVec3("point_light[0].ambient", pl_ambient);
-        shader.setVec3("point_light[0].diffuse", pl_diffuse);
-        shader.setVec3("point_light[0].specular", pl_specular);
-        shader.setFloat("point_light[0].constant", pl_constant);
-        shader.setFloat("point_light[0].linear", pl_linear);
-        shader.setFloat("point_light[0].quadratic", pl_quadratic);
-        // spot lights
-        shader.setVec3("spot_light[0].position", sl_position);
-        shader.setVec3("spot_light[0].direction", sl_direction);
-        shader.setVec3("spot_light[0].ambient", sl_ambient);
-        shader.setVec3("spot_light[0].diffuse", sl_diffuse);
-        shader.setVec3("spot_light[0].specular", sl_specular);
-        shader.setFloat("spot_light[0].constant", sl_constant);
-        shader.setFloat("spot_light[0].linear", sl_linear);
-        shader.setFloat("spot_light[0].quadratic", sl_quadratic);
-        shader.setFloat("spot_light[0].inner_cut_off", sl_inner_cut_off);
-        shader.setFloat("spot_light[0].outer_cut_off", sl_outer_cut_off);
+        shader.setFloat(kUniformMaterialShininess, reflectivity);
     }
+    // every lit program reads the lights from one shared uniform buffer
+    LightingBlock lighting = {};
+    lighting.directional_only = directional_only;
+    // directional
+    lighting.directional_light.direction = dl_direction;
+    // point lights
+    lighting.point_lights[0].constant = pl_constant;
+    lighting.point_lights[0].linear = pl_linear;
+    lighting.point_lights[0].quadratic = pl_quadratic;
+    // spot lights
+    lighting.spot_lights[0].position = sl_position;
+    lighting.spot_lights[0].direction = sl_direction;
+    lighting.spot_lights[0].ambient = sl_ambient;
+    lighting.spot_lights[0].diffuse = sl_diffuse;
+    lighting.spot_lights[0].specular = sl_specular;
+    lighting.spot_lights[0].constant = sl_constant;
+    lighting.spot_lights[0].linear = sl_linear;
+    lighting.spot_lights[0].quadratic = sl_quadratic;
+    lighting.spot_lights[0].inner_cut_off = sl_inner_cut_off;
+    lighting.spot_lights[0].outer_cut_off = sl_outer_cut_off;
+    // camera and lighting uniform buffers, bound to the same binding points in every program
+    UniformBuffers uniform_buffers;
 
 
     // ----------- LOAD/SET WATER TEXTURES/BUFFERS ----------- // 
-    // set texure unit uniforms
-    water_shader.use();
-    water_shader.setInt("reflection_texture", 0);
-    water_shader.setInt("refraction_texture", 1);
-    water_shader.setInt("dudv_map", 2);
-    water_shader.setInt("normal_map", 3);
-    // load dudv and normal textures 
-    unsigned int water_dudv = TextureFromFile("src/resources/textures/water/dudv.png", ".");
-    unsigned int water_normal = TextureFromFile("src/resources/textures/water/normal.png", ".");
+    // set texure unit uniforms and the static model matrix
+    for (const Shader &shader : water_shaders) {
+        shader.use();
+        shader.setInt(kUniformReflectionTexture, 0);
+        shader.setInt(kUniformRefractionTexture, 1);
+        shader.setInt(kUniformDudvMap, 2);
+        shader.setInt(kUniformNormalMap, 3);
+        shader.setInt(kUniformRefractionDepthTexture, 4);
+        shader.setMat4(kUniformModel, water.model_matrix);
+    }
+    // load dudv and normal textures (asynchronously)
+    TextureHandle water_dudv = g_texture_registry.Acquire("src/resources/textures/water/dudv.png", ".", TEXTURE_USAGE_TWO_CHANNEL);
+    TextureHandle water_normal = g_texture_registry.Acquire("src/resources/textures/water/normal.png", ".");
     // init water frame buffers 
-    WaterFrameBuffers(water_fbos);
-    // set static model matrix uniform 
-    water_shader.setMat4("model", water.model_matrix);
+    WaterFrameBuffers water_fbos(refraction_mode);
+    // scales the water targets to keep the water passes within their gpu budget
+    ResolutionController water_resolution(kWaterGpuBudgetMs, kWaterMinScale, kWaterMaxScale, kWaterStartScale);
+    // picks the water views to redraw each frame
+    WaterViewCache water_views(refraction_mode, cache_water_views);
+    // instanced point light markers
+    LightMarkers light_markers;
 
 
     // ----------- DEBUG WATER GUI ----------- //
@@ -234,7 +329,7 @@ int main()
     glGenVertexArrays(1, &VAO_WGUI);
     glGenBuffers(1, &VBO_WGUI);
     glGenBuffers(1, &EBO_WGUI);
-    glBindVertexArray(VAO_WGUI);
+    g_gl_state.BindVertexArray(VAO_WGUI);
     // configure vertex buffer
     glBindBuffer(GL_ARRAY_BUFFER, VBO_WGUI);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vd_gui), vd_gui, GL_STATIC_DRAW);
@@ -249,10 +344,10 @@ int main()
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO_WGUI);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(i_gui), i_gui, GL_STATIC_DRAW);
     // unbind VAO_WGUI
-    glBindVertexArray(0);
+    g_gl_state.BindVertexArray(0);
     // set texture unit uniform 
     gui_debug_shader.use();
-    gui_debug_shader.setInt("texture_id", 0);
+    gui_debug_shader.setInt(kUniformTextureId, 0);
 
 
     // ----------- DEBUG AXES ----------- //
@@ -272,7 +367,7 @@ int main()
     glGenVertexArrays(1, &VAO_AX);
     glGenBuffers(1, &VBO_AX);
     // bind vertex array object 
-    glBindVertexArray(VAO_AX);
+    g_gl_state.BindVertexArray(VAO_AX);
     // configure vertex buffer 
     glBindBuffer(GL_ARRAY_BUFFER, VBO_AX);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vd_axes), vd_axes, GL_STATIC_DRAW);
@@ -280,12 +375,21 @@ int main()
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0); 
     glEnableVertexAttribArray(0);
     // unbind 
-    glBindVertexArray(0);
+    g_gl_state.BindVertexArray(0);
     // set static model uniform 
     axes_debug_shader.use();
     glm::mat4 model_axes = glm::mat4(1.0f);
     model_axes = glm::scale(model_axes, glm::vec3(10.0f));
-    axes_debug_shader.setMat4("model", model_axes);
+    axes_debug_shader.setMat4(kUniformModel, model_axes);
+
+
+    // draws of every pass, sorted by gl state
+    RenderQueue render_queue;
+    OcclusionCuller occlusion_culler(occlusion_box_shader);
+    // the island hides much of the scene from the main camera; drawn on the cpu before the main pass is queued
+    SoftwareOcclusion software_occlusion;
+    software_occlusion.AddOccluder(terrain_models[0]);
+    render_queue.SetSoftwareOcclusion(RENDER_PASS_MAIN, &software_occlusion);
 
 
     // ----------- SET GLOBAL STATES ----------- //
@@ -304,47 +408,68 @@ int main()
 
         // handle user input 
         ProcessInput(g_window);
+        // R switches to the next refraction mode; the new mode's targets start out undefined, like new ones
+        bool refraction_mode_key = glfwGetKey(g_window, GLFW_KEY_R) == GLFW_PRESS;
+        bool refraction_mode_changed = false;
+        if (refraction_mode_key && !refraction_mode_key_held) {
+            refraction_mode = static_cast<eRefractionMode>((refraction_mode + 1) % NUM_REFRACTION_MODES);
+            refraction_mode_changed = water_fbos.SetRefractionMode(refraction_mode);
+            water_views.SetRefractionMode(refraction_mode);
+            std::cout << "WATER:: refraction mode: " << kRefractionModeNames[refraction_mode] << std::endl;
+        }
+        refraction_mode_key_held = refraction_mode_key;
+
+        // upload any textures that finished decoding in the background
+        g_texture_streamer.Update();
 
         // update float oscillator
         osc = (cos(g_current_frame * day_speed) + 1.0f) / 2.0f;
 
         // day simulation
-        for (const Shader& shader : lit_shaders) {
-            shader.use();
-            // update directional light output 
-            glm::vec3 dl_new_ambient = dl_ambient * osc;
-            glm::vec3 dl_new_diffuse = dl_diffuse * osc;
-            glm::vec3 dl_new_specular = dl_specular * osc;
-            shader.setVec3("directional_light.ambient", dl_new_ambient);
-            shader.setVec3("directional_light.diffuse", dl_new_diffuse);
-            shader.setVec3("directional_light.specular", dl_new_specular);
-            // update point light output 
-            glm::vec3 pl_new_ambient = pl_ambient * (1.0f - osc);
-            glm::vec3 pl_new_diffuse = pl_diffuse * (1.0f - osc);
-            glm::vec3 pl_new_specular = pl_specular * (1.0f - osc);
-            shader.setVec3("poin_light[0].ambient", pl_new_ambient);
-            shader.setVec3("point_light[0].diffuse", pl_new_diffuse);
-            shader.setVec3("point_light[0].specular", pl_new_specular);
-        }
+        // update directional light output 
+        lighting.directional_light.ambient = dl_ambient * osc;
+        lighting.directional_light.diffuse = dl_diffuse * osc;
+        lighting.directional_light.specular = dl_specular * osc;
+        // update point light output 
+        lighting.point_lights[0].ambient = pl_ambient * (1.0f - osc);
+        lighting.point_lights[0].diffuse = pl_diffuse * (1.0f - osc);
+        lighting.point_lights[0].specular = pl_specular * (1.0f - osc);
 
         // update position of point light 
         pl_position.y = light_position.y - (osc * 6.0f);
-        glm::mat4 light_orb_model_mat = glm::mat4(1.0f);
-        light_orb_model_mat = glm::translate(light_orb_model_mat, pl_position);
-      
-
-        // enable clipping 
-        glEnable(GL_CLIP_DISTANCE0);
+        lighting.point_lights[0].position = pl_position;
+        std::vector<LightMarker> light_marker_data = { { pl_position, pl_marker_radius, pl_diffuse, 0.0f } };
+        // its marker moves with it
+        scene_bvh.SetObjectBox(kPointLightObject, BoundingBox{ pl_position, glm::vec3(pl_marker_radius) });
+        scene_bvh.Refit();
+
+        // light assignment: when the point light reaches none of the lit objects (it fades out by day) and the
+        // spot light is off, the lit shaders skip both
+        glm::vec3 pl_peak = lighting.point_lights[0].ambient + lighting.point_lights[0].diffuse + lighting.point_lights[0].specular;
+        float pl_range = GetLightRange(std::max(pl_peak.r, std::max(pl_peak.g, pl_peak.b)), pl_constant, pl_linear, pl_quadratic);
+        lit_objects.clear();
+        scene_bvh.QuerySphere(pl_position, pl_range, lit_objects);
+        bool point_light_reaches = false;
+        for (uint32_t object : lit_objects)
+            point_light_reaches = point_light_reaches || object != kPointLightObject;
+        lighting.directional_only = directional_only || (!point_light_reaches && !spot_light_on);
+
+        // a click picks the object whose box is first under the crosshair, at the view's center as the cursor
+        // is captured
+        bool pick_pressed = glfwGetMouseButton(g_window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+        if (pick_pressed && !pick_held) {
+            BvhHit hit;
+            if (scene_bvh.Raycast(g_camera.position_, g_camera.front_, kPickDistance, hit))
+                std::cout << "PICKING:: " << GetSceneObjectName(hit.object) << " at " << hit.distance << std::endl;
+            else
+                std::cout << "PICKING:: nothing within " << kPickDistance << std::endl;
+        }
+        pick_held = pick_pressed;
 
         // retrieve view matrix 
         glm::mat4 view_mat = g_camera.GetViewMatrix();
         // retrieve projection matrix
-        glm::mat4 projection_mat = glm::perspective(glm::radians(g_camera.zoom_), (float)g_screen_width / (float)g_screen_height, 0.1f, 100.0f);
-
-        
-        // --- RENDER SCENE TO REFLECTION BUFFER --- //
-        // activate terrain shader 
-        terrain_shader.use();
+        glm::mat4 projection_mat = glm::perspective(glm::radians(g_camera.zoom_), (float)g_screen_width_p / (float)g_screen_height_p, 0.1f, 100.0f);
         // calculate reflected camera position 
         glm::vec3 reflected_camera_pos = glm::vec3(g_camera.position_.x, -g_camera.position_.y, g_camera.position_.z);
         // calculate reflected camera target/front 
@@ -352,157 +477,276 @@ int main()
         reflected_target.y = -reflected_target.y;
         // calculate reflected view matrix 
         glm::mat4 reflection_view_mat = glm::lookAt(reflected_camera_pos, reflected_target, glm::vec3(0.0f, 1.0f, 0.0f));
-        // define reflection clip plane and set uniform
+        // define clip planes 
         glm::vec4 reflection_clip_plane = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
-        terrain_shader.setVec4("clip_plane", reflection_clip_plane);
-        // bind reflection framebuffer and render terrain
-        water_fbos.BindReflectionFrameBuffer();
-        // glClearColor(0.0f, 0.0f, 0.6f, 0.5f);
-        //glClearColor(0.2f, 0.0f, 0.2f, 1.0f); 
-        //glClearColor(0.0f, 0.0f, 0.0f, 1.0f); 
-        glClearColor(sky_color.r * osc, sky_color.g * osc, sky_color.b * osc, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        RenderScene(terrain_models, terrain_shader, reflected_camera_pos, reflection_view_mat, projection_mat);
-        // render island reflection cap
-        island_cap_reflection_shader.use();
-        island_cap_reflection_shader.setVec4("clip_plane", reflection_clip_plane);
-        RenderScene({island}, island_cap_reflection_shader, reflected_camera_pos, reflection_view_mat, projection_mat);
-        // unbind reflection framebuffer  
-        water_fbos.UnbindCurrentFrameBuffer();
+        glm::vec4 refraction_clip_plane = glm::vec4(0.0f, -1.0f, 0.0f, 0.0f);
+
+        // upload every view and the lighting once for the whole frame
+        uniform_buffers.SetCamera(CAMERA_VIEW_MAIN, view_mat, projection_mat, g_camera.position_);
+        uniform_buffers.SetCamera(CAMERA_VIEW_REFLECTION, reflection_view_mat, projection_mat, reflected_camera_pos, reflection_clip_plane);
+        uniform_buffers.SetCamera(CAMERA_VIEW_REFRACTION, view_mat, projection_mat, g_camera.position_, refraction_clip_plane);
+        uniform_buffers.SetLighting(lighting);
+        uniform_buffers.Upload();
+
+        // where the water lands in each view: out of sight, it is neither drawn nor are its views; otherwise
+        // their draws are cropped to it. the surface itself is left to the depth test, but its views are
+        // skipped while the software occluders hide all of it.
+        software_occlusion.Render(projection_mat * view_mat);
+        glm::vec4 refraction_rect = kWaterFullRect, reflection_rect = kWaterFullRect;
+        bool water_visible = ProjectWater(water, projection_mat * view_mat, refraction_rect);
+        bool water_views_visible = water_visible && software_occlusion.IsBoxVisible(TransformBounds(water.bounds, water.model_matrix));
+        if (water_views_visible)
+            ProjectWater(water, projection_mat * reflection_view_mat, reflection_rect);
+        // one scissor covers both layers
+        glm::vec4 water_layers_rect = glm::vec4(glm::min(glm::vec2(reflection_rect), glm::vec2(refraction_rect)),
+                                                glm::max(glm::vec2(reflection_rect.z, reflection_rect.w), glm::vec2(refraction_rect.z, refraction_rect.w)));
+
+        // follow the window size and draw the water targets at this frame's resolution, then pick the water
+        // views to redraw; the others keep last frame's textures
+        bool water_targets_replaced = water_fbos.Update(water_resolution.GetScale());
+        water_views.BeginFrame(g_camera.position_, g_camera.front_, water_views_visible, water_targets_replaced || refraction_mode_changed);
+        bool render_water_layers = refraction_mode == REFRACTION_MODE_LAYERED && water_views.IsDue(WATER_LAYER_REFLECTION);
+        bool render_reflection = refraction_mode != REFRACTION_MODE_LAYERED && water_views.IsDue(WATER_LAYER_REFLECTION);
+        bool render_refraction = refraction_mode == REFRACTION_MODE_RENDER && water_views.IsDue(WATER_LAYER_REFRACTION);
+        bool render_water_views = render_water_layers || render_reflection || render_refraction;
+
+        // queue the scene for every pass; the caps are drawn with the terrain of their pass. draws are culled
+        // against the clip plane of their pass, except the refraction caps: their geometry shader flattens
+        // what is above the water onto it, so only what is entirely below (reflection's clipped side) goes.
+        if (render_water_layers) {
+            // both water views in one pass; the caps cull by the reflection plane in both, as in their own passes
+            RenderLayers water_layers = { { reflection_view_mat, view_mat }, { reflection_clip_plane, refraction_clip_plane }, NUM_WATER_LAYERS };
+            RenderLayers cap_layers = { { reflection_view_mat, view_mat }, { reflection_clip_plane, reflection_clip_plane }, NUM_WATER_LAYERS };
+            render_queue.Add(RENDER_PASS_WATER_LAYERS, terrain_layered_shader, terrain_models, scene_bvh, kIslandObject, water_layers, projection_mat);
+            render_queue.AddInstanced(RENDER_PASS_WATER_LAYERS, terrain_instanced_layered_shader, palm_tree, palm_instances, scene_bvh, kPalmTreeObjects, water_layers, projection_mat);
+            render_queue.Add(RENDER_PASS_WATER_LAYERS, island_cap_layered_shader, island_cap_models, scene_bvh, kIslandObject, cap_layers, projection_mat);
+        }
+        if (render_reflection) {
+            render_queue.Add(RENDER_PASS_REFLECTION, terrain_shader, terrain_models, scene_bvh, kIslandObject, reflection_view_mat, projection_mat, reflection_clip_plane);
+            render_queue.AddInstanced(RENDER_PASS_REFLECTION, terrain_instanced_shader, palm_tree, palm_instances, scene_bvh, kPalmTreeObjects, reflection_view_mat, projection_mat, reflection_clip_plane);
+            render_queue.Add(RENDER_PASS_REFLECTION, island_cap_reflection_shader, island_cap_models, scene_bvh, kIslandObject, reflection_view_mat, projection_mat, reflection_clip_plane);
+        }
+        if (render_refraction) {
+            render_queue.Add(RENDER_PASS_REFRACTION, terrain_shader, terrain_models, scene_bvh, kIslandObject, view_mat, projection_mat, refraction_clip_plane);
+            render_queue.AddInstanced(RENDER_PASS_REFRACTION, terrain_instanced_shader, palm_tree, palm_instances, scene_bvh, kPalmTreeObjects, view_mat, projection_mat, refraction_clip_plane);
+            render_queue.Add(RENDER_PASS_REFRACTION, island_cap_refraction_shader, island_cap_models, scene_bvh, kIslandObject, view_mat, projection_mat, reflection_clip_plane);
+        }
+        render_queue.Add(RENDER_PASS_MAIN, terrain_shader, terrain_models, scene_bvh, kIslandObject, view_mat, projection_mat);
+        render_queue.AddInstanced(RENDER_PASS_MAIN, terrain_instanced_shader, palm_tree, palm_instances, scene_bvh, kPalmTreeObjects, view_mat, projection_mat);
+        render_queue.Sort();
+
+        // frames drawing no water view are not timed, they would read as free
+        if (render_water_views)
+            water_resolution.BeginTiming();
+
+        // enable clipping 
+        glEnable(GL_CLIP_DISTANCE0);
+
+        // --- RENDER SCENE TO BOTH WATER LAYERS --- //
+        if (render_water_layers) {
+            // the layered shaders read both cameras from the WaterCameras block
+            water_fbos.BindLayeredFrameBuffer(water_layers_rect);
+            glClearColor(sky_color.r * osc, sky_color.g * osc, sky_color.b * osc, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            // the occlusion culler tests a box from a single view, so layered draws are not wrapped
+            render_queue.Submit(RENDER_PASS_WATER_LAYERS);
+            water_fbos.UnbindCurrentFrameBuffer();
+            water_views.MarkDrawn(WATER_LAYER_REFLECTION, projection_mat * reflection_view_mat);
+            water_views.MarkDrawn(WATER_LAYER_REFRACTION, projection_mat * view_mat);
+        }
 
         // --- RENDER SCENE TO REFLECTION BUFFER --- //
-        // activate terrain shader 
-        terrain_shader.use();
-        // define refraction clip plane and set uniform
-        glm::vec4 refraction_clip_plane = glm::vec4(0.0f, -1.0f, 0.0f, 0.0f);
-        terrain_shader.setVec4("clip_plane", refraction_clip_plane);
-        // bind refraction framebuffer and render terrain
-        water_fbos.BindRefractionFrameBuffer();
-        // glClearColor(0.0f, 0.0f, 0.6f, 0.5f); 
-        //glClearColor(0.2f, 0.0f, 0.2f, 1.0f); 
-        //glClearColor(0.0f, 0.0f, 0.0f, 1.0f); 
-        glClearColor(sky_color.r * osc, sky_color.g * osc, sky_color.b * osc, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        RenderScene(terrain_models, terrain_shader, g_camera.position_, view_mat, projection_mat);
-        // render island refraction cap
-        island_cap_refraction_shader.use();
-        island_cap_refraction_shader.setVec4("clip_plane", refraction_clip_plane);
-        RenderScene({island}, island_cap_refraction_shader, g_camera.position_, view_mat, projection_mat);
-        // unbind refraction framebuffer 
-        water_fbos.UnbindCurrentFrameBuffer();
+        if (render_reflection) {
+            uniform_buffers.BindCamera(CAMERA_VIEW_REFLECTION);
+            // bind reflection framebuffer and render terrain
+            water_fbos.BindReflectionFrameBuffer(reflection_rect);
+            // glClearColor(0.0f, 0.0f, 0.6f, 0.5f);
+            //glClearColor(0.2f, 0.0f, 0.2f, 1.0f); 
+            //glClearColor(0.0f, 0.0f, 0.0f, 1.0f); 
+            glClearColor(sky_color.r * osc, sky_color.g * osc, sky_color.b * osc, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            render_queue.Submit(RENDER_PASS_REFLECTION, &occlusion_culler);
+            occlusion_culler.IssueQueries(RENDER_PASS_REFLECTION, reflected_camera_pos);
+            // unbind reflection framebuffer  
+            water_fbos.UnbindCurrentFrameBuffer();
+            water_views.MarkDrawn(WATER_LAYER_REFLECTION, projection_mat * reflection_view_mat);
+        }
+
+        // --- RENDER SCENE TO REFLECTION BUFFER --- //
+        if (render_refraction) {
+            uniform_buffers.BindCamera(CAMERA_VIEW_REFRACTION);
+            // bind refraction framebuffer and render terrain
+            water_fbos.BindRefractionFrameBuffer(refraction_rect);
+            // glClearColor(0.0f, 0.0f, 0.6f, 0.5f); 
+            //glClearColor(0.2f, 0.0f, 0.2f, 1.0f); 
+            //glClearColor(0.0f, 0.0f, 0.0f, 1.0f); 
+            glClearColor(sky_color.r * osc, sky_color.g * osc, sky_color.b * osc, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            render_queue.Submit(RENDER_PASS_REFRACTION, &occlusion_culler);
+            occlusion_culler.IssueQueries(RENDER_PASS_REFRACTION, g_camera.position_);
+            // unbind refraction framebuffer 
+            water_fbos.UnbindCurrentFrameBuffer();
+            water_views.MarkDrawn(WATER_LAYER_REFRACTION, projection_mat * view_mat);
+        }
 
         // disable clipping 
         glDisable(GL_CLIP_DISTANCE0);
+        if (render_water_views)
+            water_resolution.EndTiming();
 
         // --- RENDER SCENE --- //
+        uniform_buffers.BindCamera(CAMERA_VIEW_MAIN);
+        water_fbos.BindSceneFrameBuffer();
         //glClearColor(0.2f, 0.0f, 0.2f, 1.0f); 
         //glClearColor(0.0f, 0.0f, 0.0f, 1.0f); 
         glClearColor(sky_color.r * osc, sky_color.g * osc, sky_color.b * osc, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        RenderScene(terrain_models, terrain_shader, g_camera.position_, view_mat, projection_mat);
+        render_queue.Submit(RENDER_PASS_MAIN, &occlusion_culler);
+        occlusion_culler.IssueQueries(RENDER_PASS_MAIN, g_camera.position_);
+        // the opaque scene is the refraction, unless it was rendered above
+        if (refraction_mode == REFRACTION_MODE_MAIN_PASS && water_views.IsDue(WATER_LAYER_REFRACTION)) {
+            water_fbos.CopySceneToRefraction(refraction_rect);
+            water_views.MarkDrawn(WATER_LAYER_REFRACTION, projection_mat * view_mat);
+        }
         
         // --- RENDER WATER --- //
-        RenderWater(water_shader, water, view_mat, projection_mat, water_fbos.GetReflectionTexture(), water_fbos.GetRefractionTexture(), water_dudv, water_normal);
+        if (water_visible)
+            RenderWater(refraction_mode == REFRACTION_MODE_LAYERED ? water_layered_shader : water_shader, water, view_mat, projection_mat, water_fbos, water_views, water_dudv.GetId(), water_normal.GetId());
 
-        // --- RENDER LIGHT ORBS --- //
+        // --- RENDER LIGHT MARKERS --- //
         if (!directional_only)
-            RenderLightOrbs(light_orb_shader, light_orb, light_orb_model_mat, view_mat, projection_mat, pl_diffuse);
+            light_markers.Draw(light_marker_shader, light_marker_data);
+        water_fbos.ResolveSceneFrameBuffer();
 
         // DEBUG - water texture guis and axes 
         // RenderWaterGui(gui_debug_shader, VAO_WGUI, water_fbos.GetReflectionTexture(), 0);
         // RenderWaterGui(gui_debug_shader, VAO_WGUI, water_fbos.GetRefractionTexture(), 6);
         // RenderDebugAxes(axes_debug_shader, VAO_AX);
 
+        render_queue.EndFrame();
+        occlusion_culler.EndFrame();
+        software_occlusion.EndFrame();
+        water_resolution.EndFrame();
+        water_views.EndFrame();
+        g_gl_state.EndFrame();
+
         // swap frame and output buffers
         glfwSwapBuffers(g_window);
         // check for I/O events 
         glfwPollEvents();
     }
     // ----------- FREE RESOURCES ----------- //
-    glDeleteVertexArrays(1, &VAO_WGUI);
-    glDeleteVertexArrays(1, &VAO_AX);
+    g_gl_state.DeleteVertexArray(VAO_WGUI);
+    g_gl_state.DeleteVertexArray(VAO_AX);
     glDeleteBuffers(1, &VBO_WGUI);
     glDeleteBuffers(1, &VBO_AX);
     water_fbos.CleanUp();
+    water_resolution.CleanUp();
+    light_markers.CleanUp();
+    uniform_buffers.CleanUp();
+    palm_instances.CleanUp();
+    occlusion_culler.CleanUp();
+    render_queue.PrintStats();
+    occlusion_culler.PrintStats();
+    software_occlusion.PrintStats();
+    water_resolution.PrintStats();
+    water_views.PrintStats();
+    g_gl_state.PrintStats();
+    g_texture_registry.PrintStats();
+    g_texture_registry.Shutdown();
+    g_texture_streamer.Shutdown();
     // free glfw resources 
     glfwTerminate();
     return 0; 
 }
 
-/*
-    Render specified models to the actvive frame buffer.
-*/
-void RenderScene(const std::vector<Model> models, Shader shader, glm::vec3 camera_pos, glm::mat4 view, glm::mat4 projection) {
-
-    shader.use();
-
-    shader.setVec3("camera_pos", camera_pos);
-
-    shader.setMat4("view", view);
-
-    shader.setMat4("projection", projection);
-
-    // render models 
-    for (const Model& model : models) {
-        // set model matrix uniform 
-        shader.setMat4("model", model.model_matrix);
-        // compute/set normal matrix uniform 
-        glm::mat3 normal = glm::mat3(glm::transpose(glm::inverse(model.model_matrix)));
-        shader.setMat3("normal", normal);
-
-        shader.setFloat("specular_intenstiy", model.specular_intensity);
-
-        // draw model
-        model.Draw(shader);
-    }
-}
-
 /*
     Render water model to the active frame buffer.
 */
-void RenderWater(Shader shader, Model model, glm::mat4 view, glm::mat4 projection,
-                 unsigned int refl_tex_id, unsigned int refr_tex_id, unsigned int dudv_map_id, unsigned int normal_map_id) {
+void RenderWater(const Shader &shader, const Model &model, glm::mat4 view, glm::mat4 projection, WaterFrameBuffers &water_fbos,
+                 const WaterViewCache &water_views, unsigned int dudv_map_id, unsigned int normal_map_id) {
 
     shader.use();
-
-    shader.setVec3("camera_pos", g_camera.position_);
-
-    shader.setMat4("view", view);
-
-    shader.setMat4("projection", projection);
+    GLenum water_target = water_fbos.GetTextureTarget();
 
     // bind reflection texture 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, refl_tex_id);
-    shader.setInt("reflection_texture", 0);
+    g_gl_state.BindTextureUnit(0, water_target, water_fbos.GetReflectionTexture());
+    shader.setInt(kUniformReflectionTexture, 0);
     // bind refraction texture 
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, refr_tex_id);
-    shader.setInt("refraction_texture", 1);
+    g_gl_state.BindTextureUnit(1, water_target, water_fbos.GetRefractionTexture());
+    shader.setInt(kUniformRefractionTexture, 1);
     // bind dudv map texture 
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, dudv_map_id);
-    shader.setInt("dudv_map", 2);
+    g_gl_state.BindTextureUnit(2, GL_TEXTURE_2D, dudv_map_id);
+    shader.setInt(kUniformDudvMap, 2);
     // bind normal map texture 
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, normal_map_id);
-    shader.setInt("normal_map", 3);
+    g_gl_state.BindTextureUnit(3, GL_TEXTURE_2D, normal_map_id);
+    shader.setInt(kUniformNormalMap, 3);
+    // bind refraction depth texture 
+    g_gl_state.BindTextureUnit(4, water_target, water_fbos.GetRefractionDepthTexture());
+    shader.setInt(kUniformRefractionDepthTexture, 4);
+    // part of the targets drawn at this frame's resolution
+    glm::vec2 refl_uv_scale = water_fbos.GetReflectionUvScale();
+    glm::vec2 refr_uv_scale = water_fbos.GetRefractionUvScale();
+    shader.setVec2(kUniformReflectionUvScale, refl_uv_scale);
+    shader.setVec2(kUniformRefractionUvScale, refr_uv_scale);
+    glm::vec4 refl_uv_bounds = water_fbos.GetReflectionUvBounds();
+    glm::vec4 refr_uv_bounds = water_fbos.GetRefractionUvBounds();
+    shader.setVec4(kUniformReflectionUvBounds, refl_uv_bounds);
+    shader.setVec4(kUniformRefractionUvBounds, refr_uv_bounds);
+    // cameras the textures were drawn from, to reproject the surface into them
+    shader.setMat4(kUniformReflectionViewProjection, water_views.GetViewProjection(WATER_LAYER_REFLECTION));
+    shader.setMat4(kUniformRefractionViewProjection, water_views.GetViewProjection(WATER_LAYER_REFRACTION));
     // update dudv/normal sampling offset 
     g_movement_factor = fmod(g_current_frame * g_wave_speed, 1.0f);
-    shader.setFloat("sampling_offset", g_movement_factor);
+    shader.setFloat(kUniformSamplingOffset, g_movement_factor);
 
-    shader.setFloat("specular_intenstiy", model.specular_intensity);
+    shader.setFloat(kUniformSpecularIntensity, model.specular_intensity);
 
     // render water 
-    model.Draw(shader);
+    model.Draw(shader, view, projection);
+}
+
+/*
+    Where the water model lands on screen through view_projection, as a
+    rect in texture coordinates (see ProjectBox()). False if it is outside
+    the view.
+*/
+bool ProjectWater(const Model &model, const glm::mat4 &view_projection, glm::vec4 &rect) {
+    BoundingBox box = TransformBounds(model.bounds, model.model_matrix);
+    if (!IsBoxVisible(ExtractFrustum(view_projection), box))
+        return false;
+    return ProjectBox(box, view_projection, rect);
+}
+
+/*
+    Distance at which a point light of the given peak intensity (its
+    brightest channel) and attenuation fades below kLightCutoff, the root
+    of intensity / (constant + linear * d + quadratic * d^2) = kLightCutoff.
+    0 if it never reaches that.
+*/
+float GetLightRange(float intensity, float constant, float linear, float quadratic) {
+    float c = constant - intensity / kLightCutoff;
+    if (c >= 0.0f)
+        return 0.0f;
+    if (quadratic <= 0.0f)
+        return linear > 0.0f ? -c / linear : kPickDistance;
+    return (-linear + std::sqrt(linear * linear - 4.0f * quadratic * c)) / (2.0f * quadratic);
+}
+
+std::string GetSceneObjectName(uint32_t object) {
+    switch (object) {
+    case kIslandObject: return "island";
+    case kWaterObject: return "water";
+    case kPointLightObject: return "point light";
+    default: return "palm tree " + std::to_string(object - kPalmTreeObjects);
+    }
 }
 
 void RenderWaterGui(Shader shader, unsigned int VAO, unsigned int texture_id, unsigned int index_offset) {
     glDisable(GL_DEPTH_TEST);
     shader.use();
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture_id);
-    glBindVertexArray(VAO);
+    g_gl_state.BindTextureUnit(0, GL_TEXTURE_2D, texture_id);
+    g_gl_state.BindVertexArray(VAO);
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void*)(index_offset * sizeof(GLuint)));
     glEnable(GL_DEPTH_TEST);
 }
@@ -510,30 +754,16 @@ void RenderWaterGui(Shader shader, unsigned int VAO, unsigned int texture_id, un
 void RenderDebugAxes(Shader shader, unsigned int VAO) {
     // bind axes shader program
     shader.use();
-    // update dynamic matrix uniforms 
-    glm::mat4 projection = glm::perspective(glm::radians(g_camera.zoom_), (float)g_screen_width / (float)g_screen_height, 0.1f, 100.0f);
-    shader.setMat4("projection", projection);
-    glm::mat4 view = g_camera.GetViewMatrix();
-    shader.setMat4("view", view);
     // x axis
-    shader.setVec3("axisColor", 1.0f, 0.0f, 0.0f);
-    glBindVertexArray(VAO);
+    shader.setVec3(kUniformAxisColor, 1.0f, 0.0f, 0.0f);
+    g_gl_state.BindVertexArray(VAO);
     glDrawArrays(GL_LINES, 0, 2);
     // y axis 
-    shader.setVec3("axisColor", 0.0f, 1.0f, 0.0f);
-    glBindVertexArray(VAO);
+    shader.setVec3(kUniformAxisColor, 0.0f, 1.0f, 0.0f);
+    g_gl_state.BindVertexArray(VAO);
     glDrawArrays(GL_LINES, 2, 2);
     // z axis 
-    shader.setVec3("axisColor", 0.0f, 0.0f, 1.0f);
-    glBindVertexArray(VAO);
+    shader.setVec3(kUniformAxisColor, 0.0f, 0.0f, 1.0f);
+    g_gl_state.BindVertexArray(VAO);
     glDrawArrays(GL_LINES, 4, 2);
 }
-
-void RenderLightOrbs(Shader shader, Model model, glm::mat4 model_mat, glm::mat4 view, glm::mat4 projection, glm::vec3 light_color) {
-    shader.use();
-    shader.setMat4("model", model_mat);
-    shader.setMat4("view", view);
-    shader.setMat4("projection", projection);
-    shader.setVec3("light_color", light_color);
-    model.Draw(shader);
-}
@@ -1,9 +1,15 @@
 #version 330 core 
 layout (location = 0) in vec3 aPos;
 
+// per-view camera state, shared by every program (see uniform_buffers.h)
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 camera_pos;
+    vec4 clip_plane;
+};
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main() 
 {
@@ -51,12 +51,40 @@ vec3 CalcSpotLight(SpotLight light, vec3 camera_dir);
 out vec4 FragColor;
 
 // UNIFORMS 
-uniform vec3 camera_pos;
+// per-view camera state, shared by every program (see uniform_buffers.h)
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 camera_pos;
+    vec4 clip_plane;
+};
+
+#ifdef LAYERED
+// both water views (see uniform_buffers.h); Layer is the one this fragment is drawn into
+struct CameraState {
+    mat4 view;
+    mat4 projection;
+    vec3 camera_pos;
+    vec4 clip_plane;
+};
+layout (std140) uniform WaterCameras {
+    CameraState water_cameras[2];
+};
+flat in int Layer;
+vec3 CameraPosition() { return water_cameras[Layer].camera_pos; }
+#else
+vec3 CameraPosition() { return camera_pos; }
+#endif
+
+// scene lighting, shared by every lit program (see uniform_buffers.h)
+layout (std140) uniform Lighting {
+    DirLight directional_light;
+    PointLight point_light[NR_POINT_LIGHTS];
+    SpotLight spot_light[NR_SPOT_LIGHTS];
+    bool directional_only;
+};
+
 uniform Material material;
-uniform DirLight directional_light;
-uniform PointLight point_light[NR_POINT_LIGHTS];
-uniform SpotLight spot_light[NR_SPOT_LIGHTS];
-uniform bool directional_only;
 
 in vec3 wPos;
 in vec3 wNorm;
@@ -64,7 +92,7 @@ in vec2 TexCoords;
 
 void main() {
     // get camera/view direction 
-    vec3 frag_to_light = normalize(camera_pos - wPos);
+    vec3 frag_to_light = normalize(CameraPosition() - wPos);
     // directional light 
     vec3 result = CalcDirLight(directional_light, frag_to_light);
     if (!directional_only) {
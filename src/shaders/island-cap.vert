@@ -1,13 +1,30 @@
 #version 330 core 
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNorm;
+layout (location = 1) in vec2 aNorm; // octahedral
 layout (location = 2) in vec2 aTexCoords;
 
+// per-view camera state, shared by every program (see uniform_buffers.h)
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 camera_pos;
+    vec4 clip_plane;
+};
+
+#ifdef INSTANCED
+// per-instance transforms, see InstanceTransform in vertex_format.h
+layout (location = 7) in mat4 aModel;   // locations 7-10
+layout (location = 11) in mat3 aNormal; // locations 11-13
+mat4 ModelMatrix() { return aModel; }
+mat3 NormalMatrix() { return aNormal; }
+#else
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 uniform mat3 normal;
-uniform vec4 clip_plane;
+mat4 ModelMatrix() { return model; }
+mat3 NormalMatrix() { return normal; }
+#endif
+
+#pragma include octahedral
 
 out VS_OUT {
     vec3 wPos;
@@ -17,16 +34,21 @@ out VS_OUT {
 
 void main() {
     // transform position to world space
-    vec4 wPos = model * vec4(aPos, 1.0f);
+    vec4 wPos = ModelMatrix() * vec4(aPos, 1.0f);
 
     // set geometry shader inputs 
     vs_out.wPos = vec3(wPos);
-    vs_out.wNorm = normalize(normal * aNorm);
+    vs_out.wNorm = normalize(NormalMatrix() * DecodeOctahedral(aNorm));
     vs_out.TexCoords = aTexCoords;
 
+#ifdef LAYERED
+    // island-cap-layers.geom clips and projects for each water view
+    gl_Position = wPos;
+#else
     // compute clip distance 
     gl_ClipDistance[0] = dot(wPos, clip_plane);
     
     // transform position to clip space 
     gl_Position = projection * view * wPos;
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,33 @@
+#version 330 core 
+
+in vec3 vPos;
+flat in vec3 vCenter;
+flat in float vRadius;
+flat in vec3 vColor;
+
+out vec4 FragColor;
+
+// per-view camera state, shared by every program (see uniform_buffers.h)
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 camera_pos;
+    vec4 clip_plane;
+};
+
+void main() {
+    // intersect the view ray through this fragment with the sphere
+    vec3 ray = normalize(vPos);
+    float b = dot(ray, vCenter);
+    float disc = b * b - dot(vCenter, vCenter) + vRadius * vRadius;
+    if (disc < 0.0f)
+        discard;
+    float t = b - sqrt(disc);
+    vec3 hit = ray * max(t, 0.0f);
+
+    // depth of the hit, not of the quad
+    vec4 clip = projection * vec4(hit, 1.0f);
+    gl_FragDepth = (clip.z / clip.w) * 0.5f + 0.5f;
+
+    FragColor = vec4(vColor, 1.0f);
+}
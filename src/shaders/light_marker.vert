@@ -0,0 +1,39 @@
+#version 330 core 
+layout (location = 0) in vec2 aCorner;
+layout (location = 1) in vec4 aSphere; // world position, radius
+layout (location = 2) in vec4 aColor;
+
+// per-view camera state, shared by every program (see uniform_buffers.h)
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 camera_pos;
+    vec4 clip_plane;
+};
+
+out vec3 vPos;
+flat out vec3 vCenter;
+flat out float vRadius;
+flat out vec3 vColor;
+
+void main() {
+    // sphere center in view space, where the eye sits at the origin
+    vec3 center = vec3(view * vec4(aSphere.xyz, 1.0f));
+    float radius = aSphere.w;
+    float dist = length(center);
+
+    // a quad through the center, facing the eye, bounds the silhouette cone
+    // when its half size is r * d / sqrt(d^2 - r^2)
+    vec3 dir = center / dist;
+    vec3 up = abs(dir.y) < 0.99f ? vec3(0.0f, 1.0f, 0.0f) : vec3(1.0f, 0.0f, 0.0f);
+    vec3 right = normalize(cross(dir, up));
+    up = cross(right, dir);
+    float half_size = dist > radius * 1.001f ? radius * dist / sqrt(dist * dist - radius * radius) : 1000.0f * radius;
+
+    vPos = center + (aCorner.x * right + aCorner.y * up) * half_size;
+    vCenter = center;
+    vRadius = radius;
+    vColor = aColor.rgb;
+
+    gl_Position = projection * vec4(vPos, 1.0f);
+}
@@ -1,9 +0,0 @@
-#version 330 core 
-
-out vec4 FragColor;
-
-uniform vec3 light_color;
-
-void main() {
-    FragColor = vec4(light_color, 1.0f);
-}
\ No newline at end of file
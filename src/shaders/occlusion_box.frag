@@ -0,0 +1,5 @@
+#version 330 core 
+
+// nothing is written; the occlusion query only counts the samples that pass the depth test
+void main() {
+}
@@ -0,0 +1,21 @@
+#version 330 core 
+layout (location = 0) in vec3 aCorner; // unit cube corner in [-1, 1]
+
+// per-view camera state, shared by every program (see uniform_buffers.h)
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 camera_pos;
+    vec4 clip_plane;
+};
+
+// world space box being tested
+uniform vec3 box_center;
+uniform vec3 box_extent;
+
+void main() {
+    vec4 wPos = vec4(box_center + aCorner * box_extent, 1.0f);
+    // clipped like the geometry it stands in for
+    gl_ClipDistance[0] = dot(wPos, clip_plane);
+    gl_Position = projection * view * wPos;
+}
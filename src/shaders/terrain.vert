@@ -1,27 +1,62 @@
 #version 330 core 
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNorm;
+layout (location = 1) in vec2 aNorm; // octahedral
 layout (location = 2) in vec2 aTexCoords;
 
+// per-view camera state, shared by every program (see uniform_buffers.h)
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 camera_pos;
+    vec4 clip_plane;
+};
+
+#ifdef INSTANCED
+// per-instance transforms, see InstanceTransform in vertex_format.h
+layout (location = 7) in mat4 aModel;   // locations 7-10
+layout (location = 11) in mat3 aNormal; // locations 11-13
+mat4 ModelMatrix() { return aModel; }
+mat3 NormalMatrix() { return aNormal; }
+#else
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 uniform mat3 normal;
+mat4 ModelMatrix() { return model; }
+mat3 NormalMatrix() { return normal; }
+#endif
 
-uniform vec4 clip_plane;
+#pragma include octahedral
 
+#ifdef LAYERED
+// projected into each water view by water-layers.geom
+out VS_OUT {
+    vec3 wPos;
+    vec3 wNorm;
+    vec2 TexCoords;
+} vs_out;
+#else
 out vec3 wPos;
 out vec3 wNorm;
 out vec2 TexCoords;
+#endif
 
 void main() {
-    wPos = vec3(model * vec4(aPos, 1.0f));
+#ifdef LAYERED
+    vs_out.wPos = vec3(ModelMatrix() * vec4(aPos, 1.0f));
+
+    vs_out.wNorm = normalize(NormalMatrix() * DecodeOctahedral(aNorm));
+
+    vs_out.TexCoords = aTexCoords;
+
+    gl_Position = vec4(vs_out.wPos, 1.0f);
+#else
+    wPos = vec3(ModelMatrix() * vec4(aPos, 1.0f));
 
-    wNorm = normalize(normal * aNorm);
+    wNorm = normalize(NormalMatrix() * DecodeOctahedral(aNorm));
     
     TexCoords = aTexCoords;
 
     gl_ClipDistance[0] = dot(vec4(wPos, 1.0f), clip_plane);
     
     gl_Position = projection * view * vec4(wPos, 1.0f);
+#endif
 }
\ No newline at end of file
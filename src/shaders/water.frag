@@ -52,15 +52,53 @@ vec3 CalcSpotLightSpec(SpotLight light, vec3 camera_dir, vec4 frag_color, vec3 n
 out vec4 FragColor;
 
 // UNIFORMS 
-uniform vec3 camera_pos;
+// per-view camera state, shared by every program (see uniform_buffers.h)
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 camera_pos;
+    vec4 clip_plane;
+};
+
+// scene lighting, shared by every lit program (see uniform_buffers.h)
+layout (std140) uniform Lighting {
+    DirLight directional_light;
+    PointLight point_light[NR_POINT_LIGHTS];
+    SpotLight spot_light[NR_SPOT_LIGHTS];
+    bool directional_only;
+};
+
 uniform Material material;
-uniform DirLight directional_light;
-uniform PointLight point_light[NR_POINT_LIGHTS];
-uniform SpotLight spot_light[NR_SPOT_LIGHTS];
-uniform bool directional_only;
 
+// the targets are drawn at a varying resolution in their lower left corner; this is the part of them in use
+// (see water_frame_buffers.h)
+uniform vec2 reflection_uv_scale;
+uniform vec2 refraction_uv_scale;
+// that part less half a texel on every side (min xy, max xy), so bilinear taps stay inside it
+uniform vec4 reflection_uv_bounds;
+uniform vec4 refraction_uv_bounds;
+// view projection each texture was last drawn with, possibly in an earlier frame (see water_view_cache.h)
+uniform mat4 reflection_view_projection;
+uniform mat4 refraction_view_projection;
+// [0,1] across the drawn part to texture coordinates, clamped in texel space
+vec2 ReflectionUv(vec2 uv) { return clamp(uv * reflection_uv_scale, reflection_uv_bounds.xy, reflection_uv_bounds.zw); }
+vec2 RefractionUv(vec2 uv) { return clamp(uv * refraction_uv_scale, refraction_uv_bounds.xy, refraction_uv_bounds.zw); }
+#ifdef LAYERED
+// one layered target holds both views: layer 0 reflection, layer 1 refraction (see water_frame_buffers.h)
+uniform sampler2DArray reflection_texture;
+uniform sampler2DArray refraction_texture;
+uniform sampler2DArray refraction_depth_texture;
+vec4 SampleReflection(vec2 uv) { return texture(reflection_texture, vec3(ReflectionUv(uv), 0.0f)); }
+vec4 SampleRefraction(vec2 uv) { return texture(refraction_texture, vec3(RefractionUv(uv), 1.0f)); }
+float SampleRefractionDepth(vec2 uv) { return texture(refraction_depth_texture, vec3(RefractionUv(uv), 1.0f)).r; }
+#else
 uniform sampler2D reflection_texture;
 uniform sampler2D refraction_texture;
+uniform sampler2D refraction_depth_texture;
+vec4 SampleReflection(vec2 uv) { return texture(reflection_texture, ReflectionUv(uv)); }
+vec4 SampleRefraction(vec2 uv) { return texture(refraction_texture, RefractionUv(uv)); }
+float SampleRefractionDepth(vec2 uv) { return texture(refraction_depth_texture, RefractionUv(uv)).r; }
+#endif
 uniform sampler2D dudv_map;
 uniform sampler2D normal_map;
 uniform float sampling_offset;
@@ -79,12 +117,16 @@ void main() {
 
     //----- REFLECTION/REFRACTION TEXTURES -----//
 
-    // convert clip space position to normalized device coordinates [0,1]
-    vec2 nPos = (cPos.xy / cPos.w) / 2.0f + 0.5f;
-    
-    // calculate reflection/refraction texture coordinates 
-    vec2 refl_tex_coords = vec2(nPos.x, -nPos.y);
-    vec2 refr_tex_coords = vec2(nPos.x, nPos.y);
+    // project the surface into each texture as it was drawn - the same as the fragment's own position when
+    // drawn this frame, a reprojection when it is kept from an earlier one
+    vec4 refl_clip = reflection_view_projection * vec4(wPos, 1.0f);
+    vec4 refr_clip = refraction_view_projection * vec4(wPos, 1.0f);
+
+    // calculate reflection/refraction texture coordinates [0,1]
+    vec2 refl_tex_coords = (refl_clip.xy / refl_clip.w) / 2.0f + 0.5f;
+    vec2 refr_tex_coords = (refr_clip.xy / refr_clip.w) / 2.0f + 0.5f;
+    vec2 refr_surface_coords = refr_tex_coords;
+    float refr_surface_depth = (refr_clip.z / refr_clip.w) / 2.0f + 0.5f;
 
     // dynamically update sampling coordinates - this can be played with to achieve desired look 
     vec2 distor_coords_0 = vec2(TiledTexCoords.x + sampling_offset, TiledTexCoords.y);
@@ -104,11 +146,13 @@ void main() {
     vec3 normal = normalize(norm_0 + norm_1);
 
     // offset reflection/refraction texture coordinates with distortion
+    // (the Sample* functions keep them to the drawn texels)
     refl_tex_coords += total_distortion;
-    refl_tex_coords.x = clamp(refl_tex_coords.x, 0.001f, 0.999f);
-    refl_tex_coords.y = clamp(refl_tex_coords.y, -0.999f, -0.001f);
     refr_tex_coords += total_distortion;
-    refr_tex_coords = clamp(refr_tex_coords, 0.001f, 0.999f);
+    // keep to what lies behind the water surface - when refraction is copied from the main pass, distorted
+    // coordinates near the shore can land on terrain above the water
+    if (SampleRefractionDepth(refr_tex_coords) < refr_surface_depth)
+        refr_tex_coords = refr_surface_coords;
 
      // compute direction vector from fragment to camera 
     vec3 frag_to_camera = normalize(camera_pos - wPos);
@@ -119,7 +163,7 @@ void main() {
     refr_factor = pow(refr_factor, 1.5f); 
 
     // combine reflection and refraction textures 
-    vec4 texture_result = mix(texture(reflection_texture, refl_tex_coords), texture(refraction_texture, refr_tex_coords), refr_factor);
+    vec4 texture_result = mix(SampleReflection(refl_tex_coords), SampleRefraction(refr_tex_coords), refr_factor);
 
     //----- SPECULAR HIGHLIGHTS -----//
 
@@ -1,6 +1,6 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNorm;
+layout (location = 1) in vec2 aNorm; // octahedral
 layout (location = 2) in vec2 aTexCoords;
 
 out vec3 wPos;
@@ -8,11 +8,19 @@ out vec4 cPos;
 out vec3 wNorm;
 out vec2 TiledTexCoords;
 
+// per-view camera state, shared by every program (see uniform_buffers.h)
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    vec3 camera_pos;
+    vec4 clip_plane;
+};
+
 uniform mat4 model;
-uniform mat4 view; 
-uniform mat4 projection;
 uniform mat3 normal;
 
+#pragma include octahedral
+
 const float tiling_factor = 3.0f;
 
 void main () {
@@ -23,7 +31,7 @@ void main () {
     cPos = projection * view * vec4(wPos, 1.0f);
 
     // transform vertex's normal to world space 
-    wNorm = normalize(normal * aNorm);
+    wNorm = normalize(normal * DecodeOctahedral(aNorm));
 
     // compute tiled texture coordinates for sampling dudv and normal maps 
     TiledTexCoords = aTexCoords * tiling_factor;
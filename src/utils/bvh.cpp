@@ -0,0 +1,299 @@
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <limits>
+
+#include "bvh.h"
+
+namespace {
+
+float SurfaceArea(const glm::vec3 &min, const glm::vec3 &max) {
+    glm::vec3 size = glm::max(max - min, glm::vec3(0.0f));
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+// distance along the ray to where it enters min..max, or a negative value if it misses within max_distance
+float IntersectRay(const glm::vec3 &origin, const glm::vec3 &inverse_direction, float max_distance,
+                   const glm::vec3 &min, const glm::vec3 &max) {
+    glm::vec3 t0 = (min - origin) * inverse_direction;
+    glm::vec3 t1 = (max - origin) * inverse_direction;
+    glm::vec3 near = glm::min(t0, t1), far = glm::max(t0, t1);
+    float enter = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+    float exit = std::min(std::min(far.x, far.y), std::min(far.z, max_distance));
+    return enter <= exit ? enter : -1.0f;
+}
+
+struct Bin {
+    glm::vec3 min, max;
+    uint32_t count;
+};
+
+} // namespace
+
+// ----------- PUBLIC ----------- //
+Bvh::Bvh() {
+}
+
+void Bvh::Build(const std::vector<BoundingBox> &boxes) {
+    nodes.clear();
+    object_order.resize(boxes.size());
+    object_min.resize(boxes.size());
+    object_max.resize(boxes.size());
+    for (uint32_t i = 0; i < boxes.size(); i++) {
+        object_order[i] = i;
+        object_min[i] = boxes[i].center - boxes[i].extent;
+        object_max[i] = boxes[i].center + boxes[i].extent;
+    }
+    if (boxes.empty())
+        return;
+
+    nodes.reserve(2 * boxes.size());
+    Node root = { glm::vec3(0.0f), 0, glm::vec3(0.0f), static_cast<uint32_t>(boxes.size()) };
+    FitNode(root);
+    nodes.push_back(root);
+    Subdivide(0);
+}
+
+void Bvh::SetObjectBox(uint32_t object, const BoundingBox &box) {
+    object_min[object] = box.center - box.extent;
+    object_max[object] = box.center + box.extent;
+}
+
+void Bvh::Refit() {
+    for (size_t i = nodes.size(); i-- > 0;) {
+        Node &node = nodes[i];
+        if (node.count > 0) {
+            FitNode(node);
+            continue;
+        }
+        const Node &left = nodes[node.first], &right = nodes[node.first + 1];
+        node.min = glm::min(left.min, right.min);
+        node.max = glm::max(left.max, right.max);
+    }
+}
+
+void Bvh::QueryFrustum(const Frustum &frustum, std::vector<uint32_t> &objects) const {
+    Query([&frustum](const glm::vec3 &min, const glm::vec3 &max) {
+        BoundingBox box = { (min + max) * 0.5f, (max - min) * 0.5f };
+        ePlaneSide side = PLANE_SIDE_INSIDE;
+        for (size_t i = 0; i < frustum.num_planes; i++) {
+            ePlaneSide plane_side = ClassifyBox(frustum.planes[i], box);
+            if (plane_side == PLANE_SIDE_OUTSIDE)
+                return PLANE_SIDE_OUTSIDE;
+            if (plane_side == PLANE_SIDE_STRADDLING)
+                side = PLANE_SIDE_STRADDLING;
+        }
+        return side;
+    }, objects);
+}
+
+void Bvh::QuerySphere(const glm::vec3 &center, float radius, std::vector<uint32_t> &objects) const {
+    float radius_sq = radius * radius;
+    Query([&center, radius_sq](const glm::vec3 &min, const glm::vec3 &max) {
+        glm::vec3 nearest = glm::clamp(center, min, max) - center;
+        if (glm::dot(nearest, nearest) > radius_sq)
+            return PLANE_SIDE_OUTSIDE;
+        glm::vec3 farthest = glm::max(glm::abs(min - center), glm::abs(max - center));
+        return glm::dot(farthest, farthest) <= radius_sq ? PLANE_SIDE_INSIDE : PLANE_SIDE_STRADDLING;
+    }, objects);
+}
+
+/*
+    Nearer child first, and nodes the ray enters beyond the best hit so far
+    are skipped, so only the boxes around the ray's first hits are visited.
+*/
+bool Bvh::Raycast(const glm::vec3 &origin, const glm::vec3 &direction, float max_distance, BvhHit &hit) const {
+    if (nodes.empty())
+        return false;
+    glm::vec3 inverse_direction = 1.0f / direction; // infinities for axis parallel rays work out in the slab test
+    float best = max_distance;
+    bool found = false;
+
+    std::vector<uint32_t> stack;
+    if (IntersectRay(origin, inverse_direction, best, nodes[0].min, nodes[0].max) >= 0.0f)
+        stack.push_back(0);
+    while (!stack.empty()) {
+        const Node &node = nodes[stack.back()];
+        stack.pop_back();
+        if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                uint32_t object = object_order[i];
+                float distance = IntersectRay(origin, inverse_direction, best, object_min[object], object_max[object]);
+                if (distance >= 0.0f && (!found || distance < best)) {
+                    best = distance;
+                    hit = BvhHit{ object, distance };
+                    found = true;
+                }
+            }
+            continue;
+        }
+        uint32_t near = node.first, far = node.first + 1;
+        float near_distance = IntersectRay(origin, inverse_direction, best, nodes[near].min, nodes[near].max);
+        float far_distance = IntersectRay(origin, inverse_direction, best, nodes[far].min, nodes[far].max);
+        if (far_distance >= 0.0f && (near_distance < 0.0f || far_distance < near_distance)) {
+            std::swap(near, far);
+            std::swap(near_distance, far_distance);
+        }
+        if (far_distance >= 0.0f)
+            stack.push_back(far);
+        if (near_distance >= 0.0f)
+            stack.push_back(near);
+    }
+    return found;
+}
+
+size_t Bvh::GetObjectCount() const {
+    return object_order.size();
+}
+
+size_t Bvh::GetNodeCount() const {
+    return nodes.size();
+}
+
+// ----------- PRIVATE ----------- //
+/*
+    Bin the centroids along each axis and split where the surface area
+    heuristic (area times object count of each side, plus the cost of
+    visiting the node) is lowest. Nodes stay
+    leaves when no split beats keeping them whole, unless they are over
+    kBvhLeafSize; if the centroids all coincide those are split in half.
+*/
+void Bvh::Subdivide(uint32_t index) {
+    Node node = nodes[index];
+    if (node.count <= 1)
+        return;
+
+    glm::vec3 centroid_min(std::numeric_limits<float>::max()), centroid_max(-std::numeric_limits<float>::max());
+    for (uint32_t i = node.first; i < node.first + node.count; i++) {
+        glm::vec3 centroid = (object_min[object_order[i]] + object_max[object_order[i]]) * 0.5f;
+        centroid_min = glm::min(centroid_min, centroid);
+        centroid_max = glm::max(centroid_max, centroid);
+    }
+
+    int best_axis = -1;
+    size_t best_split = 0;
+    float node_area = SurfaceArea(node.min, node.max);
+    float best_cost = node_area * node.count; // of keeping a leaf
+    for (int axis = 0; axis < 3; axis++) {
+        float extent = centroid_max[axis] - centroid_min[axis];
+        if (extent <= 0.0f)
+            continue;
+        float scale = kBvhBins / extent;
+        Bin bins[kBvhBins];
+        for (Bin &bin : bins)
+            bin = Bin{ glm::vec3(std::numeric_limits<float>::max()), glm::vec3(-std::numeric_limits<float>::max()), 0 };
+        for (uint32_t i = node.first; i < node.first + node.count; i++) {
+            uint32_t object = object_order[i];
+            float centroid = (object_min[object][axis] + object_max[object][axis]) * 0.5f;
+            Bin &bin = bins[std::min(static_cast<size_t>((centroid - centroid_min[axis]) * scale), kBvhBins - 1)];
+            bin.min = glm::min(bin.min, object_min[object]);
+            bin.max = glm::max(bin.max, object_max[object]);
+            bin.count++;
+        }
+
+        // sweep from the right for the area and count of every right side, then from the left to evaluate
+        float right_area[kBvhBins];
+        uint32_t right_count[kBvhBins];
+        glm::vec3 min = bins[kBvhBins - 1].min, max = bins[kBvhBins - 1].max;
+        uint32_t count = 0;
+        for (size_t split = kBvhBins - 1; split > 0; split--) {
+            min = glm::min(min, bins[split].min);
+            max = glm::max(max, bins[split].max);
+            count += bins[split].count;
+            right_area[split] = count > 0 ? SurfaceArea(min, max) : 0.0f;
+            right_count[split] = count;
+        }
+        min = bins[0].min;
+        max = bins[0].max;
+        count = 0;
+        for (size_t split = 1; split < kBvhBins; split++) {
+            min = glm::min(min, bins[split - 1].min);
+            max = glm::max(max, bins[split - 1].max);
+            count += bins[split - 1].count;
+            if (count == 0 || right_count[split] == 0)
+                continue;
+            float cost = node_area * kBvhTraversalCost + SurfaceArea(min, max) * count + right_area[split] * right_count[split];
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = split;
+            }
+        }
+    }
+
+    uint32_t *begin = object_order.data() + node.first;
+    uint32_t *end = begin + node.count;
+    uint32_t *middle;
+    if (best_axis >= 0) {
+        float scale = kBvhBins / (centroid_max[best_axis] - centroid_min[best_axis]);
+        middle = std::partition(begin, end, [&](uint32_t object) {
+            float centroid = (object_min[object][best_axis] + object_max[object][best_axis]) * 0.5f;
+            return std::min(static_cast<size_t>((centroid - centroid_min[best_axis]) * scale), kBvhBins - 1) < best_split;
+        });
+    } else if (node.count > kBvhLeafSize)
+        middle = begin + node.count / 2;
+    else
+        return;
+
+    uint32_t left_count = static_cast<uint32_t>(middle - begin);
+    uint32_t left = static_cast<uint32_t>(nodes.size());
+    Node left_node = { glm::vec3(0.0f), node.first, glm::vec3(0.0f), left_count };
+    Node right_node = { glm::vec3(0.0f), node.first + left_count, glm::vec3(0.0f), node.count - left_count };
+    FitNode(left_node);
+    FitNode(right_node);
+    nodes.push_back(left_node);
+    nodes.push_back(right_node);
+    nodes[index].first = left;
+    nodes[index].count = 0;
+
+    Subdivide(left);
+    Subdivide(left + 1);
+}
+
+void Bvh::FitNode(Node &node) const {
+    node.min = glm::vec3(std::numeric_limits<float>::max());
+    node.max = glm::vec3(-std::numeric_limits<float>::max());
+    for (uint32_t i = node.first; i < node.first + node.count; i++) {
+        node.min = glm::min(node.min, object_min[object_order[i]]);
+        node.max = glm::max(node.max, object_max[object_order[i]]);
+    }
+}
+
+void Bvh::AppendSubtree(uint32_t index, std::vector<uint32_t> &objects) const {
+    const Node &node = nodes[index];
+    if (node.count > 0) {
+        objects.insert(objects.end(), object_order.begin() + node.first, object_order.begin() + node.first + node.count);
+        return;
+    }
+    AppendSubtree(node.first, objects);
+    AppendSubtree(node.first + 1, objects);
+}
+
+template <typename Classify>
+void Bvh::Query(const Classify &classify, std::vector<uint32_t> &objects) const {
+    if (nodes.empty())
+        return;
+    std::vector<uint32_t> stack(1, 0);
+    while (!stack.empty()) {
+        uint32_t index = stack.back();
+        stack.pop_back();
+        const Node &node = nodes[index];
+        ePlaneSide side = classify(node.min, node.max);
+        if (side == PLANE_SIDE_OUTSIDE)
+            continue;
+        if (side == PLANE_SIDE_INSIDE) {
+            AppendSubtree(index, objects);
+            continue;
+        }
+        if (node.count == 0) {
+            stack.push_back(node.first + 1);
+            stack.push_back(node.first);
+            continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; i++) {
+            uint32_t object = object_order[i];
+            if (classify(object_min[object], object_max[object]) != PLANE_SIDE_OUTSIDE)
+                objects.push_back(object);
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef ISLAND_UTILS_BVH_H_
+#define ISLAND_UTILS_BVH_H_
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "frustum.h"
+
+// most objects a leaf holds
+const size_t kBvhLeafSize = 4;
+// cost of visiting a node relative to testing an object, in the surface area heuristic
+const float kBvhTraversalCost = 1.0f;
+// centroid bins per axis the surface area heuristic evaluates
+const size_t kBvhBins = 16;
+
+struct BvhHit {
+    uint32_t object;
+    float distance; // along the ray, to where it enters the object's box
+};
+
+/*
+    Bounding volume hierarchy over the world boxes of scene objects, which
+    are identified by their index in the boxes given to Build(). Built top
+    down with a binned surface area heuristic; when objects move, their
+    boxes are updated and the tree is refit rather than rebuilt, which keeps
+    it valid (if gradually looser) at a fraction of the cost.
+
+    Queries only descend into nodes that can hold a match and take whole
+    subtrees without testing them once a node is found to be entirely
+    inside, so their cost follows the size of the answer rather than of the
+    scene. Results are object indices, appended to the given vector.
+*/
+class Bvh {
+public:
+    Bvh();
+
+    void Build(const std::vector<BoundingBox> &boxes);
+
+    // replaces an object's box, e.g. when it moved; takes effect in the tree at the next Refit()
+    void SetObjectBox(uint32_t object, const BoundingBox &box);
+    // grows/shrinks every node to fit its objects' current boxes
+    void Refit();
+
+    // objects whose boxes are at least partly inside frustum, and on the kept side of its clip plane if it
+    // has one (see AddClipPlane())
+    void QueryFrustum(const Frustum &frustum, std::vector<uint32_t> &objects) const;
+    // objects whose boxes overlap the sphere, e.g. the reach of a light
+    void QuerySphere(const glm::vec3 &center, float radius, std::vector<uint32_t> &objects) const;
+    // nearest object whose box the ray enters within max_distance, e.g. for picking
+    bool Raycast(const glm::vec3 &origin, const glm::vec3 &direction, float max_distance, BvhHit &hit) const;
+
+    size_t GetObjectCount() const;
+    size_t GetNodeCount() const;
+
+private:
+    // children of an inner node are adjacent and always come after it, so a reverse walk visits
+    // children before parents
+    struct Node {
+        glm::vec3 min;
+        uint32_t first; // leaf: first entry in object_order; inner: index of the left child
+        glm::vec3 max;
+        uint32_t count; // objects in a leaf, 0 for inner nodes
+    };
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> object_order;  // objects grouped by leaf
+    std::vector<glm::vec3> object_min;   // by object index
+    std::vector<glm::vec3> object_max;
+
+    void Subdivide(uint32_t node);
+    void FitNode(Node &node) const;
+    void AppendSubtree(uint32_t node, std::vector<uint32_t> &objects) const;
+
+    // classify returns where a box min..max lies relative to the query volume
+    template <typename Classify>
+    void Query(const Classify &classify, std::vector<uint32_t> &objects) const;
+};
+
+#endif // ISLAND_UTILS_BVH_H_
@@ -26,6 +26,8 @@ float g_last_frame = 0.0f;
 // Water // 
 float g_wave_speed = 0.05f;
 float g_movement_factor = 0.0f;
+// LOD // 
+float g_lod_bias = 0.0f; // log2 scale on the allowed screen space error, > 0 picks coarser lods
 // Out Image //
 int g_out_file_index = 0;
 
@@ -89,6 +91,10 @@ void ProcessInput(GLFWwindow* window)
         g_camera.ProcessKeyboard(RIGHT, g_delta_time);
     if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
         SaveScreenshot();
+    if (glfwGetKey(window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS)
+        g_lod_bias -= g_delta_time;
+    if (glfwGetKey(window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS)
+        g_lod_bias += g_delta_time;
 }
 
 //----------- CALLBACK FUNCTIONS -----------//
@@ -98,6 +104,11 @@ void ProcessInput(GLFWwindow* window)
 void FramebufferSizeCallback(GLFWwindow* window, int width, int height)
 {
     glViewport(0, 0, width, height);
+    // a minimized window reports 0 x 0 - keep the last size so render targets stay valid
+    if (width > 0 && height > 0) {
+        g_screen_width_p = static_cast<unsigned int>(width);
+        g_screen_height_p = static_cast<unsigned int>(height);
+    }
 }
 
 /*
@@ -29,6 +29,8 @@ extern float g_last_frame;
 // Water // 
 extern float g_wave_speed;
 extern float g_movement_factor;
+// LOD // 
+extern float g_lod_bias;
 // Out Image //
 extern int g_out_file_index;
 
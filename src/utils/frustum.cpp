@@ -0,0 +1,217 @@
+#include <glm/glm.hpp>
+
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <cmath>
+
+#include "frustum.h"
+
+namespace {
+
+// distance from the plane to the box's farthest corner along the normal, negative when the box is outside
+inline float PlaneBoxDistance(const glm::vec4 &plane, const glm::vec3 &center, const glm::vec3 &extent) {
+    return glm::dot(glm::vec3(plane), center) + plane.w + glm::dot(glm::abs(glm::vec3(plane)), extent);
+}
+
+} // namespace
+
+/*
+    Row 3 of the matrix plus or minus row 0, 1 or 2 bounds x, y and z in
+    clip space. The planes are normalised so sphere tests can compare
+    against radii directly.
+*/
+Frustum ExtractFrustum(const glm::mat4 &view_projection) {
+    glm::vec4 row[4];
+    for (int i = 0; i < 4; i++)
+        row[i] = glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]);
+
+    Frustum frustum;
+    frustum.planes[FRUSTUM_PLANE_LEFT] = row[3] + row[0];
+    frustum.planes[FRUSTUM_PLANE_RIGHT] = row[3] - row[0];
+    frustum.planes[FRUSTUM_PLANE_BOTTOM] = row[3] + row[1];
+    frustum.planes[FRUSTUM_PLANE_TOP] = row[3] - row[1];
+    frustum.planes[FRUSTUM_PLANE_NEAR] = row[3] + row[2];
+    frustum.planes[FRUSTUM_PLANE_FAR] = row[3] - row[2];
+    frustum.num_planes = NUM_FRUSTUM_PLANES;
+    for (size_t i = 0; i < frustum.num_planes; i++)
+        frustum.planes[i] /= glm::length(glm::vec3(frustum.planes[i]));
+    return frustum;
+}
+
+void AddClipPlane(Frustum &frustum, const glm::vec4 &clip_plane) {
+    float length = glm::length(glm::vec3(clip_plane));
+    if (length == 0.0f || frustum.num_planes == kMaxFrustumPlanes)
+        return;
+    frustum.planes[frustum.num_planes++] = clip_plane / length;
+}
+
+BoundingBox TransformBox(const glm::vec3 &min, const glm::vec3 &max, const glm::mat4 &matrix) {
+    glm::mat3 axes = glm::mat3(matrix);
+    glm::vec3 extent = (max - min) * 0.5f;
+    BoundingBox box;
+    box.center = glm::vec3(matrix * glm::vec4((min + max) * 0.5f, 1.0f));
+    box.extent = glm::abs(axes[0]) * extent.x + glm::abs(axes[1]) * extent.y + glm::abs(axes[2]) * extent.z;
+    return box;
+}
+
+BoundingBox TransformBounds(const MeshBounds &bounds, const glm::mat4 &matrix) {
+    return TransformBox(bounds.min, bounds.max, matrix);
+}
+
+BoundingBox MergeBoxes(const BoundingBox &a, const BoundingBox &b) {
+    glm::vec3 min = glm::min(a.center - a.extent, b.center - b.extent);
+    glm::vec3 max = glm::max(a.center + a.extent, b.center + b.extent);
+    return BoundingBox{ (min + max) * 0.5f, (max - min) * 0.5f };
+}
+
+ePlaneSide ClassifyBox(const glm::vec4 &plane, const BoundingBox &box) {
+    float distance = glm::dot(glm::vec3(plane), box.center) + plane.w;
+    float radius = glm::dot(glm::abs(glm::vec3(plane)), box.extent);
+    if (distance + radius < 0.0f)
+        return PLANE_SIDE_OUTSIDE;
+    return distance - radius >= 0.0f ? PLANE_SIDE_INSIDE : PLANE_SIDE_STRADDLING;
+}
+
+bool IsBoxVisible(const Frustum &frustum, const BoundingBox &box) {
+    for (size_t i = 0; i < frustum.num_planes; i++) {
+        if (PlaneBoxDistance(frustum.planes[i], box.center, box.extent) < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+bool IsSphereVisible(const Frustum &frustum, const glm::vec3 &center, float radius) {
+    for (size_t i = 0; i < frustum.num_planes; i++) {
+        const glm::vec4 &plane = frustum.planes[i];
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+            return false;
+    }
+    return true;
+}
+
+/*
+    Rectangle around the projected corners. A corner at or behind the eye
+    has no place on screen, so such boxes take the whole screen; callers
+    test against the frustum first to drop those entirely out of view.
+*/
+bool ProjectBox(const BoundingBox &box, const glm::mat4 &view_projection, glm::vec4 &rect) {
+    glm::vec2 min(1.0f), max(0.0f);
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec3 sign = glm::vec3(corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f, corner & 4 ? 1.0f : -1.0f);
+        glm::vec4 clip = view_projection * glm::vec4(box.center + sign * box.extent, 1.0f);
+        if (clip.w <= 1e-4f) {
+            rect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+            return true;
+        }
+        glm::vec2 uv = glm::vec2(clip) / clip.w * 0.5f + 0.5f;
+        min = glm::min(min, uv);
+        max = glm::max(max, uv);
+    }
+    min = glm::clamp(min, 0.0f, 1.0f);
+    max = glm::clamp(max, 0.0f, 1.0f);
+    rect = glm::vec4(min, max);
+    return min.x < max.x && min.y < max.y;
+}
+
+// ----------- PUBLIC ----------- //
+void CullBatch::Clear() {
+    center_x.clear(); center_y.clear(); center_z.clear();
+    extent_x.clear(); extent_y.clear(); extent_z.clear();
+}
+
+void CullBatch::Add(const BoundingBox &box) {
+    center_x.push_back(box.center.x); center_y.push_back(box.center.y); center_z.push_back(box.center.z);
+    extent_x.push_back(box.extent.x); extent_y.push_back(box.extent.y); extent_z.push_back(box.extent.z);
+}
+
+size_t CullBatch::Size() const {
+    return center_x.size();
+}
+
+/*
+    Each lane holds one box and each plane is broadcast, so a group of boxes
+    costs the same plane tests as a single one. The extents are never
+    negative, so |n| . e is the projected half size of the box on the
+    normal.
+*/
+size_t CullBoxes(const Frustum &frustum, const CullBatch &boxes, uint8_t *visible) {
+    const size_t count = boxes.Size();
+    const float *cx = boxes.center_x.data(), *cy = boxes.center_y.data(), *cz = boxes.center_z.data();
+    const float *ex = boxes.extent_x.data(), *ey = boxes.extent_y.data(), *ez = boxes.extent_z.data();
+    size_t i = 0;
+
+#if defined(__AVX__)
+    for (; i + 8 <= count; i += 8) {
+        __m256 center_x = _mm256_loadu_ps(cx + i), center_y = _mm256_loadu_ps(cy + i), center_z = _mm256_loadu_ps(cz + i);
+        __m256 extent_x = _mm256_loadu_ps(ex + i), extent_y = _mm256_loadu_ps(ey + i), extent_z = _mm256_loadu_ps(ez + i);
+        __m256 outside = _mm256_setzero_ps();
+        for (size_t p = 0; p < frustum.num_planes; p++) {
+            const glm::vec4 &plane = frustum.planes[p];
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), center_x),
+                                                          _mm256_mul_ps(_mm256_set1_ps(plane.y), center_y)),
+                                            _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.z), center_z), _mm256_set1_ps(plane.w)));
+            __m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(std::fabs(plane.x)), extent_x),
+                                                        _mm256_mul_ps(_mm256_set1_ps(std::fabs(plane.y)), extent_y)),
+                                          _mm256_mul_ps(_mm256_set1_ps(std::fabs(plane.z)), extent_z));
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_LT_OQ));
+        }
+        int mask = _mm256_movemask_ps(outside);
+        for (int lane = 0; lane < 8; lane++)
+            visible[i + lane] = !((mask >> lane) & 1);
+    }
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+    for (; i + 4 <= count; i += 4) {
+        __m128 center_x = _mm_loadu_ps(cx + i), center_y = _mm_loadu_ps(cy + i), center_z = _mm_loadu_ps(cz + i);
+        __m128 extent_x = _mm_loadu_ps(ex + i), extent_y = _mm_loadu_ps(ey + i), extent_z = _mm_loadu_ps(ez + i);
+        __m128 outside = _mm_setzero_ps();
+        for (size_t p = 0; p < frustum.num_planes; p++) {
+            const glm::vec4 &plane = frustum.planes[p];
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), center_x), _mm_mul_ps(_mm_set1_ps(plane.y), center_y)),
+                                         _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), center_z), _mm_set1_ps(plane.w)));
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::fabs(plane.x)), extent_x),
+                                                  _mm_mul_ps(_mm_set1_ps(std::fabs(plane.y)), extent_y)),
+                                       _mm_mul_ps(_mm_set1_ps(std::fabs(plane.z)), extent_z));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+        }
+        int mask = _mm_movemask_ps(outside);
+        for (int lane = 0; lane < 4; lane++)
+            visible[i + lane] = !((mask >> lane) & 1);
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t center_x = vld1q_f32(cx + i), center_y = vld1q_f32(cy + i), center_z = vld1q_f32(cz + i);
+        float32x4_t extent_x = vld1q_f32(ex + i), extent_y = vld1q_f32(ey + i), extent_z = vld1q_f32(ez + i);
+        uint32x4_t outside = vdupq_n_u32(0);
+        for (size_t p = 0; p < frustum.num_planes; p++) {
+            const glm::vec4 &plane = frustum.planes[p];
+            float32x4_t distance = vdupq_n_f32(plane.w);
+            distance = vmlaq_n_f32(distance, center_x, plane.x);
+            distance = vmlaq_n_f32(distance, center_y, plane.y);
+            distance = vmlaq_n_f32(distance, center_z, plane.z);
+            distance = vmlaq_n_f32(distance, extent_x, std::fabs(plane.x));
+            distance = vmlaq_n_f32(distance, extent_y, std::fabs(plane.y));
+            distance = vmlaq_n_f32(distance, extent_z, std::fabs(plane.z));
+            outside = vorrq_u32(outside, vcltq_f32(distance, vdupq_n_f32(0.0f)));
+        }
+        visible[i + 0] = vgetq_lane_u32(outside, 0) == 0;
+        visible[i + 1] = vgetq_lane_u32(outside, 1) == 0;
+        visible[i + 2] = vgetq_lane_u32(outside, 2) == 0;
+        visible[i + 3] = vgetq_lane_u32(outside, 3) == 0;
+    }
+#endif
+
+    for (; i < count; i++) {
+        BoundingBox box = { glm::vec3(cx[i], cy[i], cz[i]), glm::vec3(ex[i], ey[i], ez[i]) };
+        visible[i] = IsBoxVisible(frustum, box);
+    }
+
+    size_t num_visible = 0;
+    for (i = 0; i < count; i++)
+        num_visible += visible[i];
+    return num_visible;
+}
@@ -0,0 +1,89 @@
+#ifndef ISLAND_UTILS_FRUSTUM_H_
+#define ISLAND_UTILS_FRUSTUM_H_
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+
+enum eFrustumPlane {
+    FRUSTUM_PLANE_LEFT,
+    FRUSTUM_PLANE_RIGHT,
+    FRUSTUM_PLANE_BOTTOM,
+    FRUSTUM_PLANE_TOP,
+    FRUSTUM_PLANE_NEAR,
+    FRUSTUM_PLANE_FAR,
+    NUM_FRUSTUM_PLANES
+};
+
+// the six frustum planes and an optional clip plane
+const size_t kMaxFrustumPlanes = NUM_FRUSTUM_PLANES + 1;
+
+// world space planes (xyz normal pointing inwards, unit length; w offset), so a point p is inside when
+// dot(plane, vec4(p, 1)) >= 0 for every plane
+struct Frustum {
+    glm::vec4 planes[kMaxFrustumPlanes];
+    size_t num_planes;
+};
+
+enum ePlaneSide {
+    PLANE_SIDE_INSIDE,
+    PLANE_SIDE_OUTSIDE,
+    PLANE_SIDE_STRADDLING
+};
+
+// axis aligned box as center and half size
+struct BoundingBox {
+    glm::vec3 center;
+    glm::vec3 extent;
+};
+
+// Planes of the clip volume of view_projection (Gribb/Hartmann). Only relies on
+// the clip space inequalities, so it holds for any camera, including the
+// reflected one.
+Frustum ExtractFrustum(const glm::mat4 &view_projection);
+
+// Narrows frustum to the side of clip_plane a gl_ClipDistance of dot(vec4(p, 1), clip_plane) keeps.
+// A zero plane (clipping disabled) is ignored.
+void AddClipPlane(Frustum &frustum, const glm::vec4 &clip_plane);
+
+// World space box around the local box min..max moved by matrix (Arvo).
+BoundingBox TransformBox(const glm::vec3 &min, const glm::vec3 &max, const glm::mat4 &matrix);
+BoundingBox TransformBounds(const MeshBounds &bounds, const glm::mat4 &matrix);
+
+// Smallest box holding a and b.
+BoundingBox MergeBoxes(const BoundingBox &a, const BoundingBox &b);
+
+ePlaneSide ClassifyBox(const glm::vec4 &plane, const BoundingBox &box);
+
+bool IsBoxVisible(const Frustum &frustum, const BoundingBox &box);
+bool IsSphereVisible(const Frustum &frustum, const glm::vec3 &center, float radius);
+
+// Screen rectangle of box through view_projection, as min xy and max xy in [0, 1] texture coordinates
+// clamped to the screen. False if it has no area on screen.
+bool ProjectBox(const BoundingBox &box, const glm::mat4 &view_projection, glm::vec4 &rect);
+
+/*
+    Boxes in structure of arrays form, the input of CullBoxes. Kept between
+    frames by its owner, so filling it does not allocate once warm.
+*/
+class CullBatch {
+public:
+    void Clear();
+    void Add(const BoundingBox &box);
+    size_t Size() const;
+
+private:
+    friend size_t CullBoxes(const Frustum &frustum, const CullBatch &boxes, uint8_t *visible);
+
+    std::vector<float> center_x, center_y, center_z;
+    std::vector<float> extent_x, extent_y, extent_z;
+};
+
+// Sets visible[i] to 1 if box i is at least partly inside frustum, 0 if not, and returns the visible
+// count. Tests 8 boxes at a time with AVX, 4 with SSE or NEON, and the rest one by one.
+size_t CullBoxes(const Frustum &frustum, const CullBatch &boxes, uint8_t *visible);
+
+#endif // ISLAND_UTILS_FRUSTUM_H_
@@ -0,0 +1,155 @@
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <iostream>
+
+#include "gl_state.h"
+
+GlStateCache g_gl_state;
+
+namespace {
+
+// never a valid object name in practice
+const GLuint kUnknownBinding = 0xFFFFFFFFu;
+
+const char *const kStateCallNames[NUM_STATE_CALLS] = {
+    "glUseProgram", "glActiveTexture", "glBindTexture", "glBindVertexArray", "glBindFramebuffer"
+};
+
+} // namespace
+
+// ----------- PUBLIC ----------- //
+GlStateCache::GlStateCache() : frame_stats(), last_stats(), total_stats() {
+    Invalidate();
+}
+
+void GlStateCache::UseProgram(GLuint program) {
+    if (Update(STATE_CALL_USE_PROGRAM, this->program, program))
+        glUseProgram(program);
+}
+
+void GlStateCache::ActiveTexture(GLenum unit) {
+    if (Update(STATE_CALL_ACTIVE_TEXTURE, active_unit, unit - GL_TEXTURE0))
+        glActiveTexture(unit);
+}
+
+void GlStateCache::BindTexture(GLenum target, GLuint texture) {
+    int index = TargetIndex(target);
+    if (index < 0 || active_unit >= kMaxStateTextureUnits) {
+        frame_stats.issued[STATE_CALL_BIND_TEXTURE]++;
+        glBindTexture(target, texture);
+        return;
+    }
+    if (Update(STATE_CALL_BIND_TEXTURE, textures[index][active_unit], texture))
+        glBindTexture(target, texture);
+}
+
+/*
+    Skip the unit switch as well when the texture is already there; the
+    usual case for material textures drawn over and over.
+*/
+void GlStateCache::BindTextureUnit(GLuint unit, GLenum target, GLuint texture) {
+    int index = TargetIndex(target);
+    if (index >= 0 && unit < kMaxStateTextureUnits && textures[index][unit] == texture) {
+        frame_stats.skipped[STATE_CALL_BIND_TEXTURE]++;
+        return;
+    }
+    ActiveTexture(GL_TEXTURE0 + unit);
+    BindTexture(target, texture);
+}
+
+void GlStateCache::BindVertexArray(GLuint vertex_array) {
+    if (Update(STATE_CALL_BIND_VERTEX_ARRAY, this->vertex_array, vertex_array))
+        glBindVertexArray(vertex_array);
+}
+
+void GlStateCache::BindFramebuffer(GLenum target, GLuint framebuffer) {
+    bool changed;
+    if (target == GL_DRAW_FRAMEBUFFER)
+        changed = Update(STATE_CALL_BIND_FRAMEBUFFER, draw_framebuffer, framebuffer);
+    else if (target == GL_READ_FRAMEBUFFER)
+        changed = Update(STATE_CALL_BIND_FRAMEBUFFER, read_framebuffer, framebuffer);
+    else {
+        changed = draw_framebuffer != framebuffer || read_framebuffer != framebuffer;
+        (changed ? frame_stats.issued : frame_stats.skipped)[STATE_CALL_BIND_FRAMEBUFFER]++;
+        draw_framebuffer = read_framebuffer = framebuffer;
+    }
+    if (changed)
+        glBindFramebuffer(target, framebuffer);
+}
+
+/*
+    Deleting a bound object binds 0 in its place.
+*/
+void GlStateCache::DeleteTexture(GLuint texture) {
+    glDeleteTextures(1, &texture);
+    for (size_t target = 0; target < NUM_TEXTURE_TARGETS; target++)
+        std::replace(textures[target], textures[target] + kMaxStateTextureUnits, texture, GLuint(0));
+}
+
+void GlStateCache::DeleteVertexArray(GLuint vertex_array) {
+    glDeleteVertexArrays(1, &vertex_array);
+    if (this->vertex_array == vertex_array)
+        this->vertex_array = 0;
+}
+
+void GlStateCache::DeleteFramebuffer(GLuint framebuffer) {
+    glDeleteFramebuffers(1, &framebuffer);
+    if (draw_framebuffer == framebuffer)
+        draw_framebuffer = 0;
+    if (read_framebuffer == framebuffer)
+        read_framebuffer = 0;
+}
+
+void GlStateCache::Invalidate() {
+    program = kUnknownBinding;
+    active_unit = kUnknownBinding;
+    for (size_t target = 0; target < NUM_TEXTURE_TARGETS; target++)
+        std::fill(textures[target], textures[target] + kMaxStateTextureUnits, kUnknownBinding);
+    vertex_array = kUnknownBinding;
+    draw_framebuffer = kUnknownBinding;
+    read_framebuffer = kUnknownBinding;
+}
+
+void GlStateCache::EndFrame() {
+    frame_stats.frames = 1;
+    last_stats = frame_stats;
+    total_stats.frames += frame_stats.frames;
+    for (size_t call = 0; call < NUM_STATE_CALLS; call++) {
+        total_stats.issued[call] += frame_stats.issued[call];
+        total_stats.skipped[call] += frame_stats.skipped[call];
+    }
+    frame_stats = GlStateStats();
+}
+
+const GlStateStats &GlStateCache::GetStats() const {
+    return last_stats;
+}
+
+void GlStateCache::PrintStats() const {
+    double frames = std::max(static_cast<double>(total_stats.frames), 1.0);
+    std::cout << "GL_STATE:: issued/skipped, last frame (per frame over " << total_stats.frames << " frames):" << std::endl;
+    for (size_t call = 0; call < NUM_STATE_CALLS; call++) {
+        std::cout << "GL_STATE::   " << kStateCallNames[call] << ": " << last_stats.issued[call] << "/" << last_stats.skipped[call]
+                  << " (" << total_stats.issued[call] / frames << "/" << total_stats.skipped[call] / frames << ")" << std::endl;
+    }
+}
+
+// ----------- PRIVATE ----------- //
+bool GlStateCache::Update(eStateCall call, GLuint &current, GLuint value) {
+    if (current == value) {
+        frame_stats.skipped[call]++;
+        return false;
+    }
+    current = value;
+    frame_stats.issued[call]++;
+    return true;
+}
+
+int GlStateCache::TargetIndex(GLenum target) {
+    switch (target) {
+    case GL_TEXTURE_2D: return TEXTURE_TARGET_2D;
+    case GL_TEXTURE_2D_ARRAY: return TEXTURE_TARGET_2D_ARRAY;
+    default: return -1;
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef ISLAND_UTILS_GL_STATE_H_
+#define ISLAND_UTILS_GL_STATE_H_
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// the binds GlStateCache shadows
+enum eStateCall {
+    STATE_CALL_USE_PROGRAM,
+    STATE_CALL_ACTIVE_TEXTURE,
+    STATE_CALL_BIND_TEXTURE,
+    STATE_CALL_BIND_VERTEX_ARRAY,
+    STATE_CALL_BIND_FRAMEBUFFER,
+    NUM_STATE_CALLS
+};
+
+// texture units shadowed per target; binds to higher units always go to gl
+const size_t kMaxStateTextureUnits = 32;
+
+struct GlStateStats {
+    uint64_t frames;
+    uint64_t issued[NUM_STATE_CALLS];
+    uint64_t skipped[NUM_STATE_CALLS];
+};
+
+/*
+    Shadows the current program, active texture unit, per-unit texture
+    bindings (2D and 2D array), vertex array and draw/read framebuffers of
+    the gl context, and drops calls that would not change them. Every bind
+    of these goes through g_gl_state, and so do deletes of bound objects,
+    since gl silently rebinds 0 in their place.
+
+    Bindings start out unknown, so the first call of each kind is always
+    issued. Code that changes these bindings behind the cache's back must
+    call Invalidate() afterwards.
+*/
+class GlStateCache {
+public:
+    GlStateCache();
+
+    void UseProgram(GLuint program);
+    void ActiveTexture(GLenum unit);                          // GL_TEXTURE0 + i
+    void BindTexture(GLenum target, GLuint texture);          // on the active unit
+    void BindTextureUnit(GLuint unit, GLenum target, GLuint texture); // only activates unit if the bind is needed
+    void BindVertexArray(GLuint vertex_array);
+    void BindFramebuffer(GLenum target, GLuint framebuffer);  // GL_FRAMEBUFFER sets draw and read
+
+    void DeleteTexture(GLuint texture);
+    void DeleteVertexArray(GLuint vertex_array);
+    void DeleteFramebuffer(GLuint framebuffer);
+
+    // forget every binding
+    void Invalidate();
+
+    // rolls the frame's counters over
+    void EndFrame();
+
+    // counts of the last finished frame
+    const GlStateStats &GetStats() const;
+    void PrintStats() const;
+
+private:
+    enum eTextureTarget {
+        TEXTURE_TARGET_2D,
+        TEXTURE_TARGET_2D_ARRAY,
+        NUM_TEXTURE_TARGETS
+    };
+
+    GLuint program;
+    GLuint active_unit;
+    GLuint textures[NUM_TEXTURE_TARGETS][kMaxStateTextureUnits];
+    GLuint vertex_array;
+    GLuint draw_framebuffer;
+    GLuint read_framebuffer;
+
+    GlStateStats frame_stats;
+    GlStateStats last_stats;
+    GlStateStats total_stats;
+
+    // true if the call changes state; counts it either way
+    bool Update(eStateCall call, GLuint &current, GLuint value);
+
+    static int TargetIndex(GLenum target);
+};
+
+extern GlStateCache g_gl_state;
+
+#endif // ISLAND_UTILS_GL_STATE_H_
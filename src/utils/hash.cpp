@@ -0,0 +1,30 @@
+#include <sys/stat.h>
+
+#include <fstream>
+
+#include "hash.h"
+
+uint64_t HashFile(const std::string &path, uint64_t seed) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return 0;
+
+    uint64_t hash = Fnv1a64(kFnvOffsetBasis64, &seed, sizeof(seed));
+    char buffer[64 * 1024];
+    while (in) {
+        in.read(buffer, sizeof(buffer));
+        hash = Fnv1a64(hash, buffer, static_cast<size_t>(in.gcount()));
+    }
+    return hash;
+}
+
+uint64_t StampFile(const std::string &path, uint64_t seed) {
+    struct stat status;
+    if (stat(path.c_str(), &status) != 0)
+        return 0;
+    uint64_t size = static_cast<uint64_t>(status.st_size);
+    uint64_t modified = static_cast<uint64_t>(status.st_mtime);
+    uint64_t hash = Fnv1a64(kFnvOffsetBasis64, &seed, sizeof(seed));
+    hash = Fnv1a64(hash, &size, sizeof(size));
+    return Fnv1a64(hash, &modified, sizeof(modified));
+}
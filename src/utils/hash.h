@@ -0,0 +1,29 @@
+#ifndef ISLAND_UTILS_HASH_H_
+#define ISLAND_UTILS_HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// FNV-1a, used to key caches on file contents
+const uint64_t kFnvOffsetBasis64 = 14695981039346656037ull;
+const uint64_t kFnvPrime64 = 1099511628211ull;
+
+inline uint64_t Fnv1a64(uint64_t hash, const void *data, size_t size) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= kFnvPrime64;
+    }
+    return hash;
+}
+
+// Hashes the contents of a file, seeded with seed (e.g. settings that also 
+// invalidate derived data). Returns 0 if the file cannot be read.
+uint64_t HashFile(const std::string &path, uint64_t seed);
+
+// Hashes a file's size and modification time, seeded like HashFile(). A cheap
+// check that it is unchanged, without reading it. Returns 0 if it is missing.
+uint64_t StampFile(const std::string &path, uint64_t seed);
+
+#endif // ISLAND_UTILS_HASH_H_
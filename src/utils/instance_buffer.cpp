@@ -0,0 +1,85 @@
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+
+#include "gl_state.h"
+#include "instance_buffer.h"
+
+// ----------- PUBLIC ----------- //
+InstanceBuffer::InstanceBuffer() : count(0), center(0.0f), radius(0.0f), max_scale(0.0f) {
+    glGenBuffers(1, &buffer);
+}
+
+void InstanceBuffer::CleanUp() {
+    glDeleteBuffers(1, &buffer);
+}
+
+/*
+    Derive each instance's normal matrix, upload the transforms and bound
+    the instance origins.
+*/
+void InstanceBuffer::Upload(const std::vector<glm::mat4> &model_matrices) {
+    this->model_matrices = model_matrices;
+    count = model_matrices.size();
+    std::vector<InstanceTransform> transforms(count);
+    glm::vec3 min(0.0f), max(0.0f);
+    max_scale = 0.0f;
+    for (size_t i = 0; i < count; i++) {
+        const glm::mat4 &model = model_matrices[i];
+        transforms[i].model = model;
+        transforms[i].normal = glm::mat3(glm::transpose(glm::inverse(model)));
+
+        glm::vec3 origin = glm::vec3(model[3]);
+        min = i == 0 ? origin : glm::min(min, origin);
+        max = i == 0 ? origin : glm::max(max, origin);
+        max_scale = std::max(max_scale, std::max(glm::length(glm::vec3(model[0])),
+                             std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2])))));
+    }
+    center = (min + max) * 0.5f;
+    radius = 0.0f;
+    for (const glm::mat4 &model : model_matrices)
+        radius = std::max(radius, glm::length(glm::vec3(model[3]) - center));
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, count * sizeof(InstanceTransform), transforms.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceBuffer::Attach(const Model &model) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    mesh_boxes.clear();
+    for (const Mesh &mesh : model.meshes) {
+        g_gl_state.BindVertexArray(mesh.VAO);
+        SetupInstanceAttributes();
+
+        BoundingBox box = { glm::vec3(0.0f), glm::vec3(0.0f) };
+        for (size_t i = 0; i < count; i++) {
+            BoundingBox instance = TransformBounds(mesh.bounds, model_matrices[i]);
+            box = i == 0 ? instance : MergeBoxes(box, instance);
+        }
+        mesh_boxes.push_back(box);
+    }
+    g_gl_state.BindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+size_t InstanceBuffer::GetCount() const {
+    return count;
+}
+
+const glm::vec3 &InstanceBuffer::GetCenter() const {
+    return center;
+}
+
+float InstanceBuffer::GetRadius() const {
+    return radius;
+}
+
+float InstanceBuffer::GetMaxScale() const {
+    return max_scale;
+}
+
+const BoundingBox &InstanceBuffer::GetMeshBox(size_t mesh) const {
+    return mesh_boxes[mesh];
+}
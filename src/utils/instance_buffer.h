@@ -0,0 +1,54 @@
+#ifndef ISLAND_UTILS_INSTANCE_BUFFER_H_
+#define ISLAND_UTILS_INSTANCE_BUFFER_H_
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+#include "frustum.h"
+#include "model.h"
+#include "vertex_format.h"
+
+/*
+    Per-instance transforms of a model drawn many times with one
+    glDrawElementsInstanced per mesh (see RenderQueue::AddInstanced). The
+    normal matrices are derived once at upload, so a static scatter costs
+    nothing per frame and per instance on the cpu. Also keeps a sphere
+    around every instance's origin, which bounds the whole set for lod
+    selection and sorting, and a world box per mesh of the attached model
+    around all its copies, for culling.
+*/
+class InstanceBuffer {
+public:
+    InstanceBuffer();
+
+    void CleanUp();
+
+    // replaces the instances
+    void Upload(const std::vector<glm::mat4> &model_matrices);
+
+    // adds the per-instance attributes to the vertex arrays of model's meshes, which then read this buffer
+    // in instanced draws (and ignore it otherwise). the model's shaders must use the INSTANCED variant.
+    // call after Upload().
+    void Attach(const Model &model);
+
+    size_t GetCount() const;
+    const glm::vec3 &GetCenter() const;
+    float GetRadius() const;
+    // largest axis scale of any instance
+    float GetMaxScale() const;
+    // box around every instance of the attached model's mesh
+    const BoundingBox &GetMeshBox(size_t mesh) const;
+
+private:
+    unsigned int buffer;
+    size_t count;
+    glm::vec3 center;
+    float radius;
+    float max_scale;
+    std::vector<glm::mat4> model_matrices;
+    std::vector<BoundingBox> mesh_boxes;
+};
+
+#endif // ISLAND_UTILS_INSTANCE_BUFFER_H_
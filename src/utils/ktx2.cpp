@@ -0,0 +1,254 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#include "ktx2.h"
+
+namespace {
+
+const unsigned char kKtx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+const char kSourceHashKey[] = "IslandSourceHash";
+const char kSourceStampKey[] = "IslandSourceStamp";
+
+// VkFormat values
+const uint32_t kVkFormatBC1RgbUnorm = 131;
+const uint32_t kVkFormatBC3Unorm = 137;
+const uint32_t kVkFormatBC5Unorm = 141;
+
+// data format descriptor (khr_df) values
+const uint8_t kDfModelBC1A = 128;
+const uint8_t kDfModelBC3 = 130;
+const uint8_t kDfModelBC5 = 132;
+const uint8_t kDfPrimariesBT709 = 1;
+const uint8_t kDfTransferLinear = 1;
+
+struct Ktx2Header {
+    unsigned char identifier[12];
+    uint32_t vk_format;
+    uint32_t type_size;
+    uint32_t pixel_width;
+    uint32_t pixel_height;
+    uint32_t pixel_depth;
+    uint32_t layer_count;
+    uint32_t face_count;
+    uint32_t level_count;
+    uint32_t supercompression_scheme;
+    uint32_t dfd_byte_offset;
+    uint32_t dfd_byte_length;
+    uint32_t kvd_byte_offset;
+    uint32_t kvd_byte_length;
+    uint64_t sgd_byte_offset;
+    uint64_t sgd_byte_length;
+};
+
+struct Ktx2LevelIndex {
+    uint64_t byte_offset;
+    uint64_t byte_length;
+    uint64_t uncompressed_byte_length;
+};
+
+uint32_t VkFormatFromBlockFormat(eBlockFormat format) {
+    switch (format) {
+    case BLOCK_FORMAT_BC1: return kVkFormatBC1RgbUnorm;
+    case BLOCK_FORMAT_BC3: return kVkFormatBC3Unorm;
+    case BLOCK_FORMAT_BC5: return kVkFormatBC5Unorm;
+    }
+    return 0;
+}
+
+bool BlockFormatFromVkFormat(uint32_t vk_format, eBlockFormat &format) {
+    if (vk_format == kVkFormatBC1RgbUnorm)
+        format = BLOCK_FORMAT_BC1;
+    else if (vk_format == kVkFormatBC3Unorm)
+        format = BLOCK_FORMAT_BC3;
+    else if (vk_format == kVkFormatBC5Unorm)
+        format = BLOCK_FORMAT_BC5;
+    else
+        return false;
+    return true;
+}
+
+void AppendU32(std::vector<unsigned char> &out, uint32_t value) {
+    for (int i = 0; i < 4; i++)
+        out.push_back((value >> (8 * i)) & 0xff);
+}
+
+// one sample per 64 bit half of the block: {channel id, bit offset}
+std::vector<unsigned char> BuildDataFormatDescriptor(eBlockFormat format) {
+    uint8_t model;
+    std::vector<std::pair<uint8_t, uint16_t>> samples;
+    switch (format) {
+    case BLOCK_FORMAT_BC1:
+        model = kDfModelBC1A;
+        samples = { { 0, 0 } };             // color
+        break;
+    case BLOCK_FORMAT_BC3:
+        model = kDfModelBC3;
+        samples = { { 15, 0 }, { 0, 64 } }; // alpha, color
+        break;
+    default:
+        model = kDfModelBC5;
+        samples = { { 0, 0 }, { 1, 64 } };  // red, green
+        break;
+    }
+    uint32_t block_size = 24 + 16 * static_cast<uint32_t>(samples.size());
+
+    std::vector<unsigned char> dfd;
+    AppendU32(dfd, 4 + block_size);                     // dfdTotalSize
+    AppendU32(dfd, 0);                                  // vendorId | descriptorType
+    AppendU32(dfd, 2 | (block_size << 16));             // versionNumber | descriptorBlockSize
+    AppendU32(dfd, model | (kDfPrimariesBT709 << 8) | (kDfTransferLinear << 16)); // flags = straight alpha
+    AppendU32(dfd, 3 | (3 << 8));                       // texel block 4x4x1x1 (stored minus one)
+    AppendU32(dfd, static_cast<uint32_t>(GetBlockSize(format))); // bytesPlane0
+    AppendU32(dfd, 0);                                  // bytesPlane4..7
+    for (const auto &sample : samples) {
+        AppendU32(dfd, sample.second | (63u << 16) | (uint32_t(sample.first) << 24));
+        AppendU32(dfd, 0);                              // sample position
+        AppendU32(dfd, 0);                              // sampleLower
+        AppendU32(dfd, 0xFFFFFFFFu);                    // sampleUpper
+    }
+    return dfd;
+}
+
+// one key/value entry with a hex value, padded to 4 bytes as the spec requires
+void AppendKeyValue(std::vector<unsigned char> &kvd, const char *key, uint64_t value) {
+    char text[17];
+    std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(value));
+    size_t key_size = std::strlen(key) + 1; // includes the nul
+    AppendU32(kvd, static_cast<uint32_t>(key_size + sizeof(text)));
+    kvd.insert(kvd.end(), key, key + key_size);
+    kvd.insert(kvd.end(), text, text + sizeof(text));
+    while (kvd.size() % 4 != 0)
+        kvd.push_back(0);
+}
+
+// entries are sorted by key, as the spec requires
+std::vector<unsigned char> BuildKeyValueData(const Ktx2Source &source) {
+    std::vector<unsigned char> kvd;
+    AppendKeyValue(kvd, kSourceHashKey, source.hash);
+    AppendKeyValue(kvd, kSourceStampKey, source.stamp);
+    return kvd;
+}
+
+// returns the hex value of key in the key/value data, 0 if it has none
+uint64_t FindKeyValue(const unsigned char *kvd, size_t length, const char *key) {
+    size_t offset = 0;
+    while (offset + 4 <= length) {
+        uint32_t entry_length;
+        std::memcpy(&entry_length, kvd + offset, 4);
+        offset += 4;
+        if (offset + entry_length > length)
+            return 0;
+        const char *entry = reinterpret_cast<const char *>(kvd + offset);
+        size_t key_length = strnlen(entry, entry_length);
+        if (key_length + 1 < entry_length && std::strcmp(entry, key) == 0) {
+            std::string value(entry + key_length + 1, strnlen(entry + key_length + 1, entry_length - key_length - 1));
+            return std::strtoull(value.c_str(), nullptr, 16);
+        }
+        offset = (offset + entry_length + 3) & ~size_t(3);
+    }
+    return 0;
+}
+
+} // namespace
+
+/*
+    Levels are stored smallest first as the spec recommends (so a streaming
+    reader gets a usable low res image early), each aligned to the block size.
+*/
+bool WriteKtx2(const std::string &path, const CompressedImage &image, const Ktx2Source &source) {
+    std::vector<unsigned char> dfd = BuildDataFormatDescriptor(image.format);
+    std::vector<unsigned char> kvd = BuildKeyValueData(source);
+    size_t alignment = GetBlockSize(image.format);
+    size_t level_count = image.levels.size();
+
+    Ktx2Header header = {};
+    std::memcpy(header.identifier, kKtx2Identifier, sizeof(kKtx2Identifier));
+    header.vk_format = VkFormatFromBlockFormat(image.format);
+    header.type_size = 1;
+    header.pixel_width = image.width;
+    header.pixel_height = image.height;
+    header.face_count = 1;
+    header.level_count = static_cast<uint32_t>(level_count);
+    header.dfd_byte_offset = static_cast<uint32_t>(sizeof(Ktx2Header) + level_count * sizeof(Ktx2LevelIndex));
+    header.dfd_byte_length = static_cast<uint32_t>(dfd.size());
+    header.kvd_byte_offset = header.dfd_byte_offset + header.dfd_byte_length;
+    header.kvd_byte_length = static_cast<uint32_t>(kvd.size());
+
+    std::vector<Ktx2LevelIndex> level_index(level_count);
+    uint64_t offset = header.kvd_byte_offset + header.kvd_byte_length;
+    for (size_t l = level_count; l-- > 0;) {
+        offset = (offset + alignment - 1) / alignment * alignment;
+        level_index[l].byte_offset = offset;
+        level_index[l].byte_length = image.levels[l].data.size();
+        level_index[l].uncompressed_byte_length = image.levels[l].data.size();
+        offset += image.levels[l].data.size();
+    }
+
+    std::string temp_path = path + ".tmp";
+    std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(level_index.data()), level_count * sizeof(Ktx2LevelIndex));
+    out.write(reinterpret_cast<const char *>(dfd.data()), dfd.size());
+    out.write(reinterpret_cast<const char *>(kvd.data()), kvd.size());
+    uint64_t written = header.kvd_byte_offset + header.kvd_byte_length;
+    for (size_t l = level_count; l-- > 0;) {
+        static const char zeros[16] = {};
+        out.write(zeros, level_index[l].byte_offset - written);
+        out.write(reinterpret_cast<const char *>(image.levels[l].data.data()), image.levels[l].data.size());
+        written = level_index[l].byte_offset + level_index[l].byte_length;
+    }
+    out.close();
+
+    if (!out || std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        std::cout << "ERROR::KTX2::FAILED_TO_WRITE " << path << std::endl;
+        std::remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool ReadKtx2(const std::string &path, CompressedImage &image, Ktx2Source &source) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return false;
+    std::vector<unsigned char> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (file.size() < sizeof(Ktx2Header))
+        return false;
+
+    Ktx2Header header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    eBlockFormat format;
+    if (std::memcmp(header.identifier, kKtx2Identifier, sizeof(kKtx2Identifier)) != 0 ||
+        !BlockFormatFromVkFormat(header.vk_format, format) ||
+        header.supercompression_scheme != 0 || header.level_count == 0 ||
+        header.pixel_depth > 1 || header.layer_count > 1 || header.face_count != 1 ||
+        sizeof(Ktx2Header) + uint64_t(header.level_count) * sizeof(Ktx2LevelIndex) > file.size() ||
+        uint64_t(header.kvd_byte_offset) + header.kvd_byte_length > file.size())
+        return false;
+    const unsigned char *kvd = file.data() + header.kvd_byte_offset;
+    source.hash = FindKeyValue(kvd, header.kvd_byte_length, kSourceHashKey);
+    source.stamp = FindKeyValue(kvd, header.kvd_byte_length, kSourceStampKey);
+
+    image.format = format;
+    image.width = header.pixel_width;
+    image.height = header.pixel_height;
+    image.levels.resize(header.level_count);
+    const Ktx2LevelIndex *level_index = reinterpret_cast<const Ktx2LevelIndex *>(file.data() + sizeof(Ktx2Header));
+    for (uint32_t l = 0; l < header.level_count; l++) {
+        if (level_index[l].byte_offset + level_index[l].byte_length > file.size())
+            return false;
+        CompressedLevel &level = image.levels[l];
+        level.width = std::max(1u, header.pixel_width >> l);
+        level.height = std::max(1u, header.pixel_height >> l);
+        const unsigned char *data = file.data() + level_index[l].byte_offset;
+        level.data.assign(data, data + level_index[l].byte_length);
+    }
+    return true;
+}
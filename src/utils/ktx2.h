@@ -0,0 +1,29 @@
+#ifndef ISLAND_UTILS_KTX2_H_
+#define ISLAND_UTILS_KTX2_H_
+
+#include <cstdint>
+#include <string>
+
+#include "texture_compressor.h"
+
+/*
+    Minimal KTX2 (Khronos texture container v2) support for block compressed
+    2D textures with a full mip chain. The source image is identified in the
+    key/value data so stale files are detected: by a stamp of its size and
+    modification time, checked first as it needs no read of the source, and
+    by a hash of its contents for when the stamp differs.
+*/
+
+struct Ktx2Source {
+    uint64_t hash;  // see HashFile()
+    uint64_t stamp; // see StampFile()
+};
+
+// Writes image to path. Returns false on I/O failure.
+bool WriteKtx2(const std::string &path, const CompressedImage &image, const Ktx2Source &source);
+
+// Reads a bc1/bc3/bc5 KTX2 file and the source it was written from (zero
+// where it has no such key). Returns false if it is missing or malformed.
+bool ReadKtx2(const std::string &path, CompressedImage &image, Ktx2Source &source);
+
+#endif // ISLAND_UTILS_KTX2_H_
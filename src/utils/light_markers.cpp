@@ -0,0 +1,67 @@
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "gl_state.h"
+#include "light_markers.h"
+
+// ----------- PUBLIC ----------- //
+/*
+    Create the shared quad and an (initially empty) instance buffer.
+*/
+LightMarkers::LightMarkers() : instance_capacity(0) {
+    // quad corners in [-1, 1], expanded around each marker in the vertex shader
+    const float corners[] = {
+        -1.0f, -1.0f,
+         1.0f, -1.0f,
+        -1.0f,  1.0f,
+         1.0f,  1.0f
+    };
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &quad_buffer);
+    glGenBuffers(1, &instance_buffer);
+
+    g_gl_state.BindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, quad_buffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+
+    // position + radius, color; advance once per marker
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(LightMarker), (void*)offsetof(LightMarker, position));
+    glVertexAttribDivisor(1, 1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(LightMarker), (void*)offsetof(LightMarker, color));
+    glVertexAttribDivisor(2, 1);
+    g_gl_state.BindVertexArray(0);
+}
+
+/*
+    Free the vertex array and its buffers.
+*/
+void LightMarkers::CleanUp() {
+    g_gl_state.DeleteVertexArray(vao);
+    glDeleteBuffers(1, &quad_buffer);
+    glDeleteBuffers(1, &instance_buffer);
+}
+
+/*
+    Upload this frame's markers (orphaning last frame's storage, growing it 
+    when needed) and draw all of them with one call.
+*/
+void LightMarkers::Draw(const Shader &shader, const std::vector<LightMarker> &markers) {
+    if (markers.empty())
+        return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+    if (markers.size() > instance_capacity)
+        instance_capacity = markers.size();
+    glBufferData(GL_ARRAY_BUFFER, instance_capacity * sizeof(LightMarker), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, markers.size() * sizeof(LightMarker), markers.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    shader.use();
+    g_gl_state.BindVertexArray(vao);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(markers.size()));
+}
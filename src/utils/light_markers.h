@@ -0,0 +1,42 @@
+#ifndef ISLAND_UTILS_LIGHT_MARKERS_H_
+#define ISLAND_UTILS_LIGHT_MARKERS_H_
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+#include "shader.h"
+
+// per-instance record of one light marker, laid out as two vec4 attributes
+struct LightMarker {
+    glm::vec3 position;
+    float radius;
+    glm::vec3 color;
+    float padding;
+};
+
+/*
+    Draws point lights as glowing spheres without sphere geometry. Every
+    marker is one camera facing quad that bounds the sphere's silhouette;
+    the fragment shader (light_marker.frag) intersects the view ray with the
+    sphere analytically and writes the hit's depth, so markers sort correctly
+    against the scene. All markers go out in one instanced draw call.
+*/
+class LightMarkers {
+public:
+    LightMarkers();
+
+    void CleanUp();
+
+    // draws with the view bound to the Camera block
+    void Draw(const Shader &shader, const std::vector<LightMarker> &markers);
+
+private:
+    unsigned int vao;
+    unsigned int quad_buffer;
+    unsigned int instance_buffer;
+    size_t instance_capacity;
+};
+
+#endif // ISLAND_UTILS_LIGHT_MARKERS_H_
@@ -6,8 +6,12 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "gl_state.h"
 #include "shader.h"
+#include "texture_registry.h"
+#include "vertex_format.h"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 using namespace std;
@@ -35,41 +39,98 @@ struct Texture {
     unsigned int id;
     string type;
     string path;
+    TextureHandle handle; // keeps the shared registry texture alive
+    string sampler;       // sampler uniform name (type + N, e.g. texture_diffuse1), set by the Mesh
+    uint32_t samplerHash; // HashUniformName(sampler)
+};
+
+// a material texture reference (sampler type + file path relative to the model directory), resolved to a Texture at upload
+struct TextureRef {
+    string type;
+    string path;
+};
+
+// one level of detail: a range of the mesh's index buffer over the shared vertices
+struct MeshLod {
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    float        error; // simplification error relative to the bounding radius (0 for full detail)
+};
+
+// local space bounds
+struct MeshBounds {
+    glm::vec3 min;
+    glm::vec3 max;
+    glm::vec3 center; // of the box, and of the bounding sphere
+    float     radius;
+};
+
+// triangles per cluster. small enough that a cluster is mostly on one side of the water, large enough
+// that the ranges of a partly culled mesh stay few.
+const unsigned int kMeshClusterTriangles = 128;
+
+// a run of full detail triangles and its local space box, the unit straddling meshes are clip culled in
+struct MeshCluster {
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    glm::vec3    min;
+    glm::vec3    max;
+};
+
+// cpu-side mesh data produced by the importer, before it is uploaded to the gpu
+struct MeshData {
+    vector<Vertex>       vertices;
+    vector<unsigned int> indices;   // every lod's indices, back to back
+    vector<MeshLod>      lods;      // full detail first; empty means one lod covering all indices
+    MeshBounds           bounds;
+    vector<TextureRef>   textures;
 };
 
 class Mesh {
 public:
     // mesh Data
-    vector<Vertex>       vertices;
-    vector<unsigned int> indices;
+    unsigned int         vertexCount;
+    unsigned int         indexCount;
+    vector<MeshLod>      lods;
+    MeshBounds           bounds;
+    vector<MeshCluster>  clusters;  // lod 0 in runs of kMeshClusterTriangles (the optimiser keeps runs spatially coherent)
+    // the full detail lod kept on the cpu for software occlusion (simplified ones can bulge past it): the local
+    // positions it uses and indices into them
+    vector<glm::vec3>    occluderPositions;
+    vector<unsigned int> occluderIndices;
     vector<Texture>      textures;
+    eVertexLayout        layout;
     unsigned int VAO;
 
     // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    Mesh(const MeshData &data, vector<Texture> textures, eVertexLayout layout)
+        : Mesh(data.vertices.data(), data.vertices.size(), data.indices.data(), data.indices.size(), data.lods, data.bounds, textures, layout)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
-
-        // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
     }
 
-    // render the mesh
-    void Draw(Shader &shader) const
+    // constructor from raw arrays, e.g. pointing straight into a memory-mapped mesh cache. the vertices are 
+    // packed into the given gpu layout and not retained.
+    Mesh(const Vertex *vertices, size_t numVertices, const unsigned int *indices, size_t numIndices, 
+         const vector<MeshLod> &lods, const MeshBounds &bounds, vector<Texture> textures, eVertexLayout layout)
     {
-        // bind appropriate textures
+        this->vertexCount = static_cast<unsigned int>(numVertices);
+        this->indexCount = static_cast<unsigned int>(numIndices);
+        this->lods = lods;
+        if(this->lods.empty())
+            this->lods.push_back(MeshLod{0, indexCount, 0.0f});
+        this->bounds = bounds;
+        this->textures = textures;
+        this->layout = layout;
+
+        // name each texture's sampler: the type plus its number among textures of that type (the N in texture_diffuseN)
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
+        for(Texture &texture : this->textures)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
             string number;
-            string name = textures[i].type;
+            string name = texture.type;
             if(name == "texture_diffuse")
                 number = std::to_string(diffuseNr++);
             else if(name == "texture_specular")
@@ -78,69 +139,97 @@ public:
                 number = std::to_string(normalNr++); // transfer unsigned int to string
              else if(name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to string
+            texture.sampler = name + number;
+            texture.samplerHash = HashUniformName(texture.sampler.c_str());
+        }
+
+        buildClusters(vertices, indices);
+        buildOccluder(vertices, indices);
+
+        // now that we have all the required data, set the vertex buffers and its attribute pointers.
+        setupMesh(vertices, indices);
+    }
 
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+    // render the mesh at the given level of detail (clamped to the coarsest one)
+    void Draw(const Shader &shader, size_t lod = 0) const
+    {
+        // bind appropriate textures
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            // set the sampler to the correct texture unit
+            shader.setInt(UniformId(textures[i].samplerHash, textures[i].sampler.c_str()), i);
+            // and bind the texture there (g_gl_state skips it if it is already bound)
+            g_gl_state.BindTextureUnit(i, GL_TEXTURE_2D, textures[i].id);
         }
         
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+        // draw mesh. bindings are left as they are, every bind goes through g_gl_state
+        const MeshLod &level = lods[std::min(lod, lods.size() - 1)];
+        g_gl_state.BindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT, (void*)(level.indexOffset * sizeof(unsigned int)));
     }
 
 private:
     // render data 
     unsigned int VBO, EBO;
 
+    // splits the full detail index range into clusters and bounds each one
+    void buildClusters(const Vertex *vertices, const unsigned int *indices)
+    {
+        const MeshLod &level = lods[0];
+        const unsigned int clusterIndices = kMeshClusterTriangles * 3;
+        for(unsigned int begin = 0; begin < level.indexCount; begin += clusterIndices)
+        {
+            MeshCluster cluster;
+            cluster.indexOffset = level.indexOffset + begin;
+            cluster.indexCount = std::min(clusterIndices, level.indexCount - begin);
+            cluster.min = cluster.max = vertices[indices[cluster.indexOffset]].Position;
+            for(unsigned int i = cluster.indexOffset; i < cluster.indexOffset + cluster.indexCount; i++)
+            {
+                cluster.min = glm::min(cluster.min, vertices[indices[i]].Position);
+                cluster.max = glm::max(cluster.max, vertices[indices[i]].Position);
+            }
+            clusters.push_back(cluster);
+        }
+    }
+
+    // copies out the full detail lod, keeping only the vertices it references
+    void buildOccluder(const Vertex *vertices, const unsigned int *indices)
+    {
+        const MeshLod &level = lods.front();
+        vector<unsigned int> remap(vertexCount, ~0u);
+        occluderIndices.reserve(level.indexCount);
+        for(unsigned int i = level.indexOffset; i < level.indexOffset + level.indexCount; i++)
+        {
+            unsigned int &index = remap[indices[i]];
+            if(index == ~0u)
+            {
+                index = static_cast<unsigned int>(occluderPositions.size());
+                occluderPositions.push_back(vertices[indices[i]].Position);
+            }
+            occluderIndices.push_back(index);
+        }
+    }
+
     // initializes all the buffer objects/arrays
-    void setupMesh()
+    void setupMesh(const Vertex *vertices, const unsigned int *indices)
     {
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
+        g_gl_state.BindVertexArray(VAO);
+        // pack the vertices into the mesh's layout and load them into the vertex buffer
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);  
+        vector<unsigned char> packed = EncodeVertices(layout, vertices, vertexCount);
+        glBufferData(GL_ARRAY_BUFFER, packed.size(), packed.data(), GL_STATIC_DRAW);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);	
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);	
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);	
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-		// ids
-		glEnableVertexAttribArray(5);
-		glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
-
-		// weights
-		glEnableVertexAttribArray(6);
-		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
-        glBindVertexArray(0);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+
+        // set the vertex attribute pointers described by the layout
+        SetupVertexAttributes(layout);
+        g_gl_state.BindVertexArray(0);
     }
 };
 #endif
\ No newline at end of file
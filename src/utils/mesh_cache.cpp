@@ -0,0 +1,245 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "hash.h"
+#include "mesh_cache.h"
+
+namespace {
+
+const char kMeshCacheMagic[4] = { 'I', 'M', 'S', 'H' };
+
+uint64_t AlignTo8(uint64_t offset) {
+    return (offset + 7) & ~uint64_t(7);
+}
+
+void WritePadding(std::ofstream& out, uint64_t& offset) {
+    static const char zeros[8] = {};
+    uint64_t aligned = AlignTo8(offset);
+    out.write(zeros, aligned - offset);
+    offset = aligned;
+}
+
+void WriteString(std::ofstream& out, uint64_t& offset, const std::string& str) {
+    uint32_t length = static_cast<uint32_t>(str.size());
+    out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    out.write(str.data(), length);
+    offset += sizeof(length) + length;
+}
+
+// reads a length-prefixed string, returns false if it runs past end
+bool ReadString(const unsigned char* data, size_t size, uint64_t& offset, std::string& str) {
+    uint32_t length;
+    if (offset + sizeof(length) > size)
+        return false;
+    std::memcpy(&length, data + offset, sizeof(length));
+    offset += sizeof(length);
+    if (offset + length > size)
+        return false;
+    str.assign(reinterpret_cast<const char*>(data + offset), length);
+    offset += length;
+    return true;
+}
+
+} // namespace
+
+// ----------- PUBLIC ----------- //
+MeshCache::MeshCache() : mapped_data(nullptr), mapped_size(0) {}
+
+MeshCache::~MeshCache() {
+    Close();
+}
+
+/*
+    Map the cache file of source_path into memory and validate it against the
+    current source file. On success the cached meshes point into the mapping.
+*/
+bool MeshCache::Open(const std::string& source_path, uint64_t import_flags) {
+    Close();
+
+    std::string cache_path = GetCachePath(source_path);
+    int fd = open(cache_path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(MeshCacheHeader)) {
+        close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps its own reference to the file
+    if (data == MAP_FAILED)
+        return false;
+
+    mapped_data = data;
+    mapped_size = static_cast<size_t>(info.st_size);
+
+    if (!ParseMappedData(HashSourceFile(source_path, import_flags))) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+/*
+    Unmap the cache file. Invalidates all cached mesh pointers.
+*/
+void MeshCache::Close() {
+    meshes.clear();
+    if (mapped_data != nullptr) {
+        munmap(mapped_data, mapped_size);
+        mapped_data = nullptr;
+        mapped_size = 0;
+    }
+}
+
+const std::vector<CachedMesh>& MeshCache::GetMeshes() const {
+    return meshes;
+}
+
+/*
+    Serialize the imported meshes of source_path. The file is written under a
+    temporary name and renamed into place so readers never see a partial cache.
+*/
+bool MeshCache::Write(const std::string& source_path, uint64_t import_flags, const std::vector<MeshData>& mesh_data) {
+    std::string cache_path = GetCachePath(source_path);
+    std::string temp_path = cache_path + ".tmp";
+
+    std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cout << "ERROR::MESH_CACHE::FAILED_TO_OPEN " << temp_path << std::endl;
+        return false;
+    }
+
+    MeshCacheHeader header;
+    std::memcpy(header.magic, kMeshCacheMagic, sizeof(header.magic));
+    header.version = kMeshCacheVersion;
+    header.source_hash = HashSourceFile(source_path, import_flags);
+    header.mesh_count = static_cast<uint32_t>(mesh_data.size());
+    header.vertex_stride = sizeof(Vertex);
+
+    // compute section offsets up front so the entry table can be written first
+    std::vector<MeshCacheEntry> entries(mesh_data.size());
+    uint64_t offset = sizeof(MeshCacheHeader) + entries.size() * sizeof(MeshCacheEntry);
+    for (size_t i = 0; i < mesh_data.size(); i++) {
+        const MeshData& mesh = mesh_data[i];
+        MeshCacheEntry& entry = entries[i];
+        entry.texture_offset = AlignTo8(offset);
+        offset = entry.texture_offset;
+        for (const TextureRef& ref : mesh.textures)
+            offset += 2 * sizeof(uint32_t) + ref.type.size() + ref.path.size();
+        entry.lod_offset = AlignTo8(offset);
+        offset = entry.lod_offset + mesh.lods.size() * sizeof(MeshLod);
+        entry.vertex_offset = AlignTo8(offset);
+        offset = entry.vertex_offset + mesh.vertices.size() * sizeof(Vertex);
+        entry.index_offset = AlignTo8(offset);
+        offset = entry.index_offset + mesh.indices.size() * sizeof(unsigned int);
+        entry.texture_count = static_cast<uint32_t>(mesh.textures.size());
+        entry.lod_count = static_cast<uint32_t>(mesh.lods.size());
+        entry.vertex_count = static_cast<uint32_t>(mesh.vertices.size());
+        entry.index_count = static_cast<uint32_t>(mesh.indices.size());
+        entry.bounds = mesh.bounds;
+    }
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(MeshCacheEntry));
+    offset = sizeof(MeshCacheHeader) + entries.size() * sizeof(MeshCacheEntry);
+    for (const MeshData& mesh : mesh_data) {
+        WritePadding(out, offset);
+        for (const TextureRef& ref : mesh.textures) {
+            WriteString(out, offset, ref.type);
+            WriteString(out, offset, ref.path);
+        }
+        WritePadding(out, offset);
+        out.write(reinterpret_cast<const char*>(mesh.lods.data()), mesh.lods.size() * sizeof(MeshLod));
+        offset += mesh.lods.size() * sizeof(MeshLod);
+        WritePadding(out, offset);
+        out.write(reinterpret_cast<const char*>(mesh.vertices.data()), mesh.vertices.size() * sizeof(Vertex));
+        offset += mesh.vertices.size() * sizeof(Vertex);
+        WritePadding(out, offset);
+        out.write(reinterpret_cast<const char*>(mesh.indices.data()), mesh.indices.size() * sizeof(unsigned int));
+        offset += mesh.indices.size() * sizeof(unsigned int);
+    }
+    out.close();
+
+    if (!out || std::rename(temp_path.c_str(), cache_path.c_str()) != 0) {
+        std::cout << "ERROR::MESH_CACHE::FAILED_TO_WRITE " << cache_path << std::endl;
+        std::remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::string MeshCache::GetCachePath(const std::string& source_path) {
+    return source_path + ".meshcache";
+}
+
+/*
+    Hash of the source file contents, seeded with the import flags so a change
+    in post-processing also invalidates the cache. Returns 0 if the source 
+    cannot be read.
+*/
+uint64_t MeshCache::HashSourceFile(const std::string& source_path, uint64_t import_flags) {
+    return HashFile(source_path, import_flags);
+}
+
+// ----------- PRIVATE ----------- //
+/*
+    Validate the header and build the mesh table. No vertex or index data is
+    touched here; it is only bounds-checked.
+*/
+bool MeshCache::ParseMappedData(uint64_t expected_hash) {
+    const unsigned char* data = static_cast<const unsigned char*>(mapped_data);
+
+    MeshCacheHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, kMeshCacheMagic, sizeof(header.magic)) != 0 ||
+        header.version != kMeshCacheVersion ||
+        header.vertex_stride != sizeof(Vertex) ||
+        expected_hash == 0 || header.source_hash != expected_hash)
+        return false;
+
+    uint64_t table_end = sizeof(MeshCacheHeader) + uint64_t(header.mesh_count) * sizeof(MeshCacheEntry);
+    if (table_end > mapped_size)
+        return false;
+
+    const MeshCacheEntry* entries = reinterpret_cast<const MeshCacheEntry*>(data + sizeof(MeshCacheHeader));
+    meshes.resize(header.mesh_count);
+    for (uint32_t i = 0; i < header.mesh_count; i++) {
+        const MeshCacheEntry& entry = entries[i];
+        CachedMesh& mesh = meshes[i];
+
+        uint64_t offset = entry.texture_offset;
+        mesh.textures.resize(entry.texture_count);
+        for (TextureRef& ref : mesh.textures) {
+            if (!ReadString(data, mapped_size, offset, ref.type) || !ReadString(data, mapped_size, offset, ref.path))
+                return false;
+        }
+
+        if (entry.lod_offset + uint64_t(entry.lod_count) * sizeof(MeshLod) > mapped_size ||
+            entry.vertex_offset + uint64_t(entry.vertex_count) * sizeof(Vertex) > mapped_size ||
+            entry.index_offset + uint64_t(entry.index_count) * sizeof(unsigned int) > mapped_size)
+            return false;
+
+        const MeshLod* lods = reinterpret_cast<const MeshLod*>(data + entry.lod_offset);
+        mesh.lods.assign(lods, lods + entry.lod_count);
+        for (const MeshLod& lod : mesh.lods) {
+            if (uint64_t(lod.indexOffset) + lod.indexCount > entry.index_count)
+                return false;
+        }
+        mesh.bounds = entry.bounds;
+        mesh.vertices = reinterpret_cast<const Vertex*>(data + entry.vertex_offset);
+        mesh.num_vertices = entry.vertex_count;
+        mesh.indices = reinterpret_cast<const unsigned int*>(data + entry.index_offset);
+        mesh.num_indices = entry.index_count;
+    }
+    return true;
+}
@@ -0,0 +1,86 @@
+#ifndef ISLAND_UTILS_MESH_CACHE_H_
+#define ISLAND_UTILS_MESH_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mesh.h"
+
+/*
+    Versioned binary cache of imported meshes. The first import of a model
+    writes <model path>.meshcache next to the source file; later runs map
+    the cache into memory and hand the vertex/index bytes straight to the
+    gpu without running ASSIMP.
+
+    File layout (native endianness, sections 8 byte aligned):
+        MeshCacheHeader
+        MeshCacheEntry[mesh_count]
+        per mesh: texture refs | lods | vertices | indices
+*/
+
+// bump whenever the file layout or the import pipeline output changes
+const uint32_t kMeshCacheVersion = 4;
+
+struct MeshCacheHeader {
+    char magic[4];          // "IMSH"
+    uint32_t version;
+    uint64_t source_hash;   // hash of the source model file + import settings
+    uint32_t mesh_count;
+    uint32_t vertex_stride; // sizeof(Vertex) when the cache was written
+};
+
+struct MeshCacheEntry {
+    uint64_t texture_offset;
+    uint64_t lod_offset;
+    uint64_t vertex_offset;
+    uint64_t index_offset;
+    uint32_t texture_count;
+    uint32_t lod_count;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    MeshBounds bounds;
+};
+
+// a mesh stored in a mapped cache file; pointers stay valid while the cache is open
+struct CachedMesh {
+    const Vertex* vertices;
+    size_t num_vertices;
+    const unsigned int* indices;
+    size_t num_indices;
+    std::vector<MeshLod> lods;
+    MeshBounds bounds;
+    std::vector<TextureRef> textures;
+};
+
+class MeshCache {
+public:
+    MeshCache();
+    ~MeshCache();
+
+    MeshCache(const MeshCache&) = delete;
+    MeshCache& operator=(const MeshCache&) = delete;
+
+    // Maps the cache belonging to source_path. Returns false if it is missing,
+    // stale, or was written by a different cache version.
+    bool Open(const std::string& source_path, uint64_t import_flags);
+    void Close();
+
+    const std::vector<CachedMesh>& GetMeshes() const;
+
+    // Writes the cache for source_path. Returns false on I/O failure.
+    static bool Write(const std::string& source_path, uint64_t import_flags, const std::vector<MeshData>& meshes);
+
+    static std::string GetCachePath(const std::string& source_path);
+    static uint64_t HashSourceFile(const std::string& source_path, uint64_t import_flags);
+
+private:
+    void* mapped_data;
+    size_t mapped_size;
+    std::vector<CachedMesh> meshes;
+
+    bool ParseMappedData(uint64_t expected_hash);
+};
+
+#endif // ISLAND_UTILS_MESH_CACHE_H_
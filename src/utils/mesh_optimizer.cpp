@@ -0,0 +1,334 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "mesh_optimizer.h"
+
+namespace {
+
+const uint32_t kEmptySlot = 0xffffffffu;
+
+/*
+    Fifo post-transform cache model. A vertex is cached while fewer than 
+    kVertexCacheSize misses happened since it was loaded; Flush() evicts
+    everything without touching the per-vertex state.
+*/
+class VertexCacheModel {
+public:
+    explicit VertexCacheModel(size_t vertex_count) : loaded_at(vertex_count, 0), misses(kVertexCacheSize) {}
+
+    // returns true on a miss
+    bool Access(unsigned int vertex) {
+        if (misses - loaded_at[vertex] < kVertexCacheSize)
+            return false;
+        loaded_at[vertex] = ++misses;
+        return true;
+    }
+
+    void Flush() {
+        misses += kVertexCacheSize;
+    }
+
+private:
+    std::vector<size_t> loaded_at;
+    size_t misses;
+};
+
+/*
+    Hash a vertex record a word at a time. Each word is mixed independently
+    (no dependency between words until the final xor), so the loop unrolls
+    and vectorises.
+*/
+uint64_t HashVertex(const Vertex &vertex) {
+    static_assert(sizeof(Vertex) % sizeof(uint64_t) == 0, "vertex records are hashed in 8 byte words");
+    const size_t kNumWords = sizeof(Vertex) / sizeof(uint64_t);
+    uint64_t words[kNumWords];
+    std::memcpy(words, &vertex, sizeof(Vertex));
+
+    uint64_t hash = 0;
+    for (size_t i = 0; i < kNumWords; i++) {
+        uint64_t word = (words[i] + i) * 0x9e3779b97f4a7c15ull;
+        hash ^= word ^ (word >> 29);
+    }
+    return hash ^ (hash >> 32);
+}
+
+size_t NextPowerOfTwo(size_t value) {
+    size_t power = 1;
+    while (power < value)
+        power <<= 1;
+    return power;
+}
+
+} // namespace
+
+/*
+    Open addressing table of new vertex indices keyed on the vertex record.
+    Kept at most half full so probe sequences stay short.
+*/
+size_t WeldVertices(MeshData &mesh) {
+    std::vector<Vertex> &vertices = mesh.vertices;
+    if (vertices.empty())
+        return 0;
+
+    size_t mask = NextPowerOfTwo(vertices.size() * 2) - 1;
+    std::vector<uint32_t> table(mask + 1, kEmptySlot);
+    std::vector<uint32_t> remap(vertices.size());
+    std::vector<Vertex> welded;
+    welded.reserve(vertices.size());
+
+    for (size_t i = 0; i < vertices.size(); i++) {
+        size_t slot = HashVertex(vertices[i]) & mask;
+        while (table[slot] != kEmptySlot && std::memcmp(&welded[table[slot]], &vertices[i], sizeof(Vertex)) != 0)
+            slot = (slot + 1) & mask;
+        if (table[slot] == kEmptySlot) {
+            table[slot] = static_cast<uint32_t>(welded.size());
+            welded.push_back(vertices[i]);
+        }
+        remap[i] = table[slot];
+    }
+
+    for (unsigned int &index : mesh.indices)
+        index = remap[index];
+    vertices.swap(welded);
+    return vertices.size();
+}
+
+/*
+    Replay the index buffer through a fifo cache and count misses.
+*/
+VertexCacheStats AnalyzeVertexCache(const std::vector<unsigned int> &indices, size_t vertex_count) {
+    VertexCacheStats stats = { 0.0f, 0.0f };
+    if (indices.empty() || vertex_count == 0)
+        return stats;
+
+    VertexCacheModel cache(vertex_count);
+    size_t misses = 0;
+    for (unsigned int index : indices)
+        misses += cache.Access(index);
+    stats.acmr = float(misses) / float(indices.size() / 3);
+    stats.atvr = float(misses) / float(vertex_count);
+    return stats;
+}
+
+/*
+    Tipsify (Sander, Nehab & Barczak 2007). Fans around one vertex at a time,
+    choosing the next fanning vertex among the ones just emitted: the oldest
+    one that will still be in the cache after its remaining triangles are
+    emitted. When none is left it backtracks through recently used vertices
+    (dead ends), then falls back to the next vertex in input order, which
+    starts a new cluster. Runs in linear time.
+*/
+void OptimizeVertexCache(std::vector<unsigned int> &indices, size_t vertex_count, std::vector<size_t> *clusters) {
+    size_t triangle_count = indices.size() / 3;
+    if (clusters != nullptr)
+        clusters->clear();
+    if (triangle_count == 0)
+        return;
+
+    // vertex -> triangle adjacency, as offsets into one array
+    std::vector<unsigned int> live(vertex_count, 0);
+    for (unsigned int index : indices)
+        live[index]++;
+    std::vector<size_t> offsets(vertex_count + 1, 0);
+    for (size_t v = 0; v < vertex_count; v++)
+        offsets[v + 1] = offsets[v] + live[v];
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < triangle_count; t++)
+        for (int k = 0; k < 3; k++)
+            adjacency[fill[indices[t * 3 + k]]++] = static_cast<unsigned int>(t);
+
+    std::vector<size_t> cache_time(vertex_count, 0);
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<unsigned int> dead_ends;
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+
+    size_t time = kVertexCacheSize + 1;
+    size_t cursor = 0;  // input order fallback
+    long fanning = 0;
+    if (clusters != nullptr)
+        clusters->push_back(0);
+
+    while (fanning >= 0) {
+        candidates.clear();
+        for (size_t a = offsets[fanning]; a < offsets[fanning + 1]; a++) {
+            unsigned int t = adjacency[a];
+            if (emitted[t])
+                continue;
+            for (int k = 0; k < 3; k++) {
+                unsigned int v = indices[t * 3 + k];
+                output.push_back(v);
+                dead_ends.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cache_time[v] > kVertexCacheSize)
+                    cache_time[v] = time++;
+            }
+            emitted[t] = true;
+        }
+
+        // next fanning vertex: oldest candidate still in the cache once its fan is done
+        long next = -1;
+        long best_priority = -1;
+        for (unsigned int v : candidates) {
+            if (live[v] == 0)
+                continue;
+            long priority = 0;
+            if (time - cache_time[v] + 2 * live[v] <= kVertexCacheSize)
+                priority = long(time - cache_time[v]);
+            if (priority > best_priority) {
+                best_priority = priority;
+                next = v;
+            }
+        }
+        if (next == -1) {
+            while (!dead_ends.empty() && next == -1) {
+                unsigned int v = dead_ends.back();
+                dead_ends.pop_back();
+                if (live[v] > 0)
+                    next = v;
+            }
+        }
+        if (next == -1) {
+            while (cursor < vertex_count && live[cursor] == 0)
+                cursor++;
+            if (cursor < vertex_count) {
+                next = long(cursor);
+                if (clusters != nullptr && output.size() / 3 > clusters->back())
+                    clusters->push_back(output.size() / 3);
+            }
+        }
+        fanning = next;
+    }
+    indices.swap(output);
+}
+
+/*
+    Sander et al.'s linear-speed overdraw ordering: split the hard clusters
+    from Tipsify where the local acmr allows it, then sort clusters by how
+    far they face away from the mesh centroid; clusters on the outside of
+    the mesh are drawn first and occlude the rest.
+*/
+void OptimizeOverdraw(const std::vector<Vertex> &vertices, std::vector<unsigned int> &indices, const std::vector<size_t> &clusters, float threshold) {
+    size_t triangle_count = indices.size() / 3;
+    if (triangle_count == 0 || clusters.empty())
+        return;
+
+    // soft boundaries: restart a cluster whenever its running acmr drops
+    // below threshold times the acmr of the whole hard cluster
+    std::vector<size_t> starts;
+    VertexCacheModel cache(vertices.size());
+    for (size_t c = 0; c < clusters.size(); c++) {
+        size_t begin = clusters[c];
+        size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangle_count;
+
+        cache.Flush();
+        size_t cluster_misses = 0;
+        for (size_t i = begin * 3; i < end * 3; i++)
+            cluster_misses += cache.Access(indices[i]);
+        float cluster_acmr = float(cluster_misses) / float(end - begin);
+
+        // a cluster may end up drawn after any other, so each starts cold
+        starts.push_back(begin);
+        cache.Flush();
+        cluster_misses = 0;
+        for (size_t t = begin; t < end; t++) {
+            for (int k = 0; k < 3; k++)
+                cluster_misses += cache.Access(indices[t * 3 + k]);
+            size_t triangles = t + 1 - starts.back();
+            if (t + 1 < end && triangles >= kVertexCacheSize && float(cluster_misses) / float(triangles) <= threshold * cluster_acmr) {
+                starts.push_back(t + 1);
+                cache.Flush();
+                cluster_misses = 0;
+            }
+        }
+    }
+
+    // area weighted centroid of the mesh, and centroid + normal per cluster
+    glm::vec3 mesh_centroid(0.0f);
+    float mesh_area = 0.0f;
+    std::vector<glm::vec3> centroids(starts.size(), glm::vec3(0.0f));
+    std::vector<glm::vec3> normals(starts.size(), glm::vec3(0.0f));
+    for (size_t c = 0; c < starts.size(); c++) {
+        size_t end = c + 1 < starts.size() ? starts[c + 1] : triangle_count;
+        float cluster_area = 0.0f;
+        for (size_t t = starts[c]; t < end; t++) {
+            const glm::vec3 &p0 = vertices[indices[t * 3 + 0]].Position;
+            const glm::vec3 &p1 = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3 &p2 = vertices[indices[t * 3 + 2]].Position;
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0); // length is twice the area
+            float area = glm::length(normal);
+            centroids[c] += (p0 + p1 + p2) * (area / 3.0f);
+            normals[c] += normal;
+            cluster_area += area;
+        }
+        mesh_centroid += centroids[c];
+        mesh_area += cluster_area;
+        centroids[c] = cluster_area > 0.0f ? centroids[c] / cluster_area : vertices[indices[starts[c] * 3]].Position;
+    }
+    if (mesh_area > 0.0f)
+        mesh_centroid /= mesh_area;
+
+    std::vector<float> sort_keys(starts.size());
+    std::vector<size_t> order(starts.size());
+    for (size_t c = 0; c < starts.size(); c++) {
+        float length = glm::length(normals[c]);
+        sort_keys[c] = length > 0.0f ? glm::dot(centroids[c] - mesh_centroid, normals[c] / length) : 0.0f;
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sort_keys[a] > sort_keys[b]; });
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+    for (size_t c : order) {
+        size_t end = c + 1 < starts.size() ? starts[c + 1] : triangle_count;
+        output.insert(output.end(), indices.begin() + starts[c] * 3, indices.begin() + end * 3);
+    }
+    indices.swap(output);
+}
+
+void OptimizeVertexFetch(MeshData &mesh) {
+    std::vector<uint32_t> remap(mesh.vertices.size(), kEmptySlot);
+    std::vector<Vertex> ordered;
+    ordered.reserve(mesh.vertices.size());
+    for (unsigned int &index : mesh.indices) {
+        if (remap[index] == kEmptySlot) {
+            remap[index] = static_cast<uint32_t>(ordered.size());
+            ordered.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    // vertices no triangle uses are dropped
+    mesh.vertices.swap(ordered);
+}
+
+void OptimizeMesh(MeshData &mesh) {
+    std::vector<size_t> clusters;
+    OptimizeVertexCache(mesh.indices, mesh.vertices.size(), &clusters);
+    OptimizeOverdraw(mesh.vertices, mesh.indices, clusters);
+    OptimizeVertexFetch(mesh);
+}
+
+MeshBounds ComputeMeshBounds(const std::vector<Vertex> &vertices) {
+    MeshBounds bounds = { glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), 0.0f };
+    if (vertices.empty())
+        return bounds;
+
+    bounds.min = bounds.max = vertices[0].Position;
+    for (const Vertex &vertex : vertices) {
+        bounds.min = glm::min(bounds.min, vertex.Position);
+        bounds.max = glm::max(bounds.max, vertex.Position);
+    }
+    bounds.center = (bounds.min + bounds.max) * 0.5f;
+    float radius_sq = 0.0f;
+    for (const Vertex &vertex : vertices) {
+        glm::vec3 offset = vertex.Position - bounds.center;
+        radius_sq = std::max(radius_sq, glm::dot(offset, offset));
+    }
+    bounds.radius = std::sqrt(radius_sq);
+    return bounds;
+}
@@ -0,0 +1,51 @@
+#ifndef ISLAND_UTILS_MESH_OPTIMIZER_H_
+#define ISLAND_UTILS_MESH_OPTIMIZER_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "mesh.h"
+
+/*
+    Import-time mesh processing, run on the cpu-side MeshData before it is
+    written to the mesh cache. None of it makes gl calls.
+*/
+
+// Merges vertices whose full records are bitwise identical and rewrites the
+// index buffer to match. Vertices keep their first-use order. Returns the
+// new vertex count.
+size_t WeldVertices(MeshData &mesh);
+
+// post-transform cache size the optimiser targets and the statistics model
+const size_t kVertexCacheSize = 16;
+
+// post-transform cache efficiency of an index buffer, simulated with a fifo
+// cache of kVertexCacheSize entries
+struct VertexCacheStats {
+    float acmr; // average cache miss ratio: transformed vertices per triangle (0.5 best, 3 worst)
+    float atvr; // average transformed vertex ratio: transformed vertices per vertex (1 best)
+};
+
+VertexCacheStats AnalyzeVertexCache(const std::vector<unsigned int> &indices, size_t vertex_count);
+
+// Reorders triangles for the post-transform cache (Tipsify). If clusters is
+// given it receives the first triangle of every cluster the reorder produced,
+// where a cluster is a run of triangles that restarts the cache.
+void OptimizeVertexCache(std::vector<unsigned int> &indices, size_t vertex_count, std::vector<size_t> *clusters = nullptr);
+
+// Reorders the clusters of a cache-optimised index buffer so outward facing
+// ones draw first, which lowers overdraw from most viewpoints. Clusters are
+// split further where that costs at most threshold times their acmr.
+void OptimizeOverdraw(const std::vector<Vertex> &vertices, std::vector<unsigned int> &indices, const std::vector<size_t> &clusters, float threshold = 1.05f);
+
+// Reorders vertices into the order the index buffer first uses them, so
+// vertex fetches walk memory linearly, and rewrites the indices to match.
+void OptimizeVertexFetch(MeshData &mesh);
+
+// Runs the vertex cache, overdraw and vertex fetch passes in order.
+void OptimizeMesh(MeshData &mesh);
+
+// Axis aligned box and bounding sphere (centered on the box) of the vertices.
+MeshBounds ComputeMeshBounds(const std::vector<Vertex> &vertices);
+
+#endif // ISLAND_UTILS_MESH_OPTIMIZER_H_
@@ -0,0 +1,297 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+
+namespace {
+
+// symmetric 4x4 error quadric, kept in doubles since it sums many squares
+struct Quadric {
+    double a00, a11, a22, a01, a02, a12; // A
+    double b0, b1, b2;                   // b
+    double c;
+    double weight;
+
+    // quadric of the squared distance to the plane n.p + d = 0
+    static Quadric FromPlane(const glm::vec3 &n, float d, float weight) {
+        Quadric q;
+        q.a00 = weight * n.x * n.x; q.a11 = weight * n.y * n.y; q.a22 = weight * n.z * n.z;
+        q.a01 = weight * n.x * n.y; q.a02 = weight * n.x * n.z; q.a12 = weight * n.y * n.z;
+        q.b0 = weight * n.x * d; q.b1 = weight * n.y * d; q.b2 = weight * n.z * d;
+        q.c = weight * d * d;
+        q.weight = weight;
+        return q;
+    }
+
+    Quadric &operator+=(const Quadric &other) {
+        a00 += other.a00; a11 += other.a11; a22 += other.a22;
+        a01 += other.a01; a02 += other.a02; a12 += other.a12;
+        b0 += other.b0; b1 += other.b1; b2 += other.b2;
+        c += other.c;
+        weight += other.weight;
+        return *this;
+    }
+
+    // weighted mean squared distance of p to the accumulated planes
+    double Evaluate(const glm::vec3 &p) const {
+        double x = p.x, y = p.y, z = p.z;
+        double error = a00 * x * x + a11 * y * y + a22 * z * z
+                     + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+                     + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+        return weight > 0.0 ? std::fabs(error) / weight : 0.0;
+    }
+};
+
+enum eVertexKind {
+    VERTEX_KIND_MANIFOLD, // interior, collapses anywhere
+    VERTEX_KIND_BORDER,   // on an open edge, collapses along it only
+    VERTEX_KIND_LOCKED    // shares its position with other vertices (seam), never moves
+};
+
+struct Collapse {
+    unsigned int from;
+    unsigned int to;
+    double error;
+};
+
+struct PositionHash {
+    size_t operator()(const glm::vec3 &p) const {
+        uint32_t bits[3];
+        std::memcpy(bits, &p, sizeof(bits));
+        return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+    }
+};
+
+uint64_t EdgeKey(unsigned int a, unsigned int b) {
+    return (uint64_t(a) << 32) | b;
+}
+
+/*
+    An edge is on the border if no triangle walks it the other way. Fills
+    border_edges with the vertex index pairs of those edges, both directions,
+    and marks their vertices as border ones unless they are locked.
+*/
+void FindBorderEdges(const std::vector<unsigned int> &indices, const std::vector<unsigned int> &position_id,
+                     std::unordered_set<uint64_t> &half_edges, std::unordered_set<uint64_t> &border_edges,
+                     std::vector<eVertexKind> &kind) {
+    half_edges.clear();
+    for (size_t i = 0; i < indices.size(); i += 3)
+        for (int k = 0; k < 3; k++)
+            half_edges.insert(EdgeKey(position_id[indices[i + k]], position_id[indices[i + (k + 1) % 3]]));
+
+    border_edges.clear();
+    for (eVertexKind &vertex_kind : kind)
+        vertex_kind = vertex_kind == VERTEX_KIND_LOCKED ? VERTEX_KIND_LOCKED : VERTEX_KIND_MANIFOLD;
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        for (int k = 0; k < 3; k++) {
+            unsigned int a = indices[i + k], b = indices[i + (k + 1) % 3];
+            if (half_edges.count(EdgeKey(position_id[b], position_id[a])) != 0)
+                continue;
+            border_edges.insert(EdgeKey(a, b));
+            border_edges.insert(EdgeKey(b, a));
+            kind[a] = kind[a] == VERTEX_KIND_MANIFOLD ? VERTEX_KIND_BORDER : kind[a];
+            kind[b] = kind[b] == VERTEX_KIND_MANIFOLD ? VERTEX_KIND_BORDER : kind[b];
+        }
+    }
+}
+
+// boundary edges get a plane through the edge, perpendicular to the face,
+// weighted up so borders keep their outline
+const float kBorderWeight = 10.0f;
+
+} // namespace
+
+/*
+    Every pass collects the allowed collapses of the current triangles, sorts
+    them by error and applies as many as it can without two collapses touching
+    the same neighbourhood (which keeps the flip test valid), then drops the
+    triangles that became degenerate. Borders are found again every pass, as
+    collapses along a border merge its edges into new ones.
+*/
+std::vector<unsigned int> SimplifyMesh(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices,
+                                       size_t target_index_count, float max_error, float *result_error) {
+    size_t vertex_count = vertices.size();
+    std::vector<unsigned int> result = indices;
+    double max_error_sq = double(max_error) * max_error;
+    double worst_error_sq = 0.0;
+
+    // vertices sharing a position sit on a seam and stay where they are
+    std::unordered_map<glm::vec3, unsigned int, PositionHash> position_ids;
+    std::vector<unsigned int> position_id(vertex_count);
+    std::vector<unsigned int> position_users;
+    for (size_t v = 0; v < vertex_count; v++) {
+        auto inserted = position_ids.insert({ vertices[v].Position, static_cast<unsigned int>(position_users.size()) });
+        if (inserted.second)
+            position_users.push_back(0);
+        position_id[v] = inserted.first->second;
+        position_users[position_id[v]]++;
+    }
+
+    std::vector<eVertexKind> kind(vertex_count, VERTEX_KIND_MANIFOLD);
+    for (size_t v = 0; v < vertex_count; v++) {
+        if (position_users[position_id[v]] > 1)
+            kind[v] = VERTEX_KIND_LOCKED;
+    }
+    std::unordered_set<uint64_t> half_edges;   // position id pairs
+    std::unordered_set<uint64_t> border_edges; // vertex index pairs, both directions
+    FindBorderEdges(result, position_id, half_edges, border_edges, kind);
+    std::vector<Quadric> quadrics(vertex_count, Quadric::FromPlane(glm::vec3(0.0f), 0.0f, 0.0f));
+    for (size_t i = 0; i < result.size(); i += 3) {
+        const glm::vec3 &p0 = vertices[result[i + 0]].Position;
+        const glm::vec3 &p1 = vertices[result[i + 1]].Position;
+        const glm::vec3 &p2 = vertices[result[i + 2]].Position;
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float area = glm::length(normal);
+        if (area == 0.0f)
+            continue;
+        normal /= area;
+        Quadric face = Quadric::FromPlane(normal, -glm::dot(normal, p0), area);
+        for (int k = 0; k < 3; k++) {
+            unsigned int a = result[i + k], b = result[i + (k + 1) % 3];
+            quadrics[a] += face;
+            if (border_edges.count(EdgeKey(a, b)) == 0)
+                continue;
+            glm::vec3 edge = vertices[b].Position - vertices[a].Position;
+            float length = glm::length(edge);
+            if (length == 0.0f)
+                continue;
+            glm::vec3 edge_normal = glm::normalize(glm::cross(edge, normal));
+            Quadric border = Quadric::FromPlane(edge_normal, -glm::dot(edge_normal, vertices[a].Position), length * length * kBorderWeight);
+            quadrics[a] += border;
+            quadrics[b] += border;
+        }
+    }
+
+    std::vector<unsigned int> remap(vertex_count);
+    std::vector<bool> touched(vertex_count);
+    std::vector<size_t> offsets(vertex_count + 1);
+    std::vector<unsigned int> adjacency;
+    std::vector<Collapse> collapses;
+
+    bool first_pass = true;
+    while (result.size() > target_index_count) {
+        if (!first_pass)
+            FindBorderEdges(result, position_id, half_edges, border_edges, kind);
+        first_pass = false;
+
+        // vertex -> triangle adjacency of the current triangles
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (unsigned int index : result)
+            offsets[index + 1]++;
+        for (size_t v = 0; v < vertex_count; v++)
+            offsets[v + 1] += offsets[v];
+        adjacency.resize(result.size());
+        std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < result.size(); i++)
+            adjacency[fill[result[i]]++] = static_cast<unsigned int>(i / 3);
+
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i += 3) {
+            for (int k = 0; k < 3; k++) {
+                unsigned int a = result[i + k], b = result[i + (k + 1) % 3];
+                for (int direction = 0; direction < 2; direction++) {
+                    unsigned int from = direction == 0 ? a : b, to = direction == 0 ? b : a;
+                    if (kind[from] == VERTEX_KIND_LOCKED)
+                        continue;
+                    if (kind[from] == VERTEX_KIND_BORDER && border_edges.count(EdgeKey(from, to)) == 0)
+                        continue;
+                    Quadric q = quadrics[from];
+                    q += quadrics[to];
+                    collapses.push_back(Collapse{ from, to, q.Evaluate(vertices[to].Position) });
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse &x, const Collapse &y) { return x.error < y.error; });
+
+        // each collapse removes about two triangles
+        size_t triangles_to_remove = (result.size() - target_index_count) / 3;
+        size_t triangles_removed = 0;
+        for (size_t v = 0; v < vertex_count; v++)
+            remap[v] = static_cast<unsigned int>(v);
+        std::fill(touched.begin(), touched.end(), false);
+
+        for (const Collapse &collapse : collapses) {
+            if (collapse.error > max_error_sq || triangles_removed >= triangles_to_remove)
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            // reject collapses that would flip a remaining triangle around from
+            const glm::vec3 &target = vertices[collapse.to].Position;
+            bool flips = false;
+            size_t shared = 0;
+            for (size_t a = offsets[collapse.from]; a < offsets[collapse.from + 1] && !flips; a++) {
+                const unsigned int *triangle = &result[size_t(adjacency[a]) * 3];
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+                    shared++;
+                    continue;
+                }
+                glm::vec3 p[3], q[3];
+                for (int k = 0; k < 3; k++) {
+                    p[k] = vertices[triangle[k]].Position;
+                    q[k] = triangle[k] == collapse.from ? target : p[k];
+                }
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+                flips = glm::dot(before, after) <= 0.0f;
+            }
+            if (flips)
+                continue;
+
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to] += quadrics[collapse.from];
+            for (size_t a = offsets[collapse.from]; a < offsets[collapse.from + 1]; a++) {
+                const unsigned int *triangle = &result[size_t(adjacency[a]) * 3];
+                touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+            }
+            worst_error_sq = std::max(worst_error_sq, collapse.error);
+            triangles_removed += shared;
+        }
+        if (triangles_removed == 0)
+            break; // nothing left that is cheap enough and safe
+
+        size_t write = 0;
+        for (size_t i = 0; i < result.size(); i += 3) {
+            unsigned int a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    if (result_error != nullptr)
+        *result_error = static_cast<float>(std::sqrt(worst_error_sq));
+    return result;
+}
+
+void GenerateLods(MeshData &mesh) {
+    mesh.lods.clear();
+    mesh.lods.push_back(MeshLod{ 0, static_cast<unsigned int>(mesh.indices.size()), 0.0f });
+    float radius = std::max(mesh.bounds.radius, 1e-6f);
+
+    // each level is simplified from the previous one, so errors add up
+    std::vector<unsigned int> previous = mesh.indices;
+    float lod_error = 0.0f;
+    for (size_t l = 0; l < kMaxSimplifiedLods; l++) {
+        size_t target = previous.size() / 6 * 3;
+        float error = 0.0f;
+        std::vector<unsigned int> lod = SimplifyMesh(mesh.vertices, previous, target, radius * kLodMaxError, &error);
+        // a level that drops less than a fifth of the triangles is not worth drawing
+        if (lod.empty() || lod.size() > previous.size() * 4 / 5)
+            break;
+        OptimizeVertexCache(lod, mesh.vertices.size());
+
+        lod_error += error / radius;
+        mesh.lods.push_back(MeshLod{ static_cast<unsigned int>(mesh.indices.size()), static_cast<unsigned int>(lod.size()), lod_error });
+        mesh.indices.insert(mesh.indices.end(), lod.begin(), lod.end());
+        previous.swap(lod);
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef ISLAND_UTILS_MESH_SIMPLIFIER_H_
+#define ISLAND_UTILS_MESH_SIMPLIFIER_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "mesh.h"
+
+// levels generated below the full detail one, each with about half the
+// triangles of the previous
+const size_t kMaxSimplifiedLods = 3;
+
+// largest error a lod may have, relative to the mesh's bounding radius
+const float kLodMaxError = 0.1f;
+
+// Simplifies a triangle list by collapsing edges onto existing vertices in
+// order of quadric error (Garland & Heckbert), so the result indexes the same
+// vertex buffer. Stops at target_index_count indices or once the next collapse
+// would move the surface further than max_error. Vertices on uv/normal seams
+// are kept, open borders only collapse along themselves. If result_error is
+// given it receives the largest error introduced, in model units.
+std::vector<unsigned int> SimplifyMesh(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices,
+                                       size_t target_index_count, float max_error, float *result_error = nullptr);
+
+// Appends up to kMaxSimplifiedLods simplified, cache optimised index buffers
+// to mesh.indices and describes every level (the original one first) in
+// mesh.lods. Needs mesh.bounds. Stops early once a level no longer pays off.
+void GenerateLods(MeshData &mesh);
+
+#endif // ISLAND_UTILS_MESH_SIMPLIFIER_H_
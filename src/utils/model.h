@@ -10,14 +10,19 @@
 #include <assimp/postprocess.h>
 
 #include "shader.h"
-#include "stb_image.h"
 #include "mesh.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "core.h"
+#include "texture.h"
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <vector>
 using namespace std;
 
@@ -25,32 +30,118 @@ using namespace std;
     A model loading class powered by ASIMP courtesy of LearnOpenGL.com 
 */
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+// largest simplification error a lod may show on screen, as a fraction of the screen height (about a pixel at 1080p)
+const float kLodScreenError = 1.0f / 1080.0f;
+
+// post-processing applied to every imported model. part of the mesh cache key.
+const unsigned int kModelImportFlags = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
+// cpu-side result of importing a model. produced without any gl calls (so on any thread), uploaded by the Model constructor.
+struct ModelData
+{
+    string path;
+    string directory;
+    vector<MeshData> meshes;        // meshes imported with ASSIMP, or
+    shared_ptr<MeshCache> cache;    // meshes mapped from the mesh cache
+};
 
 class Model 
 {
 public:
     // model data 
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
     glm::mat4 model_matrix;
     float specular_intensity;
+    MeshBounds bounds; // local space, around every mesh
 
-    // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    // constructor, expects a filepath to a 3D model. vertexAttributes is the mask of attributes the model's 
+    // shaders read (Shader::getVertexAttributes()); meshes are packed into the smallest layout that holds them.
+    Model(string const &path, unsigned int vertexAttributes = VERTEX_ATTRIBUTES_ALL, bool gamma = false) 
+        : Model(Import(path), vertexAttributes, gamma)
     {
-        loadModel(path);
     }
 
-    // draws the model, and thus all its meshes
-    void Draw(Shader &shader) const
+    // constructor, uploads previously imported model data. must run on the gl thread.
+    Model(const ModelData &data, unsigned int vertexAttributes = VERTEX_ATTRIBUTES_ALL, bool gamma = false) : gammaCorrection(gamma)
+    {
+        uploadModel(data, ChooseVertexLayout(vertexAttributes));
+    }
+
+    // imports a model file into cpu-side data: from its mesh cache if there is an up-to-date one, otherwise with 
+    // ASSIMP (writing the cache for next time). makes no gl calls, so it is safe to call from worker threads.
+    static ModelData Import(string const &path)
+    {
+        ModelData data;
+        data.path = path;
+        // retrieve the directory path of the filepath
+        data.directory = path.substr(0, path.find_last_of('/'));
+
+        // warm start: keep the cache mapped, the upload reads straight from it
+        shared_ptr<MeshCache> cache = make_shared<MeshCache>();
+        if(cache->Open(path, kModelImportFlags))
+        {
+            data.cache = cache;
+            return data;
+        }
+
+        // read file via ASSIMP
+        Assimp::Importer importer;
+        const aiScene* scene = importer.ReadFile(path, kModelImportFlags);
+        // check for errors
+        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+        {
+            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+            return data;
+        }
+
+        // process ASSIMP's root node recursively
+        processNode(scene->mRootNode, scene, data.meshes);
+
+        for(unsigned int i = 0; i < data.meshes.size(); i++)
+        {
+            MeshData &mesh = data.meshes[i];
+            // ASSIMP emits one vertex per face corner, merge the identical ones back together
+            size_t numVertices = mesh.vertices.size();
+            WeldVertices(mesh);
+            cout << "MODEL::WELD:: " << path << " mesh " << i << ": " << numVertices << " -> " 
+                 << mesh.vertices.size() << " vertices" << endl;
+
+            // then reorder for the post-transform cache, overdraw and vertex fetch
+            VertexCacheStats before = AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+            OptimizeMesh(mesh);
+            VertexCacheStats after = AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+            cout << "MODEL::OPTIMIZE:: " << path << " mesh " << i << ": ACMR " << before.acmr << " -> " << after.acmr
+                 << ", ATVR " << before.atvr << " -> " << after.atvr << endl;
+
+            // and build the lod chain over the same vertices
+            mesh.bounds = ComputeMeshBounds(mesh.vertices);
+            GenerateLods(mesh);
+            cout << "MODEL::LOD:: " << path << " mesh " << i << ":";
+            for(const MeshLod &lod : mesh.lods)
+                cout << " " << lod.indexCount / 3;
+            cout << " triangles" << endl;
+        }
+
+        MeshCache::Write(path, kModelImportFlags, data.meshes);
+        return data;
+    }
+
+    // draws the model, and thus all its meshes, at full detail
+    void Draw(const Shader &shader) const
     {
         for(unsigned int i = 0; i < meshes.size(); i++)
             meshes[i].Draw(shader);
     }
 
+    // draws every mesh at the level of detail its projected size calls for
+    void Draw(const Shader &shader, const glm::mat4 &view, const glm::mat4 &projection) const
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].Draw(shader, selectLod(meshes[i], view, projection));
+    }
+
     // sets the model matrix (local -> world) associated with this model
     void SetModelMatrix(glm::mat4 model_matrix) {
         this->model_matrix = model_matrix;
@@ -59,29 +150,68 @@ public:
     void SetSpecularIntensity(float specular_intensity) {
         this->specular_intensity = specular_intensity;
     }
+
+    // picks the coarsest lod whose simplification error, projected to the screen, stays below kLodScreenError
+    // (scaled by 2^g_lod_bias)
+    size_t selectLod(const Mesh &mesh, const glm::mat4 &view, const glm::mat4 &projection) const
+    {
+        // bounding sphere in view space; the largest axis scale bounds the radius
+        glm::vec3 center = glm::vec3(view * model_matrix * glm::vec4(mesh.bounds.center, 1.0f));
+        float scale = glm::max(glm::length(glm::vec3(model_matrix[0])), glm::max(glm::length(glm::vec3(model_matrix[1])), glm::length(glm::vec3(model_matrix[2]))));
+        return selectLod(mesh, -center.z, mesh.bounds.radius * scale, projection);
+    }
+
+    // same, for the mesh's bounding sphere scaled to radius at view depth distance
+    static size_t selectLod(const Mesh &mesh, float distance, float radius, const glm::mat4 &projection)
+    {
+        if(distance <= radius)
+            return 0; // camera inside or right at the mesh
+
+        // projected radius as a fraction of the screen height
+        float screen_size = radius * projection[1][1] * 0.5f / distance;
+        float max_error = kLodScreenError * std::exp2(g_lod_bias);
+        size_t lod = 0;
+        while(lod + 1 < mesh.lods.size() && mesh.lods[lod + 1].error * screen_size <= max_error)
+            lod++;
+        return lod;
+    }
     
 private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+    // uploads imported meshes, packed into the given vertex layout, and their textures to the gpu
+    void uploadModel(const ModelData &data, eVertexLayout layout)
     {
-        // read file via ASSIMP
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-        // check for errors
-        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+        directory = data.directory;
+        if(data.cache)
         {
-            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            for(const CachedMesh &mesh : data.cache->GetMeshes())
+                meshes.push_back(Mesh(mesh.vertices, mesh.num_vertices, mesh.indices, mesh.num_indices, mesh.lods, mesh.bounds, 
+                                      loadTextures(mesh.textures), layout));
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
+        for(const MeshData &mesh : data.meshes)
+            meshes.push_back(Mesh(mesh, loadTextures(mesh.textures), layout));
+        computeBounds();
+    }
 
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+    // merges the mesh bounds: the union of their boxes, and a sphere around their spheres
+    void computeBounds()
+    {
+        bounds = { glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), 0.0f };
+        if(meshes.empty())
+            return;
+        bounds.min = meshes[0].bounds.min;
+        bounds.max = meshes[0].bounds.max;
+        for(const Mesh &mesh : meshes)
+        {
+            bounds.min = glm::min(bounds.min, mesh.bounds.min);
+            bounds.max = glm::max(bounds.max, mesh.bounds.max);
+        }
+        bounds.center = (bounds.min + bounds.max) * 0.5f;
+        for(const Mesh &mesh : meshes)
+            bounds.radius = glm::max(bounds.radius, glm::length(mesh.bounds.center - bounds.center) + mesh.bounds.radius);
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    static void processNode(aiNode *node, const aiScene *scene, vector<MeshData> &meshData)
     {
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
@@ -89,27 +219,28 @@ private:
             // the node object only contains indices to index the actual objects in the scene. 
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            meshData.push_back(processMesh(mesh, scene));
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, meshData);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    static MeshData processMesh(aiMesh *mesh, const aiScene *scene)
     {
         // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        MeshData data;
+        vector<Vertex> &vertices = data.vertices;
+        vector<unsigned int> &indices = data.indices;
+        vector<TextureRef> &textures = data.textures;
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
-            Vertex vertex;
+            Vertex vertex = {}; // zeroed so unused attributes (and the cache file) are deterministic
             glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
             // positions
             vector.x = mesh->mVertices[i].x;
@@ -167,96 +298,44 @@ private:
         // normal: texture_normalN
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        collectMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", textures);
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        collectMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", textures);
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+        collectMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", textures);
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+        collectMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", textures);
         
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // return the extracted mesh data
+        return data;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // appends references to all material textures of a given type
+    static void collectMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName, vector<TextureRef> &textures)
     {
-        vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
-            }
+            textures.push_back(TextureRef{typeName, str.C_Str()});
         }
-        return textures;
     }
-};
-
-
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
-{
-    string filename = string(path);
-    filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-        else
-            format = GL_NONE;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
+    // resolves texture references through the global texture registry, so a file is only loaded once no matter 
+    // how many meshes or models reference it. the required info is returned as a Texture struct.
+    vector<Texture> loadTextures(const vector<TextureRef> &refs)
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        vector<Texture> textures;
+        for(const TextureRef &ref : refs)
+        {
+            Texture texture;
+            texture.handle = g_texture_registry.Acquire(ref.path.c_str(), this->directory);
+            texture.id = texture.handle.GetId();
+            texture.type = ref.type;
+            texture.path = ref.path;
+            textures.push_back(texture);
+        }
+        return textures;
     }
-
-    return textureID;
-}
+};
 #endif
\ No newline at end of file
@@ -0,0 +1,25 @@
+#include <glad/glad.h>
+
+#include "model_loader.h"
+#include "parallel.h"
+
+std::vector<ModelData> ImportModels(const std::vector<std::string> &paths) {
+    std::vector<ModelData> models(paths.size());
+    ParallelFor(paths.size(), [&](size_t i) {
+        models[i] = Model::Import(paths[i]);
+    });
+    return models;
+}
+
+std::vector<Model> LoadModels(const std::vector<ModelSource> &sources) {
+    std::vector<std::string> paths;
+    for (const ModelSource &source : sources)
+        paths.push_back(source.path);
+    std::vector<ModelData> data = ImportModels(paths);
+
+    std::vector<Model> models;
+    models.reserve(data.size());
+    for (size_t i = 0; i < data.size(); i++)
+        models.push_back(Model(data[i], sources[i].vertex_attributes));
+    return models;
+}
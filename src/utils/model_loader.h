@@ -0,0 +1,25 @@
+#ifndef ISLAND_UTILS_MODEL_LOADER_H_
+#define ISLAND_UTILS_MODEL_LOADER_H_
+
+#include <string>
+#include <vector>
+
+#include "model.h"
+
+// a model file and the vertex attributes its shaders read (see Model)
+struct ModelSource {
+    std::string path;
+    unsigned int vertex_attributes;
+};
+
+// Imports every model on the worker pool. Makes no gl calls. Results are in
+// the same order as paths.
+std::vector<ModelData> ImportModels(const std::vector<std::string> &paths);
+
+// Imports models in parallel, then uploads all of them in one batch on the
+// calling (gl) thread, each packed for the attributes its source lists.
+// Material textures are handed to g_texture_streamer and decode in the 
+// background.
+std::vector<Model> LoadModels(const std::vector<ModelSource> &sources);
+
+#endif // ISLAND_UTILS_MODEL_LOADER_H_
@@ -0,0 +1,168 @@
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <iostream>
+
+#include "gl_state.h"
+#include "occlusion_culler.h"
+#include "uniforms.h"
+
+// ----------- PUBLIC ----------- //
+/*
+    Create the unit cube every box is drawn from.
+*/
+OcclusionCuller::OcclusionCuller(const Shader &box_shader)
+    : box_shader(box_shader), frame(1), conditional(false), frame_stats(), last_stats(), total_stats() {
+    std::fill(pass_frames, pass_frames + NUM_RENDER_PASSES, 0);
+    const float corners[] = {
+        -1.0f, -1.0f, -1.0f,   1.0f, -1.0f, -1.0f,   1.0f,  1.0f, -1.0f,  -1.0f,  1.0f, -1.0f,
+        -1.0f, -1.0f,  1.0f,   1.0f, -1.0f,  1.0f,   1.0f,  1.0f,  1.0f,  -1.0f,  1.0f,  1.0f
+    };
+    const unsigned char indices[] = {
+        0, 2, 1,  0, 3, 2,   // -z
+        4, 5, 6,  4, 6, 7,   // +z
+        0, 1, 5,  0, 5, 4,   // -y
+        3, 6, 2,  3, 7, 6,   // +y
+        0, 4, 7,  0, 7, 3,   // -x
+        1, 2, 6,  1, 6, 5    // +x
+    };
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vertex_buffer);
+    glGenBuffers(1, &index_buffer);
+
+    g_gl_state.BindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    g_gl_state.BindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/*
+    Free the cube and every query.
+*/
+void OcclusionCuller::CleanUp() {
+    g_gl_state.DeleteVertexArray(vao);
+    glDeleteBuffers(1, &vertex_buffer);
+    glDeleteBuffers(1, &index_buffer);
+    for (auto &entry : entries)
+        glDeleteQueries(1, &entry.second.query);
+    entries.clear();
+}
+
+/*
+    Make the draw conditional on the object's query from the pass's last
+    draw, if it had one then and that draw is recent enough, and queue this
+    frame's test of its box.
+*/
+void OcclusionCuller::BeginDraw(eRenderPass pass, uint64_t object, const BoundingBox &box) {
+    auto found = entries.find(object);
+    if (found == entries.end()) {
+        Entry entry = { 0, 0, 0 };
+        glGenQueries(1, &entry.query);
+        found = entries.emplace(object, entry).first;
+    }
+    Entry &entry = found->second;
+    entry.drawn_frame = frame;
+
+    uint64_t pass_frame = pass_frames[pass];
+    conditional = pass_frame != 0 && entry.queried_frame == pass_frame && pass_frame + kOcclusionMaxQueryAge >= frame;
+    if (conditional) {
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(entry.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint passed = GL_FALSE;
+            glGetQueryObjectuiv(entry.query, GL_QUERY_RESULT, &passed);
+            (passed ? frame_stats.visible : frame_stats.occluded)[pass]++;
+        } else
+            frame_stats.pending[pass]++;
+        glBeginConditionalRender(entry.query, GL_QUERY_NO_WAIT);
+    } else
+        frame_stats.untested[pass]++;
+
+    pending.push_back(PendingQuery{ &entry, box });
+}
+
+void OcclusionCuller::EndDraw() {
+    if (conditional)
+        glEndConditionalRender();
+    conditional = false;
+}
+
+/*
+    Draw each queued box into its object's query with color and depth
+    writes off. Boxes the camera is (nearly) inside are left untested, so
+    their objects are drawn unconditionally next frame.
+*/
+void OcclusionCuller::IssueQueries(eRenderPass pass, const glm::vec3 &camera_position) {
+    pass_frames[pass] = frame;
+    if (pending.empty())
+        return;
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    box_shader.use();
+    g_gl_state.BindVertexArray(vao);
+
+    for (const PendingQuery &query : pending) {
+        glm::vec3 offset = glm::abs(camera_position - query.box.center);
+        if (glm::all(glm::lessThanEqual(offset, query.box.extent + kOcclusionNearMargin))) {
+            query.entry->queried_frame = 0;
+            continue;
+        }
+        box_shader.setVec3(kUniformBoxCenter, query.box.center.x, query.box.center.y, query.box.center.z);
+        box_shader.setVec3(kUniformBoxExtent, query.box.extent.x, query.box.extent.y, query.box.extent.z);
+        glBeginQuery(GL_ANY_SAMPLES_PASSED, query.entry->query);
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, (void*)0);
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+        query.entry->queried_frame = frame;
+        frame_stats.queries[pass]++;
+    }
+    pending.clear();
+
+    glDepthMask(GL_TRUE);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+void OcclusionCuller::EndFrame() {
+    for (auto entry = entries.begin(); entry != entries.end();) {
+        if (entry->second.drawn_frame + kOcclusionQueryLifetime < frame) {
+            glDeleteQueries(1, &entry->second.query);
+            entry = entries.erase(entry);
+        } else
+            ++entry;
+    }
+    pending.clear();
+    frame++;
+
+    frame_stats.frames = 1;
+    last_stats = frame_stats;
+    total_stats.frames += frame_stats.frames;
+    for (size_t pass = 0; pass < NUM_RENDER_PASSES; pass++) {
+        total_stats.queries[pass] += frame_stats.queries[pass];
+        total_stats.occluded[pass] += frame_stats.occluded[pass];
+        total_stats.visible[pass] += frame_stats.visible[pass];
+        total_stats.pending[pass] += frame_stats.pending[pass];
+        total_stats.untested[pass] += frame_stats.untested[pass];
+    }
+    frame_stats = OcclusionStats();
+}
+
+const OcclusionStats &OcclusionCuller::GetStats() const {
+    return last_stats;
+}
+
+void OcclusionCuller::PrintStats() const {
+    double frames = std::max(static_cast<double>(total_stats.frames), 1.0);
+    std::cout << "OCCLUSION:: occluded/visible/pending/untested draws, last frame (per frame over " << total_stats.frames << " frames):" << std::endl;
+    for (size_t pass = 0; pass < NUM_RENDER_PASSES; pass++) {
+        const OcclusionStats &s = last_stats;
+        std::cout << "OCCLUSION::   " << kRenderPassNames[pass] << ": " << s.occluded[pass] << "/" << s.visible[pass] << "/"
+                  << s.pending[pass] << "/" << s.untested[pass] << " (" << total_stats.occluded[pass] / frames << "/"
+                  << total_stats.visible[pass] / frames << "/" << total_stats.pending[pass] / frames << "/"
+                  << total_stats.untested[pass] / frames << "), " << s.queries[pass] << " queries" << std::endl;
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef ISLAND_UTILS_OCCLUSION_CULLER_H_
+#define ISLAND_UTILS_OCCLUSION_CULLER_H_
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "frustum.h"
+#include "render_queue.h"
+#include "shader.h"
+
+// frames an object's query is kept after its last draw
+const uint64_t kOcclusionQueryLifetime = 120;
+// most frames back a pass's last draw may be for its queries to still be used; passes drawn in turns (see
+// WaterViewCache) skip frames
+const uint64_t kOcclusionMaxQueryAge = 4;
+// boxes closer than this to the camera are not tested: their faces may be cut by the near plane
+const float kOcclusionNearMargin = 0.5f;
+
+struct OcclusionStats {
+    uint64_t frames;
+    uint64_t queries[NUM_RENDER_PASSES];   // boxes tested
+    // draws made conditional on the query of the pass's last draw, by the result found once it was available
+    uint64_t occluded[NUM_RENDER_PASSES];
+    uint64_t visible[NUM_RENDER_PASSES];
+    uint64_t pending[NUM_RENDER_PASSES];   // result not available yet, the gpu draws them
+    uint64_t untested[NUM_RENDER_PASSES];  // no query from the pass's last draw, drawn unconditionally
+};
+
+/*
+    Frame coherent hardware occlusion culling. After a pass has drawn, the
+    world box of each of its draws is rasterised against the pass's depth
+    buffer (without writing color or depth) inside a GL_ANY_SAMPLES_PASSED
+    query. The next time the pass is drawn, usually the next frame, the same
+    draw is wrapped in a conditional render on that query, so the gpu skips
+    it if no sample of its box passed; the cpu never waits for a result. A
+    draw that comes into view is therefore drawn one pass late. Passes that
+    skip frames use their last draw's queries as long as it is at most
+    kOcclusionMaxQueryAge frames old.
+
+    Draws are identified across frames by a key (see RenderQueue::Submit),
+    each with its own query object, reused every frame and freed once the
+    draw has not been seen for kOcclusionQueryLifetime frames. The stats
+    peek at results that are already available, without stalling.
+*/
+class OcclusionCuller {
+public:
+    // box_shader (occlusion_box.vert/.frag) must outlive the culler
+    OcclusionCuller(const Shader &box_shader);
+
+    void CleanUp();
+
+    // wrap a draw of object in pass, conditional on its query from the pass's last draw; box bounds what it draws
+    void BeginDraw(eRenderPass pass, uint64_t object, const BoundingBox &box);
+    void EndDraw();
+
+    // tests the boxes of the draws of pass against its depth buffer, with the pass's framebuffer and
+    // Camera block still bound. camera_position is the pass's eye.
+    void IssueQueries(eRenderPass pass, const glm::vec3 &camera_position);
+
+    // rolls the counters over and frees stale queries
+    void EndFrame();
+
+    // counts of the last finished frame
+    const OcclusionStats &GetStats() const;
+    void PrintStats() const;
+
+private:
+    struct Entry {
+        GLuint query;
+        uint64_t queried_frame; // frame the query was last issued in, 0 if never
+        uint64_t drawn_frame;
+    };
+
+    struct PendingQuery {
+        Entry *entry;
+        BoundingBox box;
+    };
+
+    const Shader &box_shader;
+    unsigned int vao;
+    unsigned int vertex_buffer;
+    unsigned int index_buffer;
+
+    uint64_t frame;
+    uint64_t pass_frames[NUM_RENDER_PASSES]; // frame each pass last issued its queries in, 0 if never
+    std::unordered_map<uint64_t, Entry> entries; // node based, so pending entry pointers stay valid
+    std::vector<PendingQuery> pending;
+    bool conditional; // the current draw is inside a conditional render
+
+    OcclusionStats frame_stats;
+    OcclusionStats last_stats;
+    OcclusionStats total_stats;
+};
+
+#endif // ISLAND_UTILS_OCCLUSION_CULLER_H_
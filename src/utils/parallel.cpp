@@ -0,0 +1,30 @@
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "parallel.h"
+
+/*
+    Hand out indices from a shared counter so fast workers pick up the slack of 
+    slow ones (e.g. the 20k face light orb next to a 4 vertex water plane).
+*/
+void ParallelFor(size_t count, const std::function<void(size_t)> &fn) {
+    if (count == 0)
+        return;
+    size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+    num_threads = std::min(num_threads, count);
+
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++)
+            fn(i);
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < num_threads; t++)
+        threads.emplace_back(worker);
+    worker(); // the calling thread works too
+    for (std::thread &thread : threads)
+        thread.join();
+}
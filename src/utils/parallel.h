@@ -0,0 +1,11 @@
+#ifndef ISLAND_UTILS_PARALLEL_H_
+#define ISLAND_UTILS_PARALLEL_H_
+
+#include <cstddef>
+#include <functional>
+
+// Runs fn(0) .. fn(count - 1) on a pool of worker threads (one per core, at
+// most count) and blocks until all calls have returned.
+void ParallelFor(size_t count, const std::function<void(size_t)> &fn);
+
+#endif // ISLAND_UTILS_PARALLEL_H_
@@ -0,0 +1,469 @@
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "gl_state.h"
+#include "hash.h"
+#include "occlusion_culler.h"
+#include "render_queue.h"
+#include "software_occlusion.h"
+#include "uniforms.h"
+
+namespace {
+
+const int kPassShift = 61;
+const int kProgramShift = 51;
+const int kMaterialShift = 35;
+const int kVaoShift = 24;
+
+const uint64_t kProgramMask = (1ull << 10) - 1;
+const uint64_t kMaterialMask = (1ull << 16) - 1;
+const uint64_t kVaoMask = (1ull << 11) - 1;
+
+// nothing is known to be bound
+const unsigned int kUnknownBinding = 0xFFFFFFFFu;
+
+uint64_t MaterialKey(const Mesh &mesh) {
+    uint64_t hash = kFnvOffsetBasis64;
+    for (const Texture &texture : mesh.textures)
+        hash = Fnv1a64(hash, &texture.id, sizeof(texture.id));
+    return (hash ^ (hash >> 16) ^ (hash >> 32) ^ (hash >> 48)) & kMaterialMask;
+}
+
+// top 24 bits of the distance's float bits; non-negative floats order like their bit patterns
+uint64_t DepthKey(float distance) {
+    distance = std::max(distance, 0.0f);
+    uint32_t bits;
+    std::memcpy(&bits, &distance, sizeof(bits));
+    return bits >> 8;
+}
+
+} // namespace
+
+// ----------- PUBLIC ----------- //
+RenderQueue::RenderQueue() : cluster_culling(true), frame_stats(), last_stats(), total_stats() {
+    std::fill(pass_begin, pass_begin + NUM_RENDER_PASSES + 1, 0);
+    std::fill(software_occlusion, software_occlusion + NUM_RENDER_PASSES, nullptr);
+}
+
+void RenderQueue::Add(eRenderPass pass, const Shader &shader, const std::vector<Model> &models, const glm::mat4 &view, const glm::mat4 &projection,
+                      const glm::vec4 &clip_plane) {
+    AddCulled(pass, shader, models.data(), models.size(), view, projection, clip_plane);
+}
+
+void RenderQueue::Add(eRenderPass pass, const Shader &shader, const Model &model, const glm::mat4 &view, const glm::mat4 &projection,
+                      const glm::vec4 &clip_plane) {
+    AddCulled(pass, shader, &model, 1, view, projection, clip_plane);
+}
+
+void RenderQueue::Add(eRenderPass pass, const Shader &shader, const std::vector<Model> &models, const Bvh &bvh, uint32_t first_object,
+                      const glm::mat4 &view, const glm::mat4 &projection, const glm::vec4 &clip_plane) {
+    Frustum frustum = ExtractFrustum(projection * view);
+    AddClipPlane(frustum, clip_plane);
+    AddFound(pass, shader, models, bvh, first_object, &frustum, 1, view, projection);
+}
+
+void RenderQueue::AddInstanced(eRenderPass pass, const Shader &shader, const Model &model, const InstanceBuffer &instances, const Bvh &bvh,
+                               uint32_t first_object, const glm::mat4 &view, const glm::mat4 &projection, const glm::vec4 &clip_plane) {
+    Frustum frustum = ExtractFrustum(projection * view);
+    AddClipPlane(frustum, clip_plane);
+    AddInstancedCulled(pass, shader, model, instances, bvh, first_object, &frustum, 1, view, projection);
+}
+
+void RenderQueue::Add(eRenderPass pass, const Shader &shader, const std::vector<Model> &models, const Bvh &bvh, uint32_t first_object,
+                      const RenderLayers &layers, const glm::mat4 &projection) {
+    Frustum frustums[kMaxRenderLayers];
+    for (size_t layer = 0; layer < layers.count; layer++) {
+        frustums[layer] = ExtractFrustum(projection * layers.views[layer]);
+        AddClipPlane(frustums[layer], layers.clip_planes[layer]);
+    }
+    AddFound(pass, shader, models, bvh, first_object, frustums, layers.count, layers.views[0], projection);
+}
+
+void RenderQueue::AddInstanced(eRenderPass pass, const Shader &shader, const Model &model, const InstanceBuffer &instances, const Bvh &bvh,
+                               uint32_t first_object, const RenderLayers &layers, const glm::mat4 &projection) {
+    Frustum frustums[kMaxRenderLayers];
+    for (size_t layer = 0; layer < layers.count; layer++) {
+        frustums[layer] = ExtractFrustum(projection * layers.views[layer]);
+        AddClipPlane(frustums[layer], layers.clip_planes[layer]);
+    }
+    AddInstancedCulled(pass, shader, model, instances, bvh, first_object, frustums, layers.count, layers.views[0], projection);
+}
+
+void RenderQueue::SetClusterCulling(bool enabled) {
+    cluster_culling = enabled;
+}
+
+void RenderQueue::SetSoftwareOcclusion(eRenderPass pass, SoftwareOcclusion *occlusion) {
+    software_occlusion[pass] = occlusion;
+}
+
+/*
+    Order the frame's items by key and find where each pass starts.
+*/
+void RenderQueue::Sort() {
+    RadixSort(entries, scratch);
+    size_t entry = 0;
+    for (size_t pass = 0; pass <= NUM_RENDER_PASSES; pass++) {
+        while (entry < entries.size() && (entries[entry].key >> kPassShift) < pass)
+            entry++;
+        pass_begin[pass] = entry;
+    }
+    pass_begin[NUM_RENDER_PASSES] = entries.size();
+}
+
+/*
+    Draw the pass's items in key order. The switch counters are tracked from
+    scratch per pass, since anything drawn between passes may have changed
+    the bindings; g_gl_state drops the binds that turn out to be no-ops.
+    With an occlusion culler, each draw is keyed by its pass, program, model
+    and mesh, which stay the same from frame to frame.
+*/
+void RenderQueue::Submit(eRenderPass pass, OcclusionCuller *occlusion) {
+    unsigned int program = kUnknownBinding;
+    unsigned int vao = kUnknownBinding;
+    const Model *model = nullptr;
+    unsigned int textures[kMaxQueueTextureUnits];
+    uint32_t samplers[kMaxQueueTextureUnits];
+    std::fill(textures, textures + kMaxQueueTextureUnits, kUnknownBinding);
+    std::fill(samplers, samplers + kMaxQueueTextureUnits, 0);
+
+    for (size_t e = pass_begin[pass]; e < pass_begin[pass + 1]; e++) {
+        const DrawItem &item = items[entries[e].item];
+        const Shader &shader = *item.shader;
+        const Mesh &mesh = *item.mesh;
+
+        if (shader.ID != program) {
+            shader.use();
+            program = shader.ID;
+            model = nullptr; // uniforms below belong to the program
+            std::fill(samplers, samplers + kMaxQueueTextureUnits, 0);
+            frame_stats.program_switches++;
+        }
+        if (item.model != model) {
+            model = item.model;
+            // instanced variants read their matrices from the instance buffer
+            if (item.instance_count == 0) {
+                shader.setMat4(kUniformModel, model->model_matrix);
+                glm::mat3 normal = glm::mat3(glm::transpose(glm::inverse(model->model_matrix)));
+                shader.setMat3(kUniformNormal, normal);
+            }
+            shader.setFloat(kUniformSpecularIntensity, model->specular_intensity);
+        }
+
+        size_t num_textures = std::min(mesh.textures.size(), kMaxQueueTextureUnits);
+        for (size_t i = 0; i < num_textures; i++) {
+            const Texture &texture = mesh.textures[i];
+            if (samplers[i] != texture.samplerHash) {
+                shader.setInt(UniformId(texture.samplerHash, texture.sampler.c_str()), static_cast<int>(i));
+                samplers[i] = texture.samplerHash;
+            }
+            if (textures[i] != texture.id) {
+                g_gl_state.BindTextureUnit(static_cast<GLuint>(i), GL_TEXTURE_2D, texture.id);
+                textures[i] = texture.id;
+                frame_stats.texture_binds++;
+            }
+        }
+        frame_stats.texture_references += num_textures;
+
+        if (mesh.VAO != vao) {
+            g_gl_state.BindVertexArray(mesh.VAO);
+            vao = mesh.VAO;
+            frame_stats.vao_switches++;
+        }
+
+        const MeshLod &level = mesh.lods[std::min(item.lod, mesh.lods.size() - 1)];
+        void *indices = (void*)(level.indexOffset * sizeof(unsigned int));
+        if (occlusion != nullptr) {
+            uint64_t object = Fnv1a64(kFnvOffsetBasis64, &pass, sizeof(pass));
+            object = Fnv1a64(object, &shader.ID, sizeof(shader.ID));
+            object = Fnv1a64(object, &item.model, sizeof(item.model));
+            object = Fnv1a64(object, &item.mesh, sizeof(item.mesh));
+            occlusion->BeginDraw(pass, object, item.box);
+        }
+        if (item.range_count > 0)
+            glMultiDrawElements(GL_TRIANGLES, &range_counts[item.range_begin], GL_UNSIGNED_INT, &range_offsets[item.range_begin], item.range_count);
+        else if (item.instance_count > 0) {
+            glDrawElementsInstanced(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT, indices, item.instance_count);
+            frame_stats.instances += item.instance_count;
+        } else
+            glDrawElements(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT, indices);
+        if (occlusion != nullptr)
+            occlusion->EndDraw();
+        frame_stats.draws++;
+    }
+}
+
+/*
+    Drop the frame's items (keeping their storage) and roll the counters over.
+*/
+void RenderQueue::EndFrame() {
+    items.clear();
+    entries.clear();
+    range_counts.clear();
+    range_offsets.clear();
+    std::fill(pass_begin, pass_begin + NUM_RENDER_PASSES + 1, 0);
+
+    frame_stats.frames = 1;
+    last_stats = frame_stats;
+    total_stats.frames += frame_stats.frames;
+    total_stats.draws += frame_stats.draws;
+    total_stats.program_switches += frame_stats.program_switches;
+    total_stats.texture_binds += frame_stats.texture_binds;
+    total_stats.vao_switches += frame_stats.vao_switches;
+    total_stats.instances += frame_stats.instances;
+    total_stats.clusters_culled += frame_stats.clusters_culled;
+    for (size_t pass = 0; pass < NUM_RENDER_PASSES; pass++) {
+        total_stats.visible[pass] += frame_stats.visible[pass];
+        total_stats.culled[pass] += frame_stats.culled[pass];
+        total_stats.objects_culled[pass] += frame_stats.objects_culled[pass];
+    }
+    total_stats.texture_references += frame_stats.texture_references;
+    frame_stats = RenderQueueStats();
+}
+
+const RenderQueueStats &RenderQueue::GetStats() const {
+    return last_stats;
+}
+
+void RenderQueue::PrintStats() const {
+    const RenderQueueStats &s = last_stats;
+    std::cout << "RENDER_QUEUE:: last frame: " << s.draws << " draws, " << s.program_switches << " program switches, "
+              << s.texture_binds << "/" << s.texture_references << " texture binds, " << s.vao_switches << " vao switches, "
+              << s.instances << " instances, " << s.clusters_culled << " clusters culled" << std::endl;
+    if (total_stats.frames == 0)
+        return;
+    double frames = static_cast<double>(total_stats.frames);
+    std::cout << "RENDER_QUEUE:: per frame over " << total_stats.frames << " frames: " << total_stats.draws / frames << " draws, "
+              << total_stats.program_switches / frames << " program switches, " << total_stats.texture_binds / frames << "/"
+              << total_stats.texture_references / frames << " texture binds, " << total_stats.vao_switches / frames << " vao switches, "
+              << total_stats.instances / frames << " instances, " << total_stats.clusters_culled / frames << " clusters culled" << std::endl;
+    for (size_t pass = 0; pass < NUM_RENDER_PASSES; pass++) {
+        std::cout << "RENDER_QUEUE::   " << kRenderPassNames[pass] << " visible/culled: " << s.visible[pass] << "/" << s.culled[pass]
+                  << " (" << total_stats.visible[pass] / frames << "/" << total_stats.culled[pass] / frames << "), objects culled: "
+                  << s.objects_culled[pass] << " (" << total_stats.objects_culled[pass] / frames << ")" << std::endl;
+    }
+}
+
+// ----------- PRIVATE ----------- //
+/*
+    Frustum cull the models by their bounds, then the meshes of the models
+    that survive, and queue what is left. The clip plane joins the frustum planes, so
+    both levels reject whatever gl_ClipDistance would discard anyway.
+*/
+void RenderQueue::AddCulled(eRenderPass pass, const Shader &shader, const Model *models, size_t count, const glm::mat4 &view, const glm::mat4 &projection,
+                            const glm::vec4 &clip_plane) {
+    Frustum frustum = ExtractFrustum(projection * view);
+    AddClipPlane(frustum, clip_plane);
+
+    cull_boxes.Clear();
+    for (size_t i = 0; i < count; i++)
+        cull_boxes.Add(TransformBounds(models[i].bounds, models[i].model_matrix));
+    cull_visible.resize(count);
+    CullBoxes(frustum, cull_boxes, cull_visible.data());
+
+    cull_models.clear();
+    for (size_t i = 0; i < count; i++) {
+        if (cull_visible[i])
+            cull_models.push_back(&models[i]);
+        else
+            frame_stats.culled[pass] += models[i].meshes.size();
+    }
+    AddMeshes(pass, shader, &frustum, 1, view, projection);
+}
+
+/*
+    Models the bvh leaves out are counted as culled objects, so the cost
+    follows what is in view rather than the size of the scene.
+*/
+void RenderQueue::AddFound(eRenderPass pass, const Shader &shader, const std::vector<Model> &models, const Bvh &bvh, uint32_t first_object,
+                           const Frustum *frustums, size_t num_frustums, const glm::mat4 &view, const glm::mat4 &projection) {
+    FindObjects(pass, bvh, first_object, models.size(), frustums, num_frustums);
+    cull_models.clear();
+    for (uint32_t object : cull_objects)
+        cull_models.push_back(&models[object]);
+    AddMeshes(pass, shader, frustums, num_frustums, view, projection);
+}
+
+/*
+    Queue one instanced item per mesh. Lod and depth are conservative for
+    the whole set: the nearest point of the sphere bounding the instance
+    origins, less the farthest a scaled mesh can reach from its origin.
+*/
+void RenderQueue::AddInstancedCulled(eRenderPass pass, const Shader &shader, const Model &model, const InstanceBuffer &instances, const Bvh &bvh,
+                                     uint32_t first_object, const Frustum *frustums, size_t num_frustums, const glm::mat4 &view,
+                                     const glm::mat4 &projection) {
+    if (instances.GetCount() == 0 || FindObjects(pass, bvh, first_object, instances.GetCount(), frustums, num_frustums) == 0)
+        return;
+    glm::vec3 center = glm::vec3(view * glm::vec4(instances.GetCenter(), 1.0f));
+    float scale = instances.GetMaxScale();
+    for (size_t m = 0; m < model.meshes.size(); m++) {
+        const Mesh &mesh = model.meshes[m];
+        const BoundingBox &box = instances.GetMeshBox(m);
+        bool visible = false;
+        for (size_t f = 0; f < num_frustums && !visible; f++)
+            visible = IsBoxVisible(frustums[f], box);
+        if (!visible || (software_occlusion[pass] != nullptr && !software_occlusion[pass]->IsBoxVisible(box))) {
+            frame_stats.culled[pass]++;
+            continue;
+        }
+        frame_stats.visible[pass]++;
+        float distance = -center.z - instances.GetRadius() - scale * glm::length(mesh.bounds.center);
+        uint64_t key = (uint64_t(pass) << kPassShift)
+                     | ((uint64_t(shader.ID) & kProgramMask) << kProgramShift)
+                     | (MaterialKey(mesh) << kMaterialShift)
+                     | ((uint64_t(mesh.VAO) & kVaoMask) << kVaoShift)
+                     | DepthKey(distance);
+        size_t lod = Model::selectLod(mesh, distance, scale * mesh.bounds.radius, projection);
+        entries.push_back(SortEntry{ key, static_cast<uint32_t>(items.size()) });
+        items.push_back(DrawItem{ &shader, &model, &mesh, lod, static_cast<GLsizei>(instances.GetCount()), 0, 0, box });
+    }
+}
+
+/*
+    An object found by several frustums is kept once.
+*/
+size_t RenderQueue::FindObjects(eRenderPass pass, const Bvh &bvh, uint32_t first_object, size_t count, const Frustum *frustums,
+                                size_t num_frustums) {
+    cull_objects.clear();
+    for (size_t f = 0; f < num_frustums; f++)
+        bvh.QueryFrustum(frustums[f], cull_objects);
+    size_t found = 0;
+    for (uint32_t object : cull_objects) {
+        if (object >= first_object && object - first_object < count)
+            cull_objects[found++] = object - first_object;
+    }
+    cull_objects.resize(found);
+    if (num_frustums > 1) {
+        std::sort(cull_objects.begin(), cull_objects.end());
+        cull_objects.erase(std::unique(cull_objects.begin(), cull_objects.end()), cull_objects.end());
+    }
+    frame_stats.objects_culled[pass] += count - cull_objects.size();
+    return cull_objects.size();
+}
+
+/*
+    A model with a single mesh has nothing more to reject; the meshes of the
+    others are culled together. Clusters are only culled with one frustum,
+    since layers clip by different planes.
+*/
+void RenderQueue::AddMeshes(eRenderPass pass, const Shader &shader, const Frustum *frustums, size_t num_frustums, const glm::mat4 &view,
+                            const glm::mat4 &projection) {
+    const Frustum *clip_frustum = num_frustums == 1 ? &frustums[0] : nullptr;
+    cull_boxes.Clear();
+    cull_candidates.clear();
+    for (const Model *model_pointer : cull_models) {
+        const Model &model = *model_pointer;
+        if (model.meshes.size() == 1) {
+            bool queued = Queue(pass, shader, model, model.meshes[0], view, projection, clip_frustum);
+            (queued ? frame_stats.visible : frame_stats.culled)[pass]++;
+            continue;
+        }
+        for (const Mesh &mesh : model.meshes) {
+            cull_candidates.push_back(CullCandidate{ &model, &mesh });
+            cull_boxes.Add(TransformBounds(mesh.bounds, model.model_matrix));
+        }
+    }
+    cull_visible.resize(cull_candidates.size());
+    CullBoxes(frustums[0], cull_boxes, cull_visible.data());
+    cull_layer_visible.resize(cull_candidates.size());
+    for (size_t f = 1; f < num_frustums; f++) {
+        CullBoxes(frustums[f], cull_boxes, cull_layer_visible.data());
+        for (size_t i = 0; i < cull_candidates.size(); i++)
+            cull_visible[i] |= cull_layer_visible[i];
+    }
+    for (size_t i = 0; i < cull_candidates.size(); i++) {
+        bool queued = cull_visible[i] && Queue(pass, shader, *cull_candidates[i].model, *cull_candidates[i].mesh, view, projection, clip_frustum);
+        (queued ? frame_stats.visible : frame_stats.culled)[pass]++;
+    }
+}
+
+/*
+    Queue one item for the mesh, unless it is hidden behind the pass's
+    software occluders or cluster culling finds nothing of it left. The depth part of the key is the view distance of the mesh's
+    bounding sphere center.
+*/
+bool RenderQueue::Queue(eRenderPass pass, const Shader &shader, const Model &model, const Mesh &mesh, const glm::mat4 &view, const glm::mat4 &projection,
+                        const Frustum *clip_frustum) {
+    DrawItem item = { &shader, &model, &mesh, model.selectLod(mesh, view, projection), 0, 0, 0, TransformBounds(mesh.bounds, model.model_matrix) };
+    if (software_occlusion[pass] != nullptr && !software_occlusion[pass]->IsBoxVisible(item.box))
+        return false;
+    if (clip_frustum != nullptr && !CullClusters(model, mesh, *clip_frustum, item))
+        return false;
+
+    glm::vec3 center = glm::vec3(view * model.model_matrix * glm::vec4(mesh.bounds.center, 1.0f));
+    uint64_t key = (uint64_t(pass) << kPassShift)
+                 | ((uint64_t(shader.ID) & kProgramMask) << kProgramShift)
+                 | (MaterialKey(mesh) << kMaterialShift)
+                 | ((uint64_t(mesh.VAO) & kVaoMask) << kVaoShift)
+                 | DepthKey(-center.z);
+    entries.push_back(SortEntry{ key, static_cast<uint32_t>(items.size()) });
+    items.push_back(item);
+    return true;
+}
+
+/*
+    Only full detail meshes that straddle the clip plane are split; coarser
+    lods index the vertices in a different order. The clusters left are
+    merged into as few index ranges as they allow.
+*/
+bool RenderQueue::CullClusters(const Model &model, const Mesh &mesh, const Frustum &frustum, DrawItem &item) {
+    if (!cluster_culling || frustum.num_planes == NUM_FRUSTUM_PLANES || item.lod != 0 || mesh.clusters.size() < 2)
+        return true;
+    const glm::vec4 &clip_plane = frustum.planes[NUM_FRUSTUM_PLANES];
+    if (ClassifyBox(clip_plane, item.box) != PLANE_SIDE_STRADDLING)
+        return true;
+
+    cluster_boxes.Clear();
+    for (const MeshCluster &cluster : mesh.clusters)
+        cluster_boxes.Add(TransformBox(cluster.min, cluster.max, model.model_matrix));
+    cluster_visible.resize(mesh.clusters.size());
+    size_t num_visible = CullBoxes(frustum, cluster_boxes, cluster_visible.data());
+    frame_stats.clusters_culled += mesh.clusters.size() - num_visible;
+    if (num_visible == mesh.clusters.size())
+        return true;
+
+    item.range_begin = static_cast<uint32_t>(range_counts.size());
+    for (size_t i = 0; i < mesh.clusters.size(); i++) {
+        if (!cluster_visible[i])
+            continue;
+        const MeshCluster &cluster = mesh.clusters[i];
+        if (i > 0 && cluster_visible[i - 1])
+            range_counts.back() += cluster.indexCount; // clusters are back to back in the index buffer
+        else {
+            range_counts.push_back(cluster.indexCount);
+            range_offsets.push_back((const void*)(cluster.indexOffset * sizeof(unsigned int)));
+        }
+    }
+    item.range_count = static_cast<uint32_t>(range_counts.size()) - item.range_begin;
+    return num_visible > 0;
+}
+
+/*
+    LSD radix sort on 8 bit digits. Digits every key shares (most of the
+    program and pass bits in practice) are skipped.
+*/
+void RenderQueue::RadixSort(std::vector<SortEntry> &entries, std::vector<SortEntry> &scratch) {
+    if (entries.size() < 2)
+        return;
+    scratch.resize(entries.size());
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t counts[256] = {};
+        for (const SortEntry &entry : entries)
+            counts[(entry.key >> shift) & 0xFF]++;
+        if (counts[(entries[0].key >> shift) & 0xFF] == entries.size())
+            continue;
+        size_t offset = 0;
+        for (size_t digit = 0; digit < 256; digit++) {
+            size_t count = counts[digit];
+            counts[digit] = offset;
+            offset += count;
+        }
+        for (const SortEntry &entry : entries)
+            scratch[counts[(entry.key >> shift) & 0xFF]++] = entry;
+        entries.swap(scratch);
+    }
+}
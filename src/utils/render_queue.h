@@ -0,0 +1,195 @@
+#ifndef ISLAND_UTILS_RENDER_QUEUE_H_
+#define ISLAND_UTILS_RENDER_QUEUE_H_
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "bvh.h"
+#include "frustum.h"
+#include "instance_buffer.h"
+#include "model.h"
+#include "shader.h"
+
+// passes in submission order; the pass is the most significant part of a sort key
+enum eRenderPass {
+    RENDER_PASS_REFLECTION,
+    RENDER_PASS_REFRACTION,
+    RENDER_PASS_WATER_LAYERS, // reflection and refraction drawn at once into a layered target
+    RENDER_PASS_MAIN,
+    NUM_RENDER_PASSES
+};
+
+const char *const kRenderPassNames[NUM_RENDER_PASSES] = { "reflection", "refraction", "water layers", "main" };
+
+class OcclusionCuller;
+class SoftwareOcclusion;
+
+// views a layered pass draws at once, one per layer of its target
+const size_t kMaxRenderLayers = 2;
+
+// the view and gl_ClipDistance plane of each layer of a layered pass, which share a projection
+struct RenderLayers {
+    glm::mat4 views[kMaxRenderLayers];
+    glm::vec4 clip_planes[kMaxRenderLayers];
+    size_t count;
+};
+
+// texture units the queue tracks; meshes bind texture i to unit i
+const size_t kMaxQueueTextureUnits = 16;
+
+struct RenderQueueStats {
+    uint64_t frames;
+    uint64_t draws;
+    uint64_t program_switches;
+    uint64_t texture_binds;
+    uint64_t vao_switches;
+    uint64_t instances;     // drawn by instanced draws (each of which also counts as one draw)
+    uint64_t clusters_culled; // of meshes straddling the clip plane
+    // mesh draws kept and dropped by frustum (and clip plane, and software occlusion) culling, per pass
+    uint64_t visible[NUM_RENDER_PASSES];
+    uint64_t culled[NUM_RENDER_PASSES];
+    // scene objects (models, instances) a bvh query left out, whose meshes were never looked at, per pass
+    uint64_t objects_culled[NUM_RENDER_PASSES];
+    // texture binds without elision, one per texture per draw (without the queue every draw also binds
+    // its program and vao, so draws is the baseline for those)
+    uint64_t texture_references;
+};
+
+/*
+    Collects the opaque mesh draws of every pass for a frame and submits them
+    in state order. Each draw gets a 64 bit key, most significant first:
+        pass      3 bits
+        program  10 bits   (gl program id)
+        material 16 bits   (hash of the mesh's texture ids)
+        vao      11 bits
+        depth    24 bits   (view distance, so equal state draws front to back)
+    Sort() radix sorts the keys once; Submit() draws one pass, only binding
+    the program, textures and vertex array when they differ from the
+    previous draw. Draws outside the view frustum are dropped when added:
+    whole models by their bounds first, then the meshes of the rest, which
+    may also be tested against a software occlusion buffer. Layered passes
+    keep a draw if any of their views has it in its frustum. Given
+    the pass's clip plane, draws entirely on its clipped side are dropped
+    too, and meshes straddling it are drawn without their clusters on the
+    clipped side. Truncated ids can only cost a bind, never a wrong draw,
+    since submission compares the real objects.
+*/
+class RenderQueue {
+public:
+    RenderQueue();
+
+    // queues every mesh of each model that is in view, at the lod its size in view/projection calls for.
+    // clip_plane is the gl_ClipDistance plane the shader clips with, if any. models must outlive the
+    // frame's Submit() calls.
+    void Add(eRenderPass pass, const Shader &shader, const std::vector<Model> &models, const glm::mat4 &view, const glm::mat4 &projection,
+             const glm::vec4 &clip_plane = glm::vec4(0.0f));
+    void Add(eRenderPass pass, const Shader &shader, const Model &model, const glm::mat4 &view, const glm::mat4 &projection,
+             const glm::vec4 &clip_plane = glm::vec4(0.0f));
+    // same, finding the models in view with bvh instead of testing each one. models[i] is object
+    // first_object + i of bvh, whose other objects are left to other calls.
+    void Add(eRenderPass pass, const Shader &shader, const std::vector<Model> &models, const Bvh &bvh, uint32_t first_object,
+             const glm::mat4 &view, const glm::mat4 &projection, const glm::vec4 &clip_plane = glm::vec4(0.0f));
+    // queues one instanced draw per mesh of model, drawing every instance in instances (attached to model)
+    // at the lod of the nearest possible instance. shader must be an INSTANCED variant. instance i is object
+    // first_object + i of bvh; nothing is queued unless it finds one of them in view, and the meshes are then
+    // culled by the box around all instances.
+    void AddInstanced(eRenderPass pass, const Shader &shader, const Model &model, const InstanceBuffer &instances, const Bvh &bvh,
+                      uint32_t first_object, const glm::mat4 &view, const glm::mat4 &projection, const glm::vec4 &clip_plane = glm::vec4(0.0f));
+    // same as the two above for a layered pass, whose shader draws every layer of layers at once (a LAYERED
+    // variant): what is in view in any layer is queued once, at the lod and depth of the first layer's view
+    void Add(eRenderPass pass, const Shader &shader, const std::vector<Model> &models, const Bvh &bvh, uint32_t first_object,
+             const RenderLayers &layers, const glm::mat4 &projection);
+    void AddInstanced(eRenderPass pass, const Shader &shader, const Model &model, const InstanceBuffer &instances, const Bvh &bvh,
+                      uint32_t first_object, const RenderLayers &layers, const glm::mat4 &projection);
+
+    // per-cluster clip culling of straddling meshes, on by default
+    void SetClusterCulling(bool enabled);
+    // also drops the draws of pass hidden behind occlusion's occluders, which must be rendered from the
+    // pass's camera before its Add calls; nullptr (the default) turns it off
+    void SetSoftwareOcclusion(eRenderPass pass, SoftwareOcclusion *occlusion);
+
+    void Sort();
+
+    // draws the queued items of pass into the bound framebuffer with the bound camera. with occlusion,
+    // each draw is skipped if its box was hidden last frame (see OcclusionCuller).
+    void Submit(eRenderPass pass, OcclusionCuller *occlusion = nullptr);
+
+    // clears the queue for the next frame
+    void EndFrame();
+
+    // counts of the last finished frame
+    const RenderQueueStats &GetStats() const;
+    void PrintStats() const;
+
+private:
+    struct DrawItem {
+        const Shader *shader;
+        const Model *model;
+        const Mesh *mesh;
+        size_t lod;
+        GLsizei instance_count; // 0 for a plain draw with the model's own matrix
+        uint32_t range_begin;   // index ranges left by cluster culling, drawn instead of the lod if any
+        uint32_t range_count;
+        BoundingBox box;        // world space, around everything the item draws
+    };
+
+    struct CullCandidate {
+        const Model *model;
+        const Mesh *mesh;
+    };
+
+    struct SortEntry {
+        uint64_t key;
+        uint32_t item;
+    };
+
+    void AddCulled(eRenderPass pass, const Shader &shader, const Model *models, size_t count, const glm::mat4 &view, const glm::mat4 &projection,
+                   const glm::vec4 &clip_plane);
+    // queues what bvh finds in any of the frustums
+    void AddFound(eRenderPass pass, const Shader &shader, const std::vector<Model> &models, const Bvh &bvh, uint32_t first_object,
+                  const Frustum *frustums, size_t num_frustums, const glm::mat4 &view, const glm::mat4 &projection);
+    void AddInstancedCulled(eRenderPass pass, const Shader &shader, const Model &model, const InstanceBuffer &instances, const Bvh &bvh,
+                            uint32_t first_object, const Frustum *frustums, size_t num_frustums, const glm::mat4 &view,
+                            const glm::mat4 &projection);
+    // fills cull_objects with the objects first_object .. first_object + count - 1 of bvh in any of the
+    // frustums, less first_object, and counts the rest as culled. returns how many it found.
+    size_t FindObjects(eRenderPass pass, const Bvh &bvh, uint32_t first_object, size_t count, const Frustum *frustums, size_t num_frustums);
+    // culls and queues the meshes of cull_models, keeping those in any of the frustums
+    void AddMeshes(eRenderPass pass, const Shader &shader, const Frustum *frustums, size_t num_frustums, const glm::mat4 &view,
+                   const glm::mat4 &projection);
+    // clip_frustum is the frustum to cull clusters against, nullptr for none
+    bool Queue(eRenderPass pass, const Shader &shader, const Model &model, const Mesh &mesh, const glm::mat4 &view, const glm::mat4 &projection,
+               const Frustum *clip_frustum);
+    // false if every cluster is culled
+    bool CullClusters(const Model &model, const Mesh &mesh, const Frustum &frustum, DrawItem &item);
+
+    static void RadixSort(std::vector<SortEntry> &entries, std::vector<SortEntry> &scratch);
+
+    std::vector<DrawItem> items;
+    std::vector<SortEntry> entries;
+    std::vector<SortEntry> scratch;
+    std::vector<GLsizei> range_counts;      // glMultiDrawElements arguments of the items' ranges
+    std::vector<const void*> range_offsets;
+    size_t pass_begin[NUM_RENDER_PASSES + 1];
+
+    // culling scratch, kept between calls
+    CullBatch cull_boxes;
+    std::vector<uint8_t> cull_visible;
+    std::vector<uint8_t> cull_layer_visible;
+    std::vector<CullCandidate> cull_candidates;
+    std::vector<const Model*> cull_models;
+    std::vector<uint32_t> cull_objects;
+    CullBatch cluster_boxes;
+    std::vector<uint8_t> cluster_visible;
+    bool cluster_culling;
+    SoftwareOcclusion *software_occlusion[NUM_RENDER_PASSES];
+
+    RenderQueueStats frame_stats;
+    RenderQueueStats last_stats;
+    RenderQueueStats total_stats;
+};
+
+#endif // ISLAND_UTILS_RENDER_QUEUE_H_
@@ -0,0 +1,107 @@
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "resolution_controller.h"
+
+// ----------- PUBLIC ----------- //
+ResolutionController::ResolutionController(float budget_ms, float min_scale, float max_scale, float scale)
+    : budget_ms(budget_ms), min_scale(min_scale), max_scale(max_scale), scale(std::clamp(scale, min_scale, max_scale)),
+      pending(), next(0), timing(false), frame_stats(), last_stats(), total_stats() {
+    glGenQueries(kResolutionTimerQueries, queries);
+}
+
+void ResolutionController::CleanUp() {
+    glDeleteQueries(kResolutionTimerQueries, queries);
+}
+
+/*
+    A slot whose result has not arrived by now is still in use, so the
+    frame goes untimed rather than waiting for it.
+*/
+void ResolutionController::BeginTiming() {
+    if (pending[next])
+        return;
+    glBeginQuery(GL_TIME_ELAPSED, queries[next]);
+    timing = true;
+}
+
+void ResolutionController::EndTiming() {
+    if (!timing)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    pending[next] = true;
+    next = (next + 1) % kResolutionTimerQueries;
+    timing = false;
+}
+
+/*
+    Collect the available results oldest first and steer by the newest.
+*/
+void ResolutionController::EndFrame() {
+    float latest_ms = -1.0f;
+    for (size_t i = 0; i < kResolutionTimerQueries; i++) {
+        size_t slot = (next + i) % kResolutionTimerQueries;
+        if (!pending[slot])
+            continue;
+        GLuint available = 0;
+        glGetQueryObjectuiv(queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+        GLuint64 elapsed_ns = 0;
+        glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &elapsed_ns);
+        pending[slot] = false;
+        latest_ms = static_cast<float>(elapsed_ns / 1.0e6);
+        frame_stats.measured++;
+        frame_stats.gpu_ms += latest_ms;
+    }
+    if (latest_ms >= 0.0f)
+        Adjust(latest_ms);
+
+    frame_stats.frames = 1;
+    frame_stats.scale = scale;
+    last_stats = frame_stats;
+    total_stats.frames += frame_stats.frames;
+    total_stats.measured += frame_stats.measured;
+    total_stats.gpu_ms += frame_stats.gpu_ms;
+    total_stats.scale += frame_stats.scale;
+    frame_stats = ResolutionStats();
+}
+
+float ResolutionController::GetScale() const {
+    return scale;
+}
+
+const ResolutionStats &ResolutionController::GetStats() const {
+    return last_stats;
+}
+
+void ResolutionController::PrintStats() const {
+    const ResolutionStats &s = last_stats;
+    std::cout << "RESOLUTION:: last frame: scale " << s.scale;
+    if (s.measured > 0)
+        std::cout << ", " << s.gpu_ms / s.measured << " ms gpu";
+    std::cout << " (budget " << budget_ms << " ms)" << std::endl;
+    if (total_stats.frames == 0)
+        return;
+    std::cout << "RESOLUTION:: over " << total_stats.frames << " frames: mean scale " << total_stats.scale / total_stats.frames;
+    if (total_stats.measured > 0)
+        std::cout << ", " << total_stats.gpu_ms / total_stats.measured << " ms gpu over " << total_stats.measured << " timings";
+    std::cout << std::endl;
+}
+
+// ----------- PRIVATE ----------- //
+/*
+    Time goes with the pixel count, so the scale that would hit the middle
+    of the band is scale * sqrt(target / measured).
+*/
+void ResolutionController::Adjust(float gpu_ms) {
+    if (gpu_ms <= budget_ms && gpu_ms >= kResolutionHeadroom * budget_ms)
+        return;
+    float target_ms = budget_ms * (1.0f + kResolutionHeadroom) * 0.5f;
+    float step = std::sqrt(target_ms / std::max(gpu_ms, 1e-3f));
+    step = std::clamp(step, 1.0f - kResolutionMaxStep, 1.0f + kResolutionMaxStep);
+    scale = std::clamp(scale * step, min_scale, max_scale);
+}
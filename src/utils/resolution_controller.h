@@ -0,0 +1,70 @@
+#ifndef ISLAND_UTILS_RESOLUTION_CONTROLLER_H_
+#define ISLAND_UTILS_RESOLUTION_CONTROLLER_H_
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// timer queries in flight; results are read a few frames late, so the cpu never waits on them
+const size_t kResolutionTimerQueries = 4;
+// the scale is left alone while the measured time is between this fraction of the budget and the budget
+const float kResolutionHeadroom = 0.8f;
+// largest relative change of the scale in one frame
+const float kResolutionMaxStep = 0.1f;
+
+struct ResolutionStats {
+    uint64_t frames;
+    uint64_t measured;  // frames a timer result was read in
+    double gpu_ms;      // sum of the results read
+    double scale;       // sum of the scales the frames ended with
+};
+
+/*
+    Keeps a set of passes within a gpu time budget by scaling the
+    resolution they render at. The passes are wrapped in BeginTiming() /
+    EndTiming(), which time them with a GL_TIME_ELAPSED query from a small
+    ring; EndFrame() reads whatever results have arrived and, if the
+    latest falls outside [kResolutionHeadroom * budget, budget], moves the
+    scale towards the middle of that band. Cost is taken to grow with the
+    pixel count, i.e. with the square of the scale; the step is limited to
+    kResolutionMaxStep so a single slow frame does not swing it.
+*/
+class ResolutionController {
+public:
+    ResolutionController(float budget_ms, float min_scale, float max_scale, float scale);
+
+    void CleanUp();
+
+    // time the passes issued between the two calls; skipped for the frame if no query is free
+    void BeginTiming();
+    void EndTiming();
+
+    // reads finished timings, adjusts the scale and rolls the counters over
+    void EndFrame();
+
+    // per side, in [min_scale, max_scale]
+    float GetScale() const;
+
+    // counts of the last finished frame
+    const ResolutionStats &GetStats() const;
+    void PrintStats() const;
+
+private:
+    float budget_ms;
+    float min_scale;
+    float max_scale;
+    float scale;
+
+    GLuint queries[kResolutionTimerQueries];
+    bool pending[kResolutionTimerQueries];
+    size_t next;  // ring slot of the next timing
+    bool timing;  // a query of this frame is active
+
+    ResolutionStats frame_stats;
+    ResolutionStats last_stats;
+    ResolutionStats total_stats;
+
+    void Adjust(float gpu_ms);
+};
+
+#endif // ISLAND_UTILS_RESOLUTION_CONTROLLER_H_
@@ -1,15 +1,42 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <algorithm>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+#include "gl_state.h"
 #include "shader.h"
+#include "uniform_buffers.h"
+
+namespace {
+
+const char kIncludeDirective[] = "#pragma include ";
+
+// shared code a stage pulls in by name with a "#pragma include <name>" line
+struct ShaderInclude
+{
+    const char* name;
+    const char* code;
+};
+
+const ShaderInclude kShaderIncludes[] = {
+    { "octahedral",
+      "// unpack an octahedral-encoded unit vector (see vertex_format.h)\n"
+      "vec3 DecodeOctahedral(vec2 e) {\n"
+      "    vec3 v = vec3(e, 1.0f - abs(e.x) - abs(e.y));\n"
+      "    if (v.z < 0.0f)\n"
+      "        v.xy = (1.0f - abs(v.yx)) * vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);\n"
+      "    return normalize(v);\n"
+      "}\n" },
+};
+
+} // namespace
 
 // constructor
-Shader::Shader(const char* vert_path, const char* frag_path, const char* geom_path)
+Shader::Shader(const char* vert_path, const char* frag_path, const char* geom_path, const char* defines)
 {
     // 1. retrieve the vertex/fragment source code from filePath
     std::string vert_code;
@@ -50,6 +77,15 @@ Shader::Shader(const char* vert_path, const char* frag_path, const char* geom_pa
     {
         std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
     }
+    insertIncludes(vert_code);
+    insertIncludes(frag_code);
+    insertIncludes(geom_code);
+    if (defines != nullptr)
+    {
+        insertDefines(vert_code, defines);
+        insertDefines(frag_code, defines);
+        insertDefines(geom_code, defines);
+    }
     const char* v_shader_code = vert_code.c_str();
     const char* f_shader_code = frag_code.c_str();
     // 2. compile shaders
@@ -84,6 +120,9 @@ Shader::Shader(const char* vert_path, const char* frag_path, const char* geom_pa
     }
     glLinkProgram(ID);
     checkCompileErrors(ID, "PROGRAM");
+    queryVertexAttributes();
+    queryUniforms();
+    bindUniformBlocks();
     // delete the shaders as they're linked into our program now and no longer necessary
     glDeleteShader(vertex);
     glDeleteShader(fragment);
@@ -96,57 +135,192 @@ Shader::Shader(const char* vert_path, const char* frag_path, const char* geom_pa
 // activate the shader 
 void Shader::use() const
 {
-    glUseProgram(ID); 
+    g_gl_state.UseProgram(ID);
+}
+
+unsigned int Shader::getVertexAttributes() const
+{
+    return vertex_attributes;
 }
 
 // utility uniform functions 
-void Shader::setBool(const std::string &name, bool value) const
+void Shader::setBool(UniformId id, bool value) const
+{
+    glUniform1i(getUniformLocation(id), (int)value);
+}
+void Shader::setInt(UniformId id, int value) const
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    glUniform1i(getUniformLocation(id), value);
 }
-void Shader::setInt(const std::string &name, int value) const
+void Shader::setFloat(UniformId id, float value) const
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1f(getUniformLocation(id), value); 
 }
-void Shader::setFloat(const std::string &name, float value) const
+void Shader::setVec2(UniformId id, glm::vec2 &value) const
 {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+    glUniform2fv(getUniformLocation(id), 1, &value[0]);
 }
-void Shader::setVec2(const std::string &name, glm::vec2 &value) const
+void Shader::setVec2(UniformId id, float x, float y) const
 {
-    glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform2f(getUniformLocation(id), x, y); 
 }
-void Shader::setVec2(const std::string &name, float x, float y) const
+void Shader::setVec3(UniformId id, glm::vec3 &value) const
 {
-    glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+    glUniform3fv(getUniformLocation(id), 1, &value[0]);
 }
-void Shader::setVec3(const std::string &name, glm::vec3 &value) const
+void Shader::setVec3(UniformId id, float x, float y, float z) const
 {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform3f(getUniformLocation(id), x, y, z);
 }
-void Shader::setVec3(const std::string &name, float x, float y, float z) const
+void Shader::setVec4(UniformId id, glm::vec4 &value) const
 {
-    glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+    glUniform4fv(getUniformLocation(id), 1, &value[0]);
+}
+void Shader::setVec4(UniformId id, float x, float y, float z, float w) const
+{
+    glUniform4f(getUniformLocation(id), x, y, z, w);
+}
+void Shader::setMat2(UniformId id, const glm::mat2 &mat) const
+{
+    glUniformMatrix2fv(getUniformLocation(id), 1, GL_FALSE, &mat[0][0]);
+}
+void Shader::setMat3(UniformId id, const glm::mat3 &mat) const
+{
+    glUniformMatrix3fv(getUniformLocation(id), 1, GL_FALSE, &mat[0][0]);
+}
+void Shader::setMat4(UniformId id, const glm::mat4 &mat) const
+{
+    glUniformMatrix4fv(getUniformLocation(id), 1, GL_FALSE, &mat[0][0]);
+}
+
+// adds the variant's defines right after the #version line, which has to stay first
+void Shader::insertDefines(std::string &code, const char* defines)
+{
+    if (code.empty())
+        return;
+    size_t line_end = code.compare(0, 8, "#version") == 0 ? code.find('\n') : std::string::npos;
+    if (line_end == std::string::npos)
+        code.insert(0, defines);
+    else
+        code.insert(line_end + 1, defines);
 }
-void Shader::setVec4(const std::string &name, glm::vec4 &value) const
+
+// replaces every "#pragma include <name>" line with the shared code of that name
+void Shader::insertIncludes(std::string &code)
 {
-    glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    size_t start = 0;
+    while ((start = code.find(kIncludeDirective, start)) != std::string::npos)
+    {
+        size_t end = code.find('\n', start);
+        if (end == std::string::npos)
+            end = code.size();
+        size_t name_start = start + sizeof(kIncludeDirective) - 1;
+        std::string name = code.substr(name_start, code.find_last_not_of(" \t\r", end - 1) + 1 - name_start);
+        const ShaderInclude *include = std::find_if(std::begin(kShaderIncludes), std::end(kShaderIncludes),
+            [&name](const ShaderInclude &i) { return name == i.name; });
+        if (include == std::end(kShaderIncludes))
+        {
+            std::cout << "ERROR::SHADER::UNKNOWN_INCLUDE: " << name << std::endl;
+            code.erase(start, end - start);
+            continue;
+        }
+        code.replace(start, end - start, include->code);
+        start += std::char_traits<char>::length(include->code);
+    }
 }
-void Shader::setVec4(const std::string &name, float x, float y, float z, float w) const
+
+// records which attribute locations the linked program actually uses, so meshes can be packed without the rest
+void Shader::queryVertexAttributes()
 {
-    glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+    vertex_attributes = 0;
+    GLint count = 0;
+    glGetProgramiv(ID, GL_ACTIVE_ATTRIBUTES, &count);
+    for (GLint i = 0; i < count; i++)
+    {
+        GLchar name[256];
+        GLint size;
+        GLenum type;
+        glGetActiveAttrib(ID, i, sizeof(name), NULL, &size, &type, name);
+        GLint location = glGetAttribLocation(ID, name);
+        if (location >= 0 && location < 32) // built-ins like gl_VertexID have no location
+            vertex_attributes |= 1u << location;
+    }
 }
-void Shader::setMat2(const std::string &name, const glm::mat2 &mat) const
+
+// attaches the shared blocks the program declares (see uniform_buffers.h) to their fixed binding points
+void Shader::bindUniformBlocks()
 {
-    glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    for (unsigned int block = 0; block < NUM_UNIFORM_BLOCKS; block++)
+    {
+        GLuint index = glGetUniformBlockIndex(ID, kUniformBlockNames[block]);
+        if (index == GL_INVALID_INDEX)
+            continue;
+        glUniformBlockBinding(ID, index, block);
+        GLint size = 0;
+        glGetActiveUniformBlockiv(ID, index, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+        if (static_cast<size_t>(size) > kUniformBlockSizes[block])
+            std::cout << "ERROR::SHADER::UNIFORM_BLOCK_SIZE: " << kUniformBlockNames[block] << " is " << size << " bytes, expected " << kUniformBlockSizes[block] << " (program " << ID << ")" << std::endl;
+    }
 }
-void Shader::setMat3(const std::string &name, const glm::mat3 &mat) const
+
+// looks up the cached location of a uniform; unknown uniforms are reported once per program and get location 
+// -1, which glUniform* ignores
+GLint Shader::getUniformLocation(UniformId id) const
 {
-    glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    std::vector<std::pair<uint32_t, GLint>> &locations = uniforms->locations;
+    auto it = std::lower_bound(locations.begin(), locations.end(), std::make_pair(id.hash, GLint(-1)));
+    if (it != locations.end() && it->first == id.hash)
+        return it->second;
+
+    std::vector<uint32_t> &reported = uniforms->reported;
+    if (std::find(reported.begin(), reported.end(), id.hash) == reported.end())
+    {
+        reported.push_back(id.hash);
+        std::cout << "WARNING::SHADER::UNKNOWN_UNIFORM: " << id.name << " (program " << ID << ")" << std::endl;
+    }
+    return -1;
 }
-void Shader::setMat4(const std::string &name, const glm::mat4 &mat) const
+
+// introspects every active uniform of the linked program and caches its location by name hash. arrays are
+// registered under their base name and every element.
+void Shader::queryUniforms()
 {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    uniforms = std::make_shared<UniformCache>();
+    std::vector<std::pair<uint32_t, GLint>> &locations = uniforms->locations;
+    std::vector<std::string> names;
+    GLint count = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    for (GLint i = 0; i < count; i++)
+    {
+        GLchar name[256];
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(ID, i, sizeof(name), NULL, &size, &type, name);
+        std::string uniform_name = name;
+        names.push_back(uniform_name);
+        // arrays of basic types come back as "name[0]"
+        size_t bracket = uniform_name.size() >= 3 ? uniform_name.size() - 3 : std::string::npos;
+        if (bracket != std::string::npos && uniform_name.compare(bracket, 3, "[0]") == 0)
+        {
+            std::string base = uniform_name.substr(0, bracket);
+            names.push_back(base);
+            for (GLint element = 1; element < size; element++)
+                names.push_back(base + "[" + std::to_string(element) + "]");
+        }
+    }
+    for (const std::string &name : names)
+    {
+        GLint location = glGetUniformLocation(ID, name.c_str());
+        if (location >= 0)
+            locations.push_back(std::make_pair(HashUniformName(name.c_str()), location));
+    }
+    std::sort(locations.begin(), locations.end());
+
+    for (size_t i = 1; i < locations.size(); i++)
+    {
+        if (locations[i].first == locations[i - 1].first && locations[i].second != locations[i - 1].second)
+            std::cout << "WARNING::SHADER::UNIFORM_HASH_COLLISION: program " << ID << std::endl;
+    }
 }
 
 // error reporter
@@ -4,32 +4,77 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
+
+// FNV-1a (32 bit) of a uniform name; constexpr so ids of literal names are folded at compile time
+constexpr uint32_t HashUniformName(const char *name, uint32_t hash = 2166136261u)
+{
+    return *name == '\0' ? hash : HashUniformName(name + 1, (hash ^ static_cast<unsigned char>(*name)) * 16777619u);
+}
+
+// a uniform, identified by the hash of its name. the name is only kept for diagnostics. declare ids as 
+// constexpr (see uniforms.h) so no hashing happens at runtime.
+struct UniformId
+{
+    uint32_t hash;
+    const char *name;
+
+    constexpr explicit UniformId(const char *name) : hash(HashUniformName(name)), name(name) {}
+    constexpr UniformId(uint32_t hash, const char *name) : hash(hash), name(name) {}
+};
 
 class Shader 
 {
 public:
     unsigned int ID;
-    Shader(const char* vert_path, const char* frag_path, const char* geom_path = nullptr);
+    // defines, e.g. "#define INSTANCED\n", is inserted after the #version line of every stage, so one source 
+    // file can build several variants. a stage pulls in shared code, e.g. DecodeOctahedral(), with a
+    // "#pragma include octahedral" line.
+    Shader(const char* vert_path, const char* frag_path, const char* geom_path = nullptr, const char* defines = nullptr);
 
     // activate the shader 
     void use() const;
 
+    // mask of the vertex attribute locations the program reads (see eVertexAttribute)
+    unsigned int getVertexAttributes() const;
+
     // utility uniform functions 
-    void setBool(const std::string &name, bool value) const;
-    void setInt(const std::string &name, int value) const;
-    void setFloat(const std::string &name, float value) const;
-    void setVec2(const std::string &name, glm::vec2 &value) const;
-    void setVec2(const std::string &name, float x, float y) const;
-    void setVec3(const std::string &name, glm::vec3 &value) const;
-    void setVec3(const std::string &name, float x, float y, float z) const;
-    void setVec4(const std::string &name, glm::vec4 &value) const;
-    void setVec4(const std::string &name, float x, float y, float z, float w) const;
-    void setMat2(const std::string &name, const glm::mat2 &mat) const;
-    void setMat3(const std::string &name, const glm::mat3 &mat) const;
-    void setMat4(const std::string &name, const glm::mat4 &mat) const;
+    void setBool(UniformId id, bool value) const;
+    void setInt(UniformId id, int value) const;
+    void setFloat(UniformId id, float value) const;
+    void setVec2(UniformId id, glm::vec2 &value) const;
+    void setVec2(UniformId id, float x, float y) const;
+    void setVec3(UniformId id, glm::vec3 &value) const;
+    void setVec3(UniformId id, float x, float y, float z) const;
+    void setVec4(UniformId id, glm::vec4 &value) const;
+    void setVec4(UniformId id, float x, float y, float z, float w) const;
+    void setMat2(UniformId id, const glm::mat2 &mat) const;
+    void setMat3(UniformId id, const glm::mat3 &mat) const;
+    void setMat4(UniformId id, const glm::mat4 &mat) const;
 
 private:
+    // active uniform locations sorted by name hash, filled once after linking. shared by copies of the 
+    // shader, along with the hashes of unknown uniforms that were already reported.
+    struct UniformCache
+    {
+        std::vector<std::pair<uint32_t, GLint>> locations;
+        std::vector<uint32_t> reported;
+    };
+
+    unsigned int vertex_attributes;
+    std::shared_ptr<UniformCache> uniforms;
+
+    GLint getUniformLocation(UniformId id) const;
+    void queryUniforms();
+
+    void queryVertexAttributes();
+    void bindUniformBlocks();
+    static void insertDefines(std::string &code, const char* defines);
+    static void insertIncludes(std::string &code);
     void checkCompileErrors(GLuint shader, std::string type);
 };
 
@@ -0,0 +1,220 @@
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+#include "parallel.h"
+#include "software_occlusion.h"
+
+namespace {
+
+const float kWidth = static_cast<float>(kSoftwareOcclusionWidth);
+const float kHeight = static_cast<float>(kSoftwareOcclusionHeight);
+
+// smallest clip w treated as in front of the eye
+const float kMinClipW = 1e-4f;
+
+} // namespace
+
+// ----------- PUBLIC ----------- //
+SoftwareOcclusion::SoftwareOcclusion()
+    : depth(kSoftwareOcclusionWidth * kSoftwareOcclusionHeight, 1.0f), view_projection(1.0f),
+      frame_stats(), last_stats(), total_stats() {
+}
+
+void SoftwareOcclusion::AddOccluder(const Model &model) {
+    occluders.push_back(&model);
+}
+
+/*
+    Project every occluder vertex once, then rasterise the bands in
+    parallel; each task owns its rows of the depth buffer, so no locking.
+*/
+void SoftwareOcclusion::Render(const glm::mat4 &view_projection) {
+    this->view_projection = view_projection;
+    std::fill(depth.begin(), depth.end(), 1.0f);
+    vertices.clear();
+    indices.clear();
+
+    for (const Model *model : occluders) {
+        glm::mat4 model_view_projection = view_projection * model->model_matrix;
+        for (const Mesh &mesh : model->meshes) {
+            uint32_t base = static_cast<uint32_t>(vertices.size());
+            for (const glm::vec3 &position : mesh.occluderPositions) {
+                glm::vec4 clip = model_view_projection * glm::vec4(position, 1.0f);
+                ScreenVertex vertex = { 0.0f, 0.0f, 0.0f, clip.w <= kMinClipW || clip.z < -clip.w };
+                if (!vertex.clipped) {
+                    glm::vec3 ndc = glm::vec3(clip) / clip.w;
+                    vertex.x = (ndc.x * 0.5f + 0.5f) * kWidth;
+                    vertex.y = (ndc.y * 0.5f + 0.5f) * kHeight;
+                    vertex.z = ndc.z * 0.5f + 0.5f;
+                }
+                vertices.push_back(vertex);
+            }
+            for (unsigned int index : mesh.occluderIndices)
+                indices.push_back(base + index);
+        }
+    }
+    frame_stats.triangles += indices.size() / 3;
+
+    ParallelFor(kSoftwareOcclusionBands, [this](size_t band) { RasteriseBand(band); });
+}
+
+/*
+    The box's screen rectangle (widened to whole groups of 4 pixels, which
+    can only keep more boxes) is hidden if every depth in it is nearer than
+    the box's nearest corner. Boxes reaching behind the near plane are
+    always visible.
+*/
+bool SoftwareOcclusion::IsBoxVisible(const BoundingBox &box) {
+    frame_stats.tested++;
+    glm::vec2 min(std::numeric_limits<float>::max()), max(-std::numeric_limits<float>::max());
+    float nearest = 1.0f;
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec3 sign = glm::vec3(corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f, corner & 4 ? 1.0f : -1.0f);
+        glm::vec4 clip = view_projection * glm::vec4(box.center + sign * box.extent, 1.0f);
+        if (clip.w <= kMinClipW || clip.z < -clip.w)
+            return true;
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        glm::vec2 pixel = glm::vec2((ndc.x * 0.5f + 0.5f) * kWidth, (ndc.y * 0.5f + 0.5f) * kHeight);
+        min = glm::min(min, pixel);
+        max = glm::max(max, pixel);
+        nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+    }
+    if (max.x <= 0.0f || max.y <= 0.0f || min.x >= kWidth || min.y >= kHeight)
+        return true; // off screen, left to frustum culling
+
+    int x0 = std::max(static_cast<int>(std::floor(min.x)), 0) & ~3;
+    int x1 = std::min(static_cast<int>(std::ceil(max.x)), static_cast<int>(kSoftwareOcclusionWidth));
+    int y0 = std::max(static_cast<int>(std::floor(min.y)), 0);
+    int y1 = std::min(static_cast<int>(std::ceil(max.y)), static_cast<int>(kSoftwareOcclusionHeight));
+    for (int y = y0; y < y1; y++) {
+        const float *row = &depth[y * kSoftwareOcclusionWidth];
+#if defined(__SSE2__) || defined(_M_X64)
+        __m128 box_depth = _mm_set1_ps(nearest);
+        for (int x = x0; x < x1; x += 4) {
+            if (_mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(row + x), box_depth)) != 0)
+                return true;
+        }
+#else
+        for (int x = x0; x < x1; x++) {
+            if (row[x] > nearest)
+                return true;
+        }
+#endif
+    }
+    frame_stats.culled++;
+    return false;
+}
+
+void SoftwareOcclusion::EndFrame() {
+    frame_stats.frames = 1;
+    last_stats = frame_stats;
+    total_stats.frames += frame_stats.frames;
+    total_stats.triangles += frame_stats.triangles;
+    total_stats.tested += frame_stats.tested;
+    total_stats.culled += frame_stats.culled;
+    frame_stats = SoftwareOcclusionStats();
+}
+
+const SoftwareOcclusionStats &SoftwareOcclusion::GetStats() const {
+    return last_stats;
+}
+
+void SoftwareOcclusion::PrintStats() const {
+    const SoftwareOcclusionStats &s = last_stats;
+    std::cout << "SOFTWARE_OCCLUSION:: last frame: " << s.triangles << " occluder triangles, " << s.culled << "/" << s.tested
+              << " boxes culled" << std::endl;
+    if (total_stats.frames == 0)
+        return;
+    double frames = static_cast<double>(total_stats.frames);
+    std::cout << "SOFTWARE_OCCLUSION:: per frame over " << total_stats.frames << " frames: " << total_stats.triangles / frames
+              << " occluder triangles, " << total_stats.culled / frames << "/" << total_stats.tested / frames << " boxes culled" << std::endl;
+}
+
+// ----------- PRIVATE ----------- //
+/*
+    Conservative half-space rasterisation: a texel is covered only when the
+    triangle covers all of it, i.e. when all three edge functions are
+    non-negative at its corner deepest inside each edge (triangles are
+    flipped to one winding, so both faces count). It then takes the nearer
+    of its depth and the farthest depth of the triangle's plane over it, so
+    a stored depth is never nearer than the occluder anywhere in its
+    texel. Both are folded into the edge and depth constants, which are
+    then evaluated at texel centers.
+*/
+void SoftwareOcclusion::RasteriseBand(size_t band) {
+    const int band_y0 = static_cast<int>(band * kSoftwareOcclusionHeight / kSoftwareOcclusionBands);
+    const int band_y1 = static_cast<int>((band + 1) * kSoftwareOcclusionHeight / kSoftwareOcclusionBands);
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        ScreenVertex v0 = vertices[indices[i]], v1 = vertices[indices[i + 1]], v2 = vertices[indices[i + 2]];
+        if (v0.clipped || v1.clipped || v2.clipped)
+            continue;
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+        if (area < 0.0f) {
+            std::swap(v1, v2);
+            area = -area;
+        }
+        if (area < 1e-6f)
+            continue;
+
+        int x0 = std::max(static_cast<int>(std::floor(std::min(v0.x, std::min(v1.x, v2.x)))), 0);
+        int x1 = std::min(static_cast<int>(std::ceil(std::max(v0.x, std::max(v1.x, v2.x)))), static_cast<int>(kSoftwareOcclusionWidth));
+        int y0 = std::max(static_cast<int>(std::floor(std::min(v0.y, std::min(v1.y, v2.y)))), band_y0);
+        int y1 = std::min(static_cast<int>(std::ceil(std::max(v0.y, std::max(v1.y, v2.y)))), band_y1);
+        if (x0 >= x1 || y0 >= y1)
+            continue;
+        x0 &= ~3;
+
+        // edge a -> b: (a.y - b.y) x + (b.x - a.x) y + (a.x b.y - a.y b.x), positive inside
+        const ScreenVertex *edge[3][2] = { { &v0, &v1 }, { &v1, &v2 }, { &v2, &v0 } };
+        float a[3], b[3], c[3];
+        for (int e = 0; e < 3; e++) {
+            a[e] = edge[e][0]->y - edge[e][1]->y;
+            b[e] = edge[e][1]->x - edge[e][0]->x;
+            c[e] = edge[e][0]->x * edge[e][1]->y - edge[e][0]->y * edge[e][1]->x;
+            // from the center to the texel corner where the edge function is smallest
+            c[e] -= 0.5f * (std::fabs(a[e]) + std::fabs(b[e]));
+        }
+        float dzdx = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+        float dzdy = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+        // from the center to the texel corner where the plane is farthest
+        float dzc = v0.z - dzdx * v0.x - dzdy * v0.y + 0.5f * (std::fabs(dzdx) + std::fabs(dzdy));
+
+        for (int y = y0; y < y1; y++) {
+            float py = y + 0.5f;
+            float *row = &depth[y * kSoftwareOcclusionWidth];
+#if defined(__SSE2__) || defined(_M_X64)
+            __m128 zero = _mm_setzero_ps();
+            __m128 row_e0 = _mm_set1_ps(b[0] * py + c[0]), row_e1 = _mm_set1_ps(b[1] * py + c[1]), row_e2 = _mm_set1_ps(b[2] * py + c[2]);
+            __m128 row_z = _mm_set1_ps(dzdy * py + dzc);
+            __m128 a0 = _mm_set1_ps(a[0]), a1 = _mm_set1_ps(a[1]), a2 = _mm_set1_ps(a[2]), z_step = _mm_set1_ps(dzdx);
+            for (int x = x0; x < x1; x += 4) {
+                __m128 px = _mm_add_ps(_mm_set1_ps(x + 0.5f), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+                __m128 inside = _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, px), row_e0), zero),
+                                _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, px), row_e1), zero),
+                                           _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, px), row_e2), zero)));
+                if (_mm_movemask_ps(inside) == 0)
+                    continue;
+                __m128 old_depth = _mm_loadu_ps(row + x);
+                __m128 new_depth = _mm_min_ps(old_depth, _mm_add_ps(_mm_mul_ps(z_step, px), row_z));
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, new_depth), _mm_andnot_ps(inside, old_depth)));
+            }
+#else
+            for (int x = x0; x < x1; x++) {
+                float px = x + 0.5f;
+                if (a[0] * px + b[0] * py + c[0] < 0.0f || a[1] * px + b[1] * py + c[1] < 0.0f || a[2] * px + b[2] * py + c[2] < 0.0f)
+                    continue;
+                row[x] = std::min(row[x], dzdx * px + dzdy * py + dzc);
+            }
+#endif
+        }
+    }
+}
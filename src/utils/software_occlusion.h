@@ -0,0 +1,82 @@
+#ifndef ISLAND_UTILS_SOFTWARE_OCCLUSION_H_
+#define ISLAND_UTILS_SOFTWARE_OCCLUSION_H_
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "frustum.h"
+#include "model.h"
+
+// depth buffer resolution; the width must be a multiple of 4
+const size_t kSoftwareOcclusionWidth = 256;
+const size_t kSoftwareOcclusionHeight = 128;
+// horizontal bands rasterised in parallel
+const size_t kSoftwareOcclusionBands = 8;
+
+struct SoftwareOcclusionStats {
+    uint64_t frames;
+    uint64_t triangles; // occluder triangles rasterised
+    uint64_t tested;    // boxes tested
+    uint64_t culled;    // of those, hidden behind the occluders
+};
+
+/*
+    CPU occlusion culling for hosts where the gpu is software too (Mesa's
+    llvmpipe on the CI and headless render boxes), where every draw skipped
+    before submission saves cpu time. A few large occluders are rasterised
+    at low resolution into a depth buffer on the worker pool, one band of
+    rows per task, 4 pixels at a time with SSE. Boxes are then tested
+    conservatively: their screen rectangle against their nearest depth.
+
+    The buffer never claims more than the occluders hide: occluders are
+    drawn from their mesh's full detail lod (a simplified one can bulge
+    past what is drawn), a texel is only written where one triangle covers
+    all of it, and it keeps the farthest depth of that triangle over it.
+    Texels along the edges between triangles are left open, so occluders
+    made of small triangles hide less. Occluder triangles that reach
+    behind the near plane are dropped rather than clipped, which only
+    makes culling more conservative too.
+*/
+class SoftwareOcclusion {
+public:
+    SoftwareOcclusion();
+
+    // occluders are drawn with their current model matrix; they must outlive their use
+    void AddOccluder(const Model &model);
+
+    // rasterises the occluders as seen through view_projection
+    void Render(const glm::mat4 &view_projection);
+
+    // false if box is certainly hidden behind the occluders of the last Render()
+    bool IsBoxVisible(const BoundingBox &box);
+
+    // rolls the frame's counters over
+    void EndFrame();
+
+    // counts of the last finished frame
+    const SoftwareOcclusionStats &GetStats() const;
+    void PrintStats() const;
+
+private:
+    // screen space vertex: pixels, and depth in [0, 1]
+    struct ScreenVertex {
+        float x, y, z;
+        bool clipped; // behind the near plane
+    };
+
+    std::vector<const Model*> occluders;
+    std::vector<ScreenVertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<float> depth; // row major, kSoftwareOcclusionWidth x kSoftwareOcclusionHeight, nearest first
+    glm::mat4 view_projection;
+
+    SoftwareOcclusionStats frame_stats;
+    SoftwareOcclusionStats last_stats;
+    SoftwareOcclusionStats total_stats;
+
+    void RasteriseBand(size_t band);
+};
+
+#endif // ISLAND_UTILS_SOFTWARE_OCCLUSION_H_
@@ -0,0 +1,16 @@
+#include "stb_image.h"
+#include "texture.h"
+
+/*
+    Decode an image file into 8-bit pixels. stb_image keeps no per-call global
+    state besides the failure reason, so this can run on any thread.
+*/
+ImageData DecodeImage(const char *path, const std::string &directory) {
+    ImageData image;
+    image.path = path;
+    std::string filename = directory + '/' + std::string(path);
+    unsigned char *data = stbi_load(filename.c_str(), &image.width, &image.height, &image.components, 0);
+    if (data)
+        image.pixels = std::shared_ptr<unsigned char>(data, stbi_image_free);
+    return image;
+}
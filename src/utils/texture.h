@@ -0,0 +1,26 @@
+#ifndef ISLAND_UTILS_TEXTURE_H_
+#define ISLAND_UTILS_TEXTURE_H_
+
+#include <memory>
+#include <string>
+
+// how a texture's channels are sampled; decides its compressed format
+enum eTextureUsage {
+    TEXTURE_USAGE_COLOR,      // rgb(a) color data
+    TEXTURE_USAGE_TWO_CHANNEL // only r and g are sampled (e.g. dudv maps)
+};
+
+// decoded 8-bit image, ready to be uploaded to the gpu
+struct ImageData {
+    std::string path;
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    std::shared_ptr<unsigned char> pixels; // freed with stbi_image_free
+};
+
+// Decodes directory/path on the calling thread. Makes no gl calls, so it is
+// safe to call from worker threads. pixels is null on failure.
+ImageData DecodeImage(const char *path, const std::string &directory);
+
+#endif // ISLAND_UTILS_TEXTURE_H_
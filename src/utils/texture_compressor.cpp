@@ -0,0 +1,251 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "texture_compressor.h"
+
+namespace {
+
+struct RgbaLevel {
+    int width;
+    int height;
+    std::vector<unsigned char> texels; // 4 bytes per texel
+};
+
+// ----------- MIP CHAIN ----------- //
+RgbaLevel ToRgba(const ImageData &image) {
+    RgbaLevel level{ image.width, image.height, std::vector<unsigned char>(size_t(image.width) * image.height * 4) };
+    const unsigned char *src = image.pixels.get();
+    for (size_t i = 0; i < size_t(image.width) * image.height; i++) {
+        for (int c = 0; c < 4; c++)
+            level.texels[i * 4 + c] = c < image.components ? src[i * image.components + c] : 255;
+    }
+    return level;
+}
+
+// 2x2 box filter; odd edges reuse the last row/column
+RgbaLevel Downsample(const RgbaLevel &src) {
+    RgbaLevel dst{ std::max(1, src.width / 2), std::max(1, src.height / 2), {} };
+    dst.texels.resize(size_t(dst.width) * dst.height * 4);
+    for (int y = 0; y < dst.height; y++) {
+        int y0 = std::min(2 * y, src.height - 1), y1 = std::min(2 * y + 1, src.height - 1);
+        for (int x = 0; x < dst.width; x++) {
+            int x0 = std::min(2 * x, src.width - 1), x1 = std::min(2 * x + 1, src.width - 1);
+            for (int c = 0; c < 4; c++) {
+                int sum = src.texels[(size_t(y0) * src.width + x0) * 4 + c] + src.texels[(size_t(y0) * src.width + x1) * 4 + c] +
+                          src.texels[(size_t(y1) * src.width + x0) * 4 + c] + src.texels[(size_t(y1) * src.width + x1) * 4 + c];
+                dst.texels[(size_t(y) * dst.width + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+            }
+        }
+    }
+    return dst;
+}
+
+// gathers a 4x4 block, clamping reads at the level edges
+void FetchBlock(const RgbaLevel &level, int block_x, int block_y, unsigned char block[16][4]) {
+    for (int j = 0; j < 4; j++) {
+        int y = std::min(block_y * 4 + j, level.height - 1);
+        for (int i = 0; i < 4; i++) {
+            int x = std::min(block_x * 4 + i, level.width - 1);
+            std::memcpy(block[j * 4 + i], &level.texels[(size_t(y) * level.width + x) * 4], 4);
+        }
+    }
+}
+
+// ----------- BC1 ----------- //
+uint16_t PackRgb565(const float color[3]) {
+    int r = static_cast<int>(std::lround(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f));
+    int g = static_cast<int>(std::lround(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f));
+    int b = static_cast<int>(std::lround(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f));
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+void UnpackRgb565(uint16_t packed, int color[3]) {
+    int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+/*
+    Endpoints are the extremes of the block's colors along their principal
+    axis (covariance matrix, power iteration), which follows the actual color
+    distribution better than the bounding box diagonal.
+*/
+void EncodeBC1Block(const unsigned char block[16][4], unsigned char *out) {
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++)
+            mean[c] += block[i][c] / 16.0f;
+
+    float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f }; // rr rg rb gg gb bb
+    for (int i = 0; i < 16; i++) {
+        float r = block[i][0] - mean[0], g = block[i][1] - mean[1], b = block[i][2] - mean[2];
+        cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+        cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+    }
+    float axis[3] = { 1.0f, 1.0f, 1.0f };
+    for (int iteration = 0; iteration < 4; iteration++) {
+        float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+        float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+        float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+        float largest = std::max(std::fabs(x), std::max(std::fabs(y), std::fabs(z)));
+        if (largest < 1e-6f)
+            break; // flat block, any axis works
+        axis[0] = x / largest; axis[1] = y / largest; axis[2] = z / largest;
+    }
+    float length_sq = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+
+    float min_t = 0.0f, max_t = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        float t = ((block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2]) / length_sq;
+        min_t = std::min(min_t, t);
+        max_t = std::max(max_t, t);
+    }
+    float end0[3], end1[3];
+    for (int c = 0; c < 3; c++) {
+        end0[c] = mean[c] + axis[c] * max_t;
+        end1[c] = mean[c] + axis[c] * min_t;
+    }
+    uint16_t color0 = PackRgb565(end0), color1 = PackRgb565(end1);
+    // color0 > color1 selects the 4 color (no transparency) mode
+    if (color0 < color1)
+        std::swap(color0, color1);
+
+    uint32_t indices = 0;
+    if (color0 != color1) {
+        int palette[4][3];
+        UnpackRgb565(color0, palette[0]);
+        UnpackRgb565(color1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; i++) {
+            int best = 0, best_dist = INT32_MAX;
+            for (int p = 0; p < 4; p++) {
+                int dr = block[i][0] - palette[p][0], dg = block[i][1] - palette[p][1], db = block[i][2] - palette[p][2];
+                int dist = dr * dr + dg * dg + db * db;
+                if (dist < best_dist) {
+                    best_dist = dist;
+                    best = p;
+                }
+            }
+            indices |= uint32_t(best) << (2 * i);
+        }
+    }
+    out[0] = color0 & 0xff; out[1] = color0 >> 8;
+    out[2] = color1 & 0xff; out[3] = color1 >> 8;
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+// ----------- BC4 (bc3 alpha, bc5 channels) ----------- //
+/*
+    Single channel block with endpoints at the channel's min and max, using the
+    8 value interpolation mode.
+*/
+void EncodeBC4Block(const unsigned char block[16][4], int channel, unsigned char *out) {
+    int high = 0, low = 255;
+    for (int i = 0; i < 16; i++) {
+        high = std::max(high, int(block[i][channel]));
+        low = std::min(low, int(block[i][channel]));
+    }
+    uint64_t indices = 0;
+    if (high != low) {
+        int palette[8] = { high, low };
+        for (int k = 2; k < 8; k++)
+            palette[k] = ((8 - k) * high + (k - 1) * low) / 7;
+        for (int i = 0; i < 16; i++) {
+            int best = 0, best_dist = 256;
+            for (int p = 0; p < 8; p++) {
+                int dist = std::abs(block[i][channel] - palette[p]);
+                if (dist < best_dist) {
+                    best_dist = dist;
+                    best = p;
+                }
+            }
+            indices |= uint64_t(best) << (3 * i);
+        }
+    }
+    out[0] = static_cast<unsigned char>(high);
+    out[1] = static_cast<unsigned char>(low);
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+void EncodeBlock(const unsigned char block[16][4], eBlockFormat format, unsigned char *out) {
+    switch (format) {
+    case BLOCK_FORMAT_BC1:
+        EncodeBC1Block(block, out);
+        break;
+    case BLOCK_FORMAT_BC3:
+        EncodeBC4Block(block, 3, out);
+        EncodeBC1Block(block, out + 8);
+        break;
+    case BLOCK_FORMAT_BC5:
+        EncodeBC4Block(block, 0, out);
+        EncodeBC4Block(block, 1, out + 8);
+        break;
+    }
+}
+
+} // namespace
+
+size_t CompressedImage::GetSize() const {
+    size_t size = 0;
+    for (const CompressedLevel &level : levels)
+        size += level.data.size();
+    return size;
+}
+
+size_t GetBlockSize(eBlockFormat format) {
+    return format == BLOCK_FORMAT_BC1 ? 8 : 16;
+}
+
+eBlockFormat ChooseBlockFormat(const ImageData &image, eTextureUsage usage) {
+    if (usage == TEXTURE_USAGE_TWO_CHANNEL)
+        return BLOCK_FORMAT_BC5;
+    if (image.components == 4) {
+        const unsigned char *pixels = image.pixels.get();
+        for (size_t i = 0; i < size_t(image.width) * image.height; i++) {
+            if (pixels[i * 4 + 3] != 255)
+                return BLOCK_FORMAT_BC3;
+        }
+    }
+    return BLOCK_FORMAT_BC1;
+}
+
+/*
+    Downsample the whole chain, then encode it block by block. Serial: this
+    runs on a texture streamer worker, and the streamer already keeps every
+    core busy with one image each, so a parallel encode would only
+    oversubscribe them.
+*/
+CompressedImage CompressImage(const ImageData &image, eBlockFormat format) {
+    std::vector<RgbaLevel> rgba_levels;
+    rgba_levels.push_back(ToRgba(image));
+    while (rgba_levels.back().width > 1 || rgba_levels.back().height > 1)
+        rgba_levels.push_back(Downsample(rgba_levels.back()));
+
+    CompressedImage compressed;
+    compressed.format = format;
+    compressed.width = image.width;
+    compressed.height = image.height;
+    size_t block_size = GetBlockSize(format);
+
+    unsigned char block[16][4];
+    for (const RgbaLevel &rgba : rgba_levels) {
+        int blocks_x = (rgba.width + 3) / 4, blocks_y = (rgba.height + 3) / 4;
+        compressed.levels.push_back(CompressedLevel{ rgba.width, rgba.height, std::vector<unsigned char>(size_t(blocks_x) * blocks_y * block_size) });
+        CompressedLevel &level = compressed.levels.back();
+        for (int block_y = 0; block_y < blocks_y; block_y++) {
+            for (int block_x = 0; block_x < blocks_x; block_x++) {
+                FetchBlock(rgba, block_x, block_y, block);
+                EncodeBlock(block, format, &level.data[(size_t(block_y) * blocks_x + block_x) * block_size]);
+            }
+        }
+    }
+    return compressed;
+}
@@ -0,0 +1,42 @@
+#ifndef ISLAND_UTILS_TEXTURE_COMPRESSOR_H_
+#define ISLAND_UTILS_TEXTURE_COMPRESSOR_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "texture.h"
+
+// gpu block compression formats, 4x4 texel blocks
+enum eBlockFormat {
+    BLOCK_FORMAT_BC1, // rgb, 8 bytes per block
+    BLOCK_FORMAT_BC3, // rgba (bc1 color + interpolated alpha), 16 bytes per block
+    BLOCK_FORMAT_BC5  // two independent channels (rg), 16 bytes per block
+};
+
+struct CompressedLevel {
+    int width;
+    int height;
+    std::vector<unsigned char> data;
+};
+
+// a block compressed image with its full mip chain, base level first
+struct CompressedImage {
+    eBlockFormat format;
+    int width = 0;
+    int height = 0;
+    std::vector<CompressedLevel> levels;
+
+    size_t GetSize() const;
+};
+
+size_t GetBlockSize(eBlockFormat format);
+
+// Picks the format for an image of the given usage: bc5 for two channel data,
+// otherwise bc3 if any texel is not fully opaque and bc1 if none is.
+eBlockFormat ChooseBlockFormat(const ImageData &image, eTextureUsage usage);
+
+// Builds the full mip chain (2x2 box filter) and encodes every level on the
+// calling thread. image must have 3 or 4 components.
+CompressedImage CompressImage(const ImageData &image, eBlockFormat format);
+
+#endif // ISLAND_UTILS_TEXTURE_COMPRESSOR_H_
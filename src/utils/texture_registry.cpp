@@ -0,0 +1,149 @@
+#include <glad/glad.h>
+
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+
+#include "gl_state.h"
+#include "texture_registry.h"
+#include "texture_streamer.h"
+
+TextureRegistry g_texture_registry;
+
+// ----------- TEXTURE HANDLE ----------- //
+TextureHandle::TextureHandle() : id(0) {}
+
+TextureHandle::TextureHandle(unsigned int id) : id(id) {}
+
+TextureHandle::TextureHandle(const TextureHandle &other) : id(other.id) {
+    if (id != 0)
+        g_texture_registry.AddRef(id);
+}
+
+TextureHandle::TextureHandle(TextureHandle &&other) noexcept : id(other.id) {
+    other.id = 0;
+}
+
+TextureHandle &TextureHandle::operator=(TextureHandle other) {
+    std::swap(id, other.id);
+    return *this;
+}
+
+TextureHandle::~TextureHandle() {
+    if (id != 0)
+        g_texture_registry.Release(id);
+}
+
+unsigned int TextureHandle::GetId() const {
+    return id;
+}
+
+// ----------- PUBLIC ----------- //
+TextureRegistry::TextureRegistry() : misses(0), released_hits(0), released_bytes_saved(0), shut_down(false) {}
+
+/*
+    Look the canonical path up and hand out another reference on a hit. On a
+    miss the texture is requested from the streamer, which reports its size
+    back once uploaded so hits can be converted into bytes saved.
+*/
+TextureHandle TextureRegistry::Acquire(const char *path, const std::string &directory, eTextureUsage usage) {
+    std::string key = CanonicalPath(path, directory);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = ids_by_path.find(key);
+    if (found != ids_by_path.end()) {
+        Entry &entry = entries[found->second];
+        entry.ref_count++;
+        entry.hits++;
+        return TextureHandle(found->second);
+    }
+
+    if (misses == 0) {
+        g_texture_streamer.SetUploadCallback([this](unsigned int id, size_t bytes) {
+            OnUploaded(id, bytes);
+        });
+    }
+    misses++;
+    unsigned int id = g_texture_streamer.Request(path, directory, usage);
+    ids_by_path[key] = id;
+    entries[id] = Entry{ key, 1, 0, 0 };
+    return TextureHandle(id);
+}
+
+TextureRegistryStats TextureRegistry::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    TextureRegistryStats stats = { released_hits, misses, released_bytes_saved, static_cast<unsigned int>(entries.size()) };
+    for (const auto &pair : entries) {
+        stats.hits += pair.second.hits;
+        stats.bytes_saved += pair.second.hits * pair.second.bytes;
+    }
+    return stats;
+}
+
+void TextureRegistry::PrintStats() const {
+    TextureRegistryStats stats = GetStats();
+    std::cout << "TEXTURE_REGISTRY:: " << stats.hits << " hits, " << stats.misses << " misses, "
+              << stats.bytes_saved / 1024 << " KiB saved, " << stats.live_textures << " live textures" << std::endl;
+}
+
+void TextureRegistry::Shutdown() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto &pair : entries) {
+        unsigned int id = pair.first;
+        g_gl_state.DeleteTexture(id);
+    }
+    entries.clear();
+    ids_by_path.clear();
+    shut_down = true;
+}
+
+// ----------- PRIVATE ----------- //
+void TextureRegistry::AddRef(unsigned int id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = entries.find(id);
+    if (found != entries.end())
+        found->second.ref_count++;
+}
+
+/*
+    Drop a reference, deleting the texture with the last one. Must run on the 
+    gl thread. A load still pending in the streamer is cancelled first, so
+    it never uploads into the deleted id (or a texture that reuses it).
+*/
+void TextureRegistry::Release(unsigned int id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (shut_down)
+        return;
+    auto found = entries.find(id);
+    if (found == entries.end() || --found->second.ref_count > 0)
+        return;
+    released_hits += found->second.hits;
+    released_bytes_saved += found->second.hits * found->second.bytes;
+    ids_by_path.erase(found->second.path);
+    entries.erase(found);
+    g_texture_streamer.Cancel(id);
+    g_gl_state.DeleteTexture(id);
+}
+
+/*
+    Record the gpu size of a texture once its image is in place. 
+*/
+void TextureRegistry::OnUploaded(unsigned int id, size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = entries.find(id);
+    if (found != entries.end())
+        found->second.bytes = bytes;
+}
+
+/*
+    Absolute path with symlinks and ./.. resolved, so "a/../b.png" and "b.png"
+    from different model directories map to the same texture. Falls back to 
+    the joined path if the file does not exist (the load will report it).
+*/
+std::string TextureRegistry::CanonicalPath(const char *path, const std::string &directory) {
+    std::string joined = directory + '/' + std::string(path);
+    char resolved[PATH_MAX];
+    if (realpath(joined.c_str(), resolved) != nullptr)
+        return std::string(resolved);
+    return joined;
+}
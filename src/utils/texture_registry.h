@@ -0,0 +1,87 @@
+#ifndef ISLAND_UTILS_TEXTURE_REGISTRY_H_
+#define ISLAND_UTILS_TEXTURE_REGISTRY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "texture.h"
+
+// Reference to a registry texture. Copies share the reference count; the gl
+// texture is deleted when the last handle goes away.
+class TextureHandle {
+public:
+    TextureHandle();
+    TextureHandle(const TextureHandle &other);
+    TextureHandle(TextureHandle &&other) noexcept;
+    TextureHandle &operator=(TextureHandle other);
+    ~TextureHandle();
+
+    unsigned int GetId() const;
+
+private:
+    friend class TextureRegistry;
+    explicit TextureHandle(unsigned int id); // adopts an already counted reference
+
+    unsigned int id;
+};
+
+struct TextureRegistryStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t bytes_saved; // gpu bytes (incl. mipmaps) not uploaded thanks to hits
+    unsigned int live_textures;
+};
+
+/*
+    Process-wide texture cache keyed by canonical absolute path, so every
+    model (and the standalone water maps) share one gl texture per image
+    file. Textures are loaded through g_texture_streamer. A miss creates the
+    texture and the last released handle deletes it, so Acquire() and
+    handle copies and destruction are gl thread only; GetStats() and
+    PrintStats() can be called from any thread.
+*/
+class TextureRegistry {
+public:
+    TextureRegistry();
+
+    // Returns the texture for directory/path, requesting it on first use.
+    // usage only matters for that first request. gl thread only.
+    TextureHandle Acquire(const char *path, const std::string &directory, eTextureUsage usage = TEXTURE_USAGE_COLOR);
+
+    TextureRegistryStats GetStats() const;
+    void PrintStats() const;
+
+    // Deletes every texture. Handles released afterwards are ignored. Call before the gl context is destroyed.
+    void Shutdown();
+
+private:
+    friend class TextureHandle;
+
+    struct Entry {
+        std::string path;
+        unsigned int ref_count;
+        uint64_t hits;
+        size_t bytes; // 0 until the streamer has uploaded the image
+    };
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, unsigned int> ids_by_path;
+    std::unordered_map<unsigned int, Entry> entries;
+    uint64_t misses;
+    uint64_t released_hits;        // stats of textures already deleted
+    uint64_t released_bytes_saved;
+    bool shut_down;
+
+    void AddRef(unsigned int id);
+    void Release(unsigned int id);
+    void OnUploaded(unsigned int id, size_t bytes);
+
+    static std::string CanonicalPath(const char *path, const std::string &directory);
+};
+
+extern TextureRegistry g_texture_registry;
+
+#endif // ISLAND_UTILS_TEXTURE_REGISTRY_H_
@@ -0,0 +1,348 @@
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "gl_state.h"
+#include "hash.h"
+#include "ktx2.h"
+#include "texture_streamer.h"
+
+TextureStreamer g_texture_streamer;
+
+namespace {
+
+// bump when the encoder output changes, part of the ktx2 cache key
+const uint64_t kCompressorVersion = 1;
+
+// S3TC formats are an extension, so not in the core glad header
+const GLenum kCompressedRgbS3tcDxt1 = 0x83F0;
+const GLenum kCompressedRgbaS3tcDxt5 = 0x83F3;
+
+// mid grey: neutral as a diffuse color, zero distortion as a dudv map, and an
+// up-facing normal with the water shader's normal map decoding
+const unsigned char kPlaceholderPixel[4] = { 128, 128, 128, 255 };
+
+GLenum FormatFromComponents(int components) {
+    if (components == 1)
+        return GL_RED;
+    else if (components == 3)
+        return GL_RGB;
+    else if (components == 4)
+        return GL_RGBA;
+    return GL_NONE;
+}
+
+GLenum InternalFormatFromBlockFormat(eBlockFormat format) {
+    switch (format) {
+    case BLOCK_FORMAT_BC1: return kCompressedRgbS3tcDxt1;
+    case BLOCK_FORMAT_BC3: return kCompressedRgbaS3tcDxt5;
+    case BLOCK_FORMAT_BC5: return GL_COMPRESSED_RG_RGTC2;
+    }
+    return GL_NONE;
+}
+
+bool HasExtension(const char *name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+        const char *extension = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+        if (extension != nullptr && std::strcmp(extension, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+} // namespace
+
+// ----------- PUBLIC ----------- //
+TextureStreamer::TextureStreamer() : next_ticket(1), stopping(false), next_pixel_buffer(0), supports_s3tc(false) {
+    std::fill(pixel_buffers, pixel_buffers + kNumPixelBuffers, 0u);
+}
+
+TextureStreamer::~TextureStreamer() {
+    // no gl calls here - the context is long gone by static destruction
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    job_available.notify_all();
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+/*
+    Create the texture with a 1x1 placeholder image and queue the file for
+    decoding. The id stays valid; only its image storage is replaced later.
+*/
+unsigned int TextureStreamer::Request(const char *path, const std::string &directory, eTextureUsage usage) {
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    g_gl_state.BindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, kPlaceholderPixel);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    if (workers.empty())
+        StartWorkers();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        bool compress = usage == TEXTURE_USAGE_TWO_CHANNEL || supports_s3tc;
+        uint64_t ticket = next_ticket++;
+        tickets[texture] = ticket;
+        jobs.push_back(DecodeJob{ texture, ticket, path, directory, usage, compress });
+    }
+    job_available.notify_one();
+    return texture;
+}
+
+/*
+    Forget the texture's ticket and drop its queued job or decoded image. A
+    decode already running on a worker finishes, but its image no longer
+    matches a ticket, so Update() discards it - even if gl has given the
+    id to a new texture in the meantime.
+*/
+void TextureStreamer::Cancel(unsigned int texture) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = tickets.find(texture);
+    if (found == tickets.end())
+        return;
+    uint64_t ticket = found->second;
+    tickets.erase(found);
+    jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [ticket](const DecodeJob &job) { return job.ticket == ticket; }), jobs.end());
+    decoded.erase(std::remove_if(decoded.begin(), decoded.end(), [ticket](const DecodedImage &image) { return image.ticket == ticket; }),
+                  decoded.end());
+}
+
+/*
+    Stream decoded images into their textures. Each frame gets a byte budget
+    so a burst of large images is spread over several frames instead of
+    hitching one.
+*/
+unsigned int TextureStreamer::Update(size_t max_bytes) {
+    unsigned int completed = 0;
+    size_t streamed = 0;
+    while (completed == 0 || streamed < max_bytes) {
+        DecodedImage decoded_image;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (decoded.empty())
+                break;
+            decoded_image = std::move(decoded.front());
+            decoded.pop_front();
+            auto found = tickets.find(decoded_image.texture);
+            if (found == tickets.end() || found->second != decoded_image.ticket)
+                continue; // cancelled while decoding
+            tickets.erase(found);
+        }
+        size_t size = decoded_image.GetSize();
+        if (StreamImage(decoded_image) && upload_callback)
+            upload_callback(decoded_image.texture, size);
+        streamed += size;
+        completed++;
+    }
+    return completed;
+}
+
+void TextureStreamer::SetUploadCallback(std::function<void(unsigned int, size_t)> callback) {
+    upload_callback = callback;
+}
+
+/*
+    Join the workers (dropping queued work) and free the pixel buffers.
+*/
+void TextureStreamer::Shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        jobs.clear();
+        tickets.clear();
+    }
+    job_available.notify_all();
+    for (std::thread &worker : workers)
+        worker.join();
+    workers.clear();
+    decoded.clear();
+
+    if (pixel_buffers[0] != 0) {
+        glDeleteBuffers(kNumPixelBuffers, pixel_buffers);
+        std::fill(pixel_buffers, pixel_buffers + kNumPixelBuffers, 0u);
+    }
+}
+
+// ----------- PRIVATE ----------- //
+/*
+    Leave one core for the render thread. Also the first point where a gl
+    context is known to be current, so driver capabilities are queried here.
+*/
+void TextureStreamer::StartWorkers() {
+    supports_s3tc = HasExtension("GL_EXT_texture_compression_s3tc");
+    unsigned int num_workers = std::max(1u, std::thread::hardware_concurrency() - 1);
+    for (unsigned int i = 0; i < num_workers; i++)
+        workers.emplace_back(&TextureStreamer::WorkerLoop, this);
+}
+
+void TextureStreamer::WorkerLoop() {
+    while (true) {
+        DecodeJob job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            job_available.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (stopping)
+                return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        DecodedImage decoded_image = Decode(job);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            decoded.push_back(std::move(decoded_image));
+        }
+    }
+}
+
+/*
+    Load the block compressed version of an image from its ktx2 file, or
+    encode and write it if the file is missing or older than the source.
+    Images that cannot be compressed are returned decoded. An unchanged
+    stamp (size and modification time) is trusted as is; the source is only
+    hashed when it differs, e.g. after a fresh checkout, and a cache whose
+    hash still matches is restamped so the next start skips that too.
+*/
+TextureStreamer::DecodedImage TextureStreamer::Decode(const DecodeJob &job) {
+    DecodedImage decoded_image;
+    decoded_image.texture = job.texture;
+    decoded_image.ticket = job.ticket;
+    decoded_image.path = job.path;
+
+    std::string filename = job.directory + '/' + job.path;
+    std::string ktx2_path = filename + ".ktx2";
+    uint64_t seed = (kCompressorVersion << 8) | job.usage;
+    Ktx2Source source = { 0, job.compress ? StampFile(filename, seed) : 0 };
+    if (source.stamp != 0) {
+        Ktx2Source cached;
+        if (ReadKtx2(ktx2_path, decoded_image.compressed, cached)) {
+            if (cached.stamp == source.stamp)
+                return decoded_image;
+            source.hash = HashFile(filename, seed);
+            if (source.hash != 0 && cached.hash == source.hash) {
+                WriteKtx2(ktx2_path, decoded_image.compressed, source);
+                return decoded_image;
+            }
+        }
+        decoded_image.compressed = CompressedImage();
+    }
+
+    decoded_image.image = DecodeImage(job.path.c_str(), job.directory);
+    const ImageData &image = decoded_image.image;
+    if (source.stamp != 0 && image.pixels && image.components >= 3) {
+        if (source.hash == 0)
+            source.hash = HashFile(filename, seed);
+        decoded_image.compressed = CompressImage(image, ChooseBlockFormat(image, job.usage));
+        WriteKtx2(ktx2_path, decoded_image.compressed, source);
+        decoded_image.image = ImageData();
+    }
+    return decoded_image;
+}
+
+/*
+    Copy data into the next pixel buffer and leave it bound, so the following
+    texture upload sources from it. Alternating buffers lets the driver 
+    transfer one while the other is being filled; orphaning with glBufferData
+    avoids waiting on a transfer that is still in flight. Returns 0 (nothing
+    bound) if the buffer could not be mapped.
+*/
+unsigned int TextureStreamer::BeginPixelBufferUpload(const void *data, size_t size) {
+    if (pixel_buffers[0] == 0)
+        glGenBuffers(kNumPixelBuffers, pixel_buffers);
+    unsigned int pixel_buffer = pixel_buffers[next_pixel_buffer];
+    next_pixel_buffer = (next_pixel_buffer + 1) % kNumPixelBuffers;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffer);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    void *dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (dst == nullptr) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return 0;
+    }
+    std::memcpy(dst, data, size);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    return pixel_buffer;
+}
+
+/*
+    Replace the placeholder with the decoded image, generating its mipmaps.
+    Returns false if the image failed to decode.
+*/
+bool TextureStreamer::StreamImage(const DecodedImage &decoded_image) {
+    if (!decoded_image.compressed.levels.empty()) {
+        StreamCompressedImage(decoded_image);
+        return true;
+    }
+    const ImageData &image = decoded_image.image;
+    if (!image.pixels) {
+        std::cout << "Texture failed to load at path: " << decoded_image.path << std::endl;
+        return false;
+    }
+    GLenum format = FormatFromComponents(image.components);
+    size_t size = size_t(image.width) * image.height * image.components;
+
+    // rows of 1 and 3 component images are tightly packed
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    g_gl_state.BindTexture(GL_TEXTURE_2D, decoded_image.texture);
+    if (BeginPixelBufferUpload(image.pixels.get(), size) != 0) {
+        // with a pixel unpack buffer bound the data pointer is an offset into it
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, (void*)0);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    else // mapping failed, fall back to a client memory upload
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels.get());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    return true;
+}
+
+/*
+    Upload every prebaked mip level from one pixel buffer; no mipmaps are
+    generated at runtime.
+*/
+void TextureStreamer::StreamCompressedImage(const DecodedImage &decoded_image) {
+    const CompressedImage &compressed = decoded_image.compressed;
+    GLenum internal_format = InternalFormatFromBlockFormat(compressed.format);
+
+    std::vector<unsigned char> chain;
+    chain.reserve(compressed.GetSize());
+    for (const CompressedLevel &level : compressed.levels)
+        chain.insert(chain.end(), level.data.begin(), level.data.end());
+
+    g_gl_state.BindTexture(GL_TEXTURE_2D, decoded_image.texture);
+    bool from_pixel_buffer = BeginPixelBufferUpload(chain.data(), chain.size()) != 0;
+    size_t offset = 0;
+    for (size_t l = 0; l < compressed.levels.size(); l++) {
+        const CompressedLevel &level = compressed.levels[l];
+        const void *data = from_pixel_buffer ? (const void*)offset : (const void*)(chain.data() + offset);
+        glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(l), internal_format, level.width, level.height, 0, static_cast<GLsizei>(level.data.size()), data);
+        offset += level.data.size();
+    }
+    if (from_pixel_buffer)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(compressed.levels.size()) - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+}
+
+/*
+    Gpu footprint: the compressed chain, or the raw image plus the third a 
+    generated mip chain adds.
+*/
+size_t TextureStreamer::DecodedImage::GetSize() const {
+    if (!compressed.levels.empty())
+        return compressed.GetSize();
+    size_t size = size_t(image.width) * image.height * image.components;
+    return size + size / 3;
+}
@@ -0,0 +1,101 @@
+#ifndef ISLAND_UTILS_TEXTURE_STREAMER_H_
+#define ISLAND_UTILS_TEXTURE_STREAMER_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "texture.h"
+#include "texture_compressor.h"
+
+/*
+    Asynchronous texture loading. Request() returns a texture id right away
+    with a 1x1 placeholder bound; the file is decoded on a worker thread and
+    Update() (gl thread, once per frame) streams the pixels into the same
+    texture through pixel buffer objects.
+
+    Where the driver supports it, images are block compressed (bc1/bc3/bc5)
+    with a prebaked mip chain. The result is cached next to the source as
+    <image>.ktx2, so only the first run pays for the encode.
+*/
+class TextureStreamer {
+public:
+    TextureStreamer();
+    ~TextureStreamer();
+
+    // Returns a placeholder texture id that receives directory/path once decoded. gl thread only.
+    unsigned int Request(const char *path, const std::string &directory, eTextureUsage usage = TEXTURE_USAGE_COLOR);
+
+    // Drops the pending load of texture, so it can be deleted right away; its image is never uploaded.
+    // No-op if it was already uploaded. gl thread only.
+    void Cancel(unsigned int texture);
+
+    // Uploads decoded images, stopping once max_bytes have been streamed this
+    // call (at least one image is always uploaded). Returns the number of
+    // textures completed. gl thread only.
+    unsigned int Update(size_t max_bytes = kDefaultUploadBudget);
+
+    // Called on the gl thread after each texture upload with the texture id and its gpu size in bytes (incl. mipmaps).
+    void SetUploadCallback(std::function<void(unsigned int, size_t)> callback);
+
+    // Stops the workers and frees the pixel buffers. Call before the gl context is destroyed.
+    void Shutdown();
+
+    static const size_t kDefaultUploadBudget = 16 * 1024 * 1024;
+
+private:
+    struct DecodeJob {
+        unsigned int texture;
+        uint64_t ticket; // tells requests apart when gl reuses a deleted texture's id
+        std::string path;
+        std::string directory;
+        eTextureUsage usage;
+        bool compress;
+    };
+    struct DecodedImage {
+        unsigned int texture;
+        uint64_t ticket;
+        std::string path;
+        ImageData image;            // uncompressed, or
+        CompressedImage compressed; // block compressed when levels is not empty
+
+        size_t GetSize() const;
+    };
+
+    static const unsigned int kNumPixelBuffers = 2;
+
+    std::vector<std::thread> workers;
+    mutable std::mutex mutex;
+    std::condition_variable job_available;
+    std::deque<DecodeJob> jobs;
+    std::deque<DecodedImage> decoded;
+    // ticket of each texture still to be uploaded; images of other tickets were cancelled
+    std::unordered_map<unsigned int, uint64_t> tickets;
+    uint64_t next_ticket;
+    bool stopping;
+
+    unsigned int pixel_buffers[kNumPixelBuffers];
+    unsigned int next_pixel_buffer;
+
+    bool supports_s3tc; // bc1/bc3 need GL_EXT_texture_compression_s3tc, bc5 (rgtc) is core
+
+    std::function<void(unsigned int, size_t)> upload_callback;
+
+    void StartWorkers();
+    void WorkerLoop();
+    DecodedImage Decode(const DecodeJob &job);
+    unsigned int BeginPixelBufferUpload(const void *data, size_t size);
+    bool StreamImage(const DecodedImage &decoded_image);
+    void StreamCompressedImage(const DecodedImage &decoded_image);
+};
+
+extern TextureStreamer g_texture_streamer;
+
+#endif // ISLAND_UTILS_TEXTURE_STREAMER_H_
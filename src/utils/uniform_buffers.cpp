@@ -0,0 +1,94 @@
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstring>
+
+#include "uniform_buffers.h"
+
+const char *const kUniformBlockNames[NUM_UNIFORM_BLOCKS] = { "Camera", "Lighting", "WaterCameras" };
+const size_t kUniformBlockSizes[NUM_UNIFORM_BLOCKS] = { sizeof(CameraBlock), sizeof(LightingBlock), sizeof(WaterCamerasBlock) };
+
+// ----------- PUBLIC ----------- //
+/*
+    Create the buffers at their full size and bind the lighting and water
+    camera buffers to their binding points for good.
+*/
+UniformBuffers::UniformBuffers() : lighting_data(), water_cameras_data() {
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if (alignment < 1)
+        alignment = 1;
+    camera_stride = (sizeof(CameraBlock) + alignment - 1) / alignment * alignment;
+    camera_data.assign(camera_stride * NUM_CAMERA_VIEWS, 0);
+
+    glGenBuffers(1, &camera_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, camera_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, camera_data.size(), nullptr, GL_STREAM_DRAW);
+
+    glGenBuffers(1, &lighting_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, lighting_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(LightingBlock), nullptr, GL_STREAM_DRAW);
+
+    glGenBuffers(1, &water_cameras_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, water_cameras_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(WaterCamerasBlock), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, UNIFORM_BLOCK_LIGHTING, lighting_buffer);
+    glBindBufferBase(GL_UNIFORM_BUFFER, UNIFORM_BLOCK_WATER_CAMERAS, water_cameras_buffer);
+    glBindBufferRange(GL_UNIFORM_BUFFER, UNIFORM_BLOCK_CAMERA, camera_buffer, 0, sizeof(CameraBlock));
+}
+
+/*
+    Free the buffers.
+*/
+void UniformBuffers::CleanUp() {
+    glDeleteBuffers(1, &camera_buffer);
+    glDeleteBuffers(1, &lighting_buffer);
+    glDeleteBuffers(1, &water_cameras_buffer);
+}
+
+/*
+    Stage the camera of one view; sent with the next Upload().
+*/
+void UniformBuffers::SetCamera(eCameraView view, const glm::mat4 &view_matrix, const glm::mat4 &projection,
+                               const glm::vec3 &position, const glm::vec4 &clip_plane) {
+    CameraBlock camera;
+    camera.view = view_matrix;
+    camera.projection = projection;
+    camera.position = position;
+    camera.padding = 0.0f;
+    camera.clip_plane = clip_plane;
+    std::memcpy(&camera_data[view * camera_stride], &camera, sizeof(CameraBlock));
+}
+
+/*
+    Stage the scene lighting; sent with the next Upload().
+*/
+void UniformBuffers::SetLighting(const LightingBlock &lighting) {
+    lighting_data = lighting;
+}
+
+/*
+    Send the staged state, one call per buffer. Passing the data to
+    glBufferData lets the driver orphan last frame's storage instead of
+    waiting for draws that still read it.
+*/
+void UniformBuffers::Upload() {
+    glBindBuffer(GL_UNIFORM_BUFFER, camera_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, camera_data.size(), camera_data.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, lighting_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(LightingBlock), &lighting_data, GL_STREAM_DRAW);
+    std::memcpy(&water_cameras_data.cameras[WATER_LAYER_REFLECTION], &camera_data[CAMERA_VIEW_REFLECTION * camera_stride], sizeof(CameraBlock));
+    std::memcpy(&water_cameras_data.cameras[WATER_LAYER_REFRACTION], &camera_data[CAMERA_VIEW_REFRACTION * camera_stride], sizeof(CameraBlock));
+    glBindBuffer(GL_UNIFORM_BUFFER, water_cameras_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(WaterCamerasBlock), &water_cameras_data, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/*
+    Point the camera block of every program at view.
+*/
+void UniformBuffers::BindCamera(eCameraView view) {
+    glBindBufferRange(GL_UNIFORM_BUFFER, UNIFORM_BLOCK_CAMERA, camera_buffer, view * camera_stride, sizeof(CameraBlock));
+}
@@ -0,0 +1,158 @@
+#ifndef ISLAND_UTILS_UNIFORM_BUFFERS_H_
+#define ISLAND_UTILS_UNIFORM_BUFFERS_H_
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+    Per-frame state every program reads lives in std140 uniform blocks
+    instead of per-program uniforms:
+        Camera        view, projection, camera position and clip plane of a view
+        Lighting      directional, point and spot lights
+        WaterCameras  the reflection and refraction cameras side by side, for
+                      layered passes that draw both water views at once
+    Each block has a fixed binding point (eUniformBlock) that Shader wires up
+    after linking, so any program declaring a block reads the same buffer.
+    The structs below mirror the std140 layout of the blocks in the shaders
+    byte for byte; a vec3 takes 16 bytes unless a float follows it.
+*/
+
+// binding points, shared by all programs
+enum eUniformBlock {
+    UNIFORM_BLOCK_CAMERA,
+    UNIFORM_BLOCK_LIGHTING,
+    UNIFORM_BLOCK_WATER_CAMERAS,
+    NUM_UNIFORM_BLOCKS
+};
+
+// block names as declared in the shaders, indexed by eUniformBlock
+extern const char *const kUniformBlockNames[NUM_UNIFORM_BLOCKS];
+// size of each block's struct, indexed by eUniformBlock
+extern const size_t kUniformBlockSizes[NUM_UNIFORM_BLOCKS];
+
+// views rendered each frame, each with its own range of the camera buffer
+enum eCameraView {
+    CAMERA_VIEW_MAIN,
+    CAMERA_VIEW_REFLECTION,
+    CAMERA_VIEW_REFRACTION,
+    NUM_CAMERA_VIEWS
+};
+
+// layers of the layered water target, indexed by gl_Layer; each draws the camera view beside it
+enum eWaterLayer {
+    WATER_LAYER_REFLECTION, // CAMERA_VIEW_REFLECTION
+    WATER_LAYER_REFRACTION, // CAMERA_VIEW_REFRACTION
+    NUM_WATER_LAYERS
+};
+
+// must match NR_POINT_LIGHTS and NR_SPOT_LIGHTS in the lit shaders
+const size_t kMaxPointLights = 1;
+const size_t kMaxSpotLights = 1;
+
+// ----------- STD140 BLOCKS ----------- //
+struct CameraBlock {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 position;
+    float padding;
+    glm::vec4 clip_plane;
+};
+
+struct DirectionalLightBlock {
+    glm::vec3 direction;
+    float padding0;
+    glm::vec3 ambient;
+    float padding1;
+    glm::vec3 diffuse;
+    float padding2;
+    glm::vec3 specular;
+    float padding3;
+};
+
+struct PointLightBlock {
+    glm::vec3 position;
+    float padding0;
+    glm::vec3 ambient;
+    float padding1;
+    glm::vec3 diffuse;
+    float padding2;
+    glm::vec3 specular;
+    float constant;
+    float linear;
+    float quadratic;
+    float padding3[2];
+};
+
+struct SpotLightBlock {
+    glm::vec3 position;
+    float padding0;
+    glm::vec3 direction;
+    float padding1;
+    glm::vec3 ambient;
+    float padding2;
+    glm::vec3 diffuse;
+    float padding3;
+    glm::vec3 specular;
+    float constant;
+    float linear;
+    float quadratic;
+    float inner_cut_off;
+    float outer_cut_off;
+};
+
+struct LightingBlock {
+    DirectionalLightBlock directional_light;
+    PointLightBlock point_lights[kMaxPointLights];
+    SpotLightBlock spot_lights[kMaxSpotLights];
+    int32_t directional_only; // glsl bool
+    float padding[3];
+};
+
+struct WaterCamerasBlock {
+    CameraBlock cameras[NUM_WATER_LAYERS];
+};
+
+static_assert(sizeof(CameraBlock) == 160 && offsetof(CameraBlock, clip_plane) == 144, "CameraBlock must match std140");
+static_assert(sizeof(DirectionalLightBlock) == 64, "DirectionalLightBlock must match std140");
+static_assert(sizeof(PointLightBlock) == 80 && offsetof(PointLightBlock, constant) == 60, "PointLightBlock must match std140");
+static_assert(sizeof(SpotLightBlock) == 96 && offsetof(SpotLightBlock, constant) == 76, "SpotLightBlock must match std140");
+static_assert(sizeof(WaterCamerasBlock) == 160 * NUM_WATER_LAYERS, "WaterCamerasBlock must match std140");
+static_assert(offsetof(LightingBlock, directional_only) == 64 + 80 * kMaxPointLights + 96 * kMaxSpotLights, "LightingBlock must match std140");
+
+/*
+    Owns the camera and lighting uniform buffers. Callers fill in every view
+    and the lighting for the frame, Upload() sends each buffer with a single
+    call, and BindCamera() points the camera binding at one view's range
+    before that view's pass. Lighting and the water cameras (copied from the
+    reflection and refraction views) stay bound for the program's lifetime.
+*/
+class UniformBuffers {
+public:
+    UniformBuffers();
+
+    void CleanUp();
+
+    void SetCamera(eCameraView view, const glm::mat4 &view_matrix, const glm::mat4 &projection,
+                   const glm::vec3 &position, const glm::vec4 &clip_plane = glm::vec4(0.0f));
+    void SetLighting(const LightingBlock &lighting);
+
+    void Upload();
+
+    void BindCamera(eCameraView view);
+
+private:
+    unsigned int camera_buffer;
+    unsigned int lighting_buffer;
+    unsigned int water_cameras_buffer;
+
+    // views are GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT apart so each can be bound as a range
+    size_t camera_stride;
+    std::vector<unsigned char> camera_data;
+    LightingBlock lighting_data;
+    WaterCamerasBlock water_cameras_data;
+};
+
+#endif // ISLAND_UTILS_UNIFORM_BUFFERS_H_
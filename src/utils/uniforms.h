@@ -0,0 +1,40 @@
+#ifndef ISLAND_UTILS_UNIFORMS_H_
+#define ISLAND_UTILS_UNIFORMS_H_
+
+#include "shader.h"
+
+// ----------- UNIFORM IDS ----------- //
+// Names hashed at compile time, see UniformId. 
+
+// Transforms // 
+// view, projection, camera position and clip plane live in the Camera block (see uniform_buffers.h)
+constexpr UniformId kUniformModel("model");
+constexpr UniformId kUniformNormal("normal");
+
+// Material // 
+constexpr UniformId kUniformMaterialShininess("material.shininess");
+constexpr UniformId kUniformSpecularIntensity("specular_intenstiy");
+
+// Water // 
+constexpr UniformId kUniformReflectionTexture("reflection_texture");
+constexpr UniformId kUniformRefractionTexture("refraction_texture");
+constexpr UniformId kUniformRefractionDepthTexture("refraction_depth_texture");
+constexpr UniformId kUniformReflectionUvScale("reflection_uv_scale");
+constexpr UniformId kUniformRefractionUvScale("refraction_uv_scale");
+constexpr UniformId kUniformReflectionUvBounds("reflection_uv_bounds");
+constexpr UniformId kUniformRefractionUvBounds("refraction_uv_bounds");
+constexpr UniformId kUniformReflectionViewProjection("reflection_view_projection");
+constexpr UniformId kUniformRefractionViewProjection("refraction_view_projection");
+constexpr UniformId kUniformDudvMap("dudv_map");
+constexpr UniformId kUniformNormalMap("normal_map");
+constexpr UniformId kUniformSamplingOffset("sampling_offset");
+
+// Occlusion // 
+constexpr UniformId kUniformBoxCenter("box_center");
+constexpr UniformId kUniformBoxExtent("box_extent");
+
+// Debug // 
+constexpr UniformId kUniformTextureId("texture_id");
+constexpr UniformId kUniformAxisColor("axisColor");
+
+#endif // ISLAND_UTILS_UNIFORMS_H_
@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "mesh.h"
+#include "vertex_format.h"
+
+namespace {
+
+// element for member of layout T
+#define ELEMENT(T, location, size, type, normalized, member) \
+    VertexElement{ location, size, type, normalized, false, offsetof(T, member) }
+#define INTEGER_ELEMENT(T, location, size, type, member) \
+    VertexElement{ location, size, type, GL_FALSE, true, offsetof(T, member) }
+
+int16_t ToSnorm16(float value) {
+    return static_cast<int16_t>(std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f));
+}
+
+// IEEE half, rounded to nearest even; overflow goes to infinity and tiny values flush to zero
+uint16_t ToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    uint32_t exponent = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+    if (exponent == 0xff) // inf or nan
+        return sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0);
+    int half_exponent = static_cast<int>(exponent) - 127 + 15;
+    if (half_exponent >= 0x1f)
+        return sign | 0x7c00;
+    if (half_exponent <= 0) {
+        if (half_exponent < -10)
+            return sign;
+        // subnormal: shift the mantissa, with its implicit bit, into place
+        mantissa |= 0x800000;
+        int shift = 14 - half_exponent;
+        uint32_t half_mantissa = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half_mantissa & 1)))
+            half_mantissa++;
+        return sign | static_cast<uint16_t>(half_mantissa);
+    }
+    uint32_t half = (static_cast<uint32_t>(half_exponent) << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        half++; // may carry into the exponent, which rounds up to the next power of two (or infinity)
+    return sign | static_cast<uint16_t>(half);
+}
+
+void EncodeTexCoords(const glm::vec2 &tex_coords, uint16_t out[2]) {
+    out[0] = ToHalf(tex_coords.x);
+    out[1] = ToHalf(tex_coords.y);
+}
+
+void EncodeSkin(const Vertex &vertex, int16_t bone_ids[4], uint8_t weights[4]) {
+    for (int i = 0; i < 4; i++) {
+        bone_ids[i] = static_cast<int16_t>(std::min(std::max(vertex.m_BoneIDs[i], -1), 32767));
+        weights[i] = static_cast<uint8_t>(std::lround(std::min(std::max(vertex.m_Weights[i], 0.0f), 1.0f) * 255.0f));
+    }
+}
+
+template <typename T>
+std::vector<unsigned char> Encode(const Vertex *vertices, size_t count) {
+    std::vector<unsigned char> packed(count * sizeof(T));
+    for (size_t i = 0; i < count; i++) {
+        T vertex = T::Encode(vertices[i]);
+        std::memcpy(&packed[i * sizeof(T)], &vertex, sizeof(T));
+    }
+    return packed;
+}
+
+template <typename T>
+void Setup() {
+    for (size_t i = 0; i < T::kNumElements; i++) {
+        const VertexElement &element = T::kElements[i];
+        glEnableVertexAttribArray(element.location);
+        if (element.integer)
+            glVertexAttribIPointer(element.location, element.size, element.type, sizeof(T), (void*)element.offset);
+        else
+            glVertexAttribPointer(element.location, element.size, element.type, element.normalized, sizeof(T), (void*)element.offset);
+    }
+}
+
+} // namespace
+
+// ----------- LAYOUTS ----------- //
+const VertexElement PositionVertex::kElements[] = {
+    ELEMENT(PositionVertex, 0, 3, GL_FLOAT, GL_FALSE, position)
+};
+const size_t PositionVertex::kNumElements = sizeof(kElements) / sizeof(kElements[0]);
+
+PositionVertex PositionVertex::Encode(const Vertex &vertex) {
+    return PositionVertex{ vertex.Position };
+}
+
+const VertexElement CompactVertex::kElements[] = {
+    ELEMENT(CompactVertex, 0, 3, GL_FLOAT, GL_FALSE, position),
+    ELEMENT(CompactVertex, 1, 2, GL_SHORT, GL_TRUE, normal),
+    ELEMENT(CompactVertex, 2, 2, GL_HALF_FLOAT, GL_FALSE, tex_coords)
+};
+const size_t CompactVertex::kNumElements = sizeof(kElements) / sizeof(kElements[0]);
+
+CompactVertex CompactVertex::Encode(const Vertex &vertex) {
+    CompactVertex compact;
+    compact.position = vertex.Position;
+    EncodeOctahedral(vertex.Normal, compact.normal);
+    EncodeTexCoords(vertex.TexCoords, compact.tex_coords);
+    return compact;
+}
+
+const VertexElement CompactTangentVertex::kElements[] = {
+    ELEMENT(CompactTangentVertex, 0, 3, GL_FLOAT, GL_FALSE, position),
+    ELEMENT(CompactTangentVertex, 1, 2, GL_SHORT, GL_TRUE, normal),
+    ELEMENT(CompactTangentVertex, 2, 2, GL_HALF_FLOAT, GL_FALSE, tex_coords),
+    ELEMENT(CompactTangentVertex, 3, 2, GL_SHORT, GL_TRUE, tangent),
+    ELEMENT(CompactTangentVertex, 4, 2, GL_SHORT, GL_TRUE, bitangent)
+};
+const size_t CompactTangentVertex::kNumElements = sizeof(kElements) / sizeof(kElements[0]);
+
+CompactTangentVertex CompactTangentVertex::Encode(const Vertex &vertex) {
+    CompactTangentVertex compact;
+    compact.position = vertex.Position;
+    EncodeOctahedral(vertex.Normal, compact.normal);
+    EncodeTexCoords(vertex.TexCoords, compact.tex_coords);
+    EncodeOctahedral(vertex.Tangent, compact.tangent);
+    EncodeOctahedral(vertex.Bitangent, compact.bitangent);
+    return compact;
+}
+
+const VertexElement CompactSkinnedVertex::kElements[] = {
+    ELEMENT(CompactSkinnedVertex, 0, 3, GL_FLOAT, GL_FALSE, position),
+    ELEMENT(CompactSkinnedVertex, 1, 2, GL_SHORT, GL_TRUE, normal),
+    ELEMENT(CompactSkinnedVertex, 2, 2, GL_HALF_FLOAT, GL_FALSE, tex_coords),
+    INTEGER_ELEMENT(CompactSkinnedVertex, 5, 4, GL_SHORT, bone_ids),
+    ELEMENT(CompactSkinnedVertex, 6, 4, GL_UNSIGNED_BYTE, GL_TRUE, weights)
+};
+const size_t CompactSkinnedVertex::kNumElements = sizeof(kElements) / sizeof(kElements[0]);
+
+CompactSkinnedVertex CompactSkinnedVertex::Encode(const Vertex &vertex) {
+    CompactSkinnedVertex compact;
+    compact.position = vertex.Position;
+    EncodeOctahedral(vertex.Normal, compact.normal);
+    EncodeTexCoords(vertex.TexCoords, compact.tex_coords);
+    EncodeSkin(vertex, compact.bone_ids, compact.weights);
+    return compact;
+}
+
+const VertexElement CompactSkinnedTangentVertex::kElements[] = {
+    ELEMENT(CompactSkinnedTangentVertex, 0, 3, GL_FLOAT, GL_FALSE, position),
+    ELEMENT(CompactSkinnedTangentVertex, 1, 2, GL_SHORT, GL_TRUE, normal),
+    ELEMENT(CompactSkinnedTangentVertex, 2, 2, GL_HALF_FLOAT, GL_FALSE, tex_coords),
+    ELEMENT(CompactSkinnedTangentVertex, 3, 2, GL_SHORT, GL_TRUE, tangent),
+    ELEMENT(CompactSkinnedTangentVertex, 4, 2, GL_SHORT, GL_TRUE, bitangent),
+    INTEGER_ELEMENT(CompactSkinnedTangentVertex, 5, 4, GL_SHORT, bone_ids),
+    ELEMENT(CompactSkinnedTangentVertex, 6, 4, GL_UNSIGNED_BYTE, GL_TRUE, weights)
+};
+const size_t CompactSkinnedTangentVertex::kNumElements = sizeof(kElements) / sizeof(kElements[0]);
+
+CompactSkinnedTangentVertex CompactSkinnedTangentVertex::Encode(const Vertex &vertex) {
+    CompactSkinnedTangentVertex compact;
+    compact.position = vertex.Position;
+    EncodeOctahedral(vertex.Normal, compact.normal);
+    EncodeTexCoords(vertex.TexCoords, compact.tex_coords);
+    EncodeOctahedral(vertex.Tangent, compact.tangent);
+    EncodeOctahedral(vertex.Bitangent, compact.bitangent);
+    EncodeSkin(vertex, compact.bone_ids, compact.weights);
+    return compact;
+}
+
+#undef ELEMENT
+#undef INTEGER_ELEMENT
+
+// ----------- PUBLIC ----------- //
+eVertexLayout ChooseVertexLayout(unsigned int attributes) {
+    attributes &= VERTEX_ATTRIBUTES_ALL; // ignore per-instance and other non-mesh inputs
+    if ((attributes & ~PositionVertex::kAttributes) == 0)
+        return VERTEX_LAYOUT_POSITION;
+    if ((attributes & ~CompactVertex::kAttributes) == 0)
+        return VERTEX_LAYOUT_COMPACT;
+    if ((attributes & ~CompactTangentVertex::kAttributes) == 0)
+        return VERTEX_LAYOUT_COMPACT_TANGENT;
+    if ((attributes & ~CompactSkinnedVertex::kAttributes) == 0)
+        return VERTEX_LAYOUT_COMPACT_SKINNED;
+    return VERTEX_LAYOUT_COMPACT_SKINNED_TANGENT;
+}
+
+size_t GetVertexSize(eVertexLayout layout) {
+    switch (layout) {
+    case VERTEX_LAYOUT_POSITION: return sizeof(PositionVertex);
+    case VERTEX_LAYOUT_COMPACT: return sizeof(CompactVertex);
+    case VERTEX_LAYOUT_COMPACT_TANGENT: return sizeof(CompactTangentVertex);
+    case VERTEX_LAYOUT_COMPACT_SKINNED: return sizeof(CompactSkinnedVertex);
+    default: return sizeof(CompactSkinnedTangentVertex);
+    }
+}
+
+std::vector<unsigned char> EncodeVertices(eVertexLayout layout, const Vertex *vertices, size_t count) {
+    switch (layout) {
+    case VERTEX_LAYOUT_POSITION: return Encode<PositionVertex>(vertices, count);
+    case VERTEX_LAYOUT_COMPACT: return Encode<CompactVertex>(vertices, count);
+    case VERTEX_LAYOUT_COMPACT_TANGENT: return Encode<CompactTangentVertex>(vertices, count);
+    case VERTEX_LAYOUT_COMPACT_SKINNED: return Encode<CompactSkinnedVertex>(vertices, count);
+    default: return Encode<CompactSkinnedTangentVertex>(vertices, count);
+    }
+}
+
+void SetupVertexAttributes(eVertexLayout layout) {
+    switch (layout) {
+    case VERTEX_LAYOUT_POSITION: Setup<PositionVertex>(); break;
+    case VERTEX_LAYOUT_COMPACT: Setup<CompactVertex>(); break;
+    case VERTEX_LAYOUT_COMPACT_TANGENT: Setup<CompactTangentVertex>(); break;
+    case VERTEX_LAYOUT_COMPACT_SKINNED: Setup<CompactSkinnedVertex>(); break;
+    default: Setup<CompactSkinnedTangentVertex>(); break;
+    }
+}
+
+void SetupInstanceAttributes() {
+    // matrices are passed a column per location
+    for (GLuint column = 0; column < 4; column++) {
+        GLuint location = kInstanceModelLocation + column;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceTransform),
+                              (void*)(offsetof(InstanceTransform, model) + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+    }
+    for (GLuint column = 0; column < 3; column++) {
+        GLuint location = kInstanceNormalLocation + column;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceTransform),
+                              (void*)(offsetof(InstanceTransform, normal) + column * sizeof(glm::vec3)));
+        glVertexAttribDivisor(location, 1);
+    }
+}
+
+/*
+    Project onto the octahedron |x| + |y| + |z| = 1 and unfold the lower half
+    over the diagonals, giving a square parameterisation with nearly uniform
+    precision (under 0.05 degrees of error at 16 bits).
+*/
+void EncodeOctahedral(const glm::vec3 &v, int16_t out[2]) {
+    float l1 = std::fabs(v.x) + std::fabs(v.y) + std::fabs(v.z);
+    if (l1 == 0.0f) {
+        out[0] = out[1] = 0; // degenerate, decodes to +z
+        return;
+    }
+    glm::vec2 p(v.x / l1, v.y / l1);
+    if (v.z < 0.0f) {
+        glm::vec2 folded((1.0f - std::fabs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f),
+                         (1.0f - std::fabs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f));
+        p = folded;
+    }
+    out[0] = ToSnorm16(p.x);
+    out[1] = ToSnorm16(p.y);
+}
+
+glm::vec3 DecodeOctahedral(const int16_t in[2]) {
+    glm::vec2 p(std::max(in[0] / 32767.0f, -1.0f), std::max(in[1] / 32767.0f, -1.0f));
+    glm::vec3 v(p.x, p.y, 1.0f - std::fabs(p.x) - std::fabs(p.y));
+    if (v.z < 0.0f) {
+        v.x = (1.0f - std::fabs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f);
+        v.y = (1.0f - std::fabs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return glm::normalize(v);
+}
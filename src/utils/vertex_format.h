@@ -0,0 +1,150 @@
+#ifndef ISLAND_UTILS_VERTEX_FORMAT_H_
+#define ISLAND_UTILS_VERTEX_FORMAT_H_
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Vertex;
+
+/*
+    Compact gpu vertex layouts. Imported meshes keep the full 88 byte Vertex
+    on the cpu; at upload each mesh is packed into the smallest layout that
+    still has every attribute its shaders read:
+        position  3 x float
+        normal    octahedral, 2 x snorm16
+        uv        2 x half
+        tangent   octahedral tangent + bitangent, 4 x snorm16
+        skin      4 x int16 bone ids + 4 x unorm8 weights
+    Shaders decode normals (and tangents) with DecodeOctahedral(), which
+    Shader prepends to every vertex stage.
+*/
+
+// vertex shader inputs, one bit per attribute location
+enum eVertexAttribute {
+    VERTEX_ATTRIBUTE_POSITION     = 1 << 0,
+    VERTEX_ATTRIBUTE_NORMAL       = 1 << 1,
+    VERTEX_ATTRIBUTE_TEXCOORD     = 1 << 2,
+    VERTEX_ATTRIBUTE_TANGENT      = 1 << 3,
+    VERTEX_ATTRIBUTE_BITANGENT    = 1 << 4,
+    VERTEX_ATTRIBUTE_BONE_IDS     = 1 << 5,
+    VERTEX_ATTRIBUTE_BONE_WEIGHTS = 1 << 6,
+    VERTEX_ATTRIBUTES_ALL         = (1 << 7) - 1
+};
+
+// ordered smallest first
+enum eVertexLayout {
+    VERTEX_LAYOUT_POSITION,
+    VERTEX_LAYOUT_COMPACT,
+    VERTEX_LAYOUT_COMPACT_TANGENT,
+    VERTEX_LAYOUT_COMPACT_SKINNED,
+    VERTEX_LAYOUT_COMPACT_SKINNED_TANGENT,
+    NUM_VERTEX_LAYOUTS
+};
+
+// one glVertexAttrib(I)Pointer call
+struct VertexElement {
+    GLuint location;
+    GLint size;
+    GLenum type;
+    GLboolean normalized;
+    bool integer; // read as ivec in the shader
+    size_t offset;
+};
+
+struct PositionVertex {
+    glm::vec3 position;
+
+    static const unsigned int kAttributes = VERTEX_ATTRIBUTE_POSITION;
+    static const VertexElement kElements[];
+    static const size_t kNumElements;
+    static PositionVertex Encode(const Vertex &vertex);
+};
+
+struct CompactVertex {
+    glm::vec3 position;
+    int16_t normal[2];
+    uint16_t tex_coords[2];
+
+    static const unsigned int kAttributes = VERTEX_ATTRIBUTE_POSITION | VERTEX_ATTRIBUTE_NORMAL | VERTEX_ATTRIBUTE_TEXCOORD;
+    static const VertexElement kElements[];
+    static const size_t kNumElements;
+    static CompactVertex Encode(const Vertex &vertex);
+};
+
+struct CompactTangentVertex {
+    glm::vec3 position;
+    int16_t normal[2];
+    uint16_t tex_coords[2];
+    int16_t tangent[2];
+    int16_t bitangent[2];
+
+    static const unsigned int kAttributes = CompactVertex::kAttributes | VERTEX_ATTRIBUTE_TANGENT | VERTEX_ATTRIBUTE_BITANGENT;
+    static const VertexElement kElements[];
+    static const size_t kNumElements;
+    static CompactTangentVertex Encode(const Vertex &vertex);
+};
+
+struct CompactSkinnedVertex {
+    glm::vec3 position;
+    int16_t normal[2];
+    uint16_t tex_coords[2];
+    int16_t bone_ids[4];
+    uint8_t weights[4];
+
+    static const unsigned int kAttributes = CompactVertex::kAttributes | VERTEX_ATTRIBUTE_BONE_IDS | VERTEX_ATTRIBUTE_BONE_WEIGHTS;
+    static const VertexElement kElements[];
+    static const size_t kNumElements;
+    static CompactSkinnedVertex Encode(const Vertex &vertex);
+};
+
+struct CompactSkinnedTangentVertex {
+    glm::vec3 position;
+    int16_t normal[2];
+    uint16_t tex_coords[2];
+    int16_t tangent[2];
+    int16_t bitangent[2];
+    int16_t bone_ids[4];
+    uint8_t weights[4];
+
+    static const unsigned int kAttributes = VERTEX_ATTRIBUTES_ALL;
+    static const VertexElement kElements[];
+    static const size_t kNumElements;
+    static CompactSkinnedTangentVertex Encode(const Vertex &vertex);
+};
+
+// per-instance attributes of instanced draws. they sit above the vertex attribute locations, so shaders
+// reading them still pick their vertex layout from the eVertexAttribute bits alone.
+const GLuint kInstanceModelLocation = 7;   // mat4, locations 7-10
+const GLuint kInstanceNormalLocation = 11; // mat3, locations 11-13
+
+struct InstanceTransform {
+    glm::mat4 model;
+    glm::mat3 normal; // transpose(inverse(model))
+};
+
+// Smallest layout holding every attribute in attributes (an eVertexAttribute
+// mask, e.g. Shader::getVertexAttributes()).
+eVertexLayout ChooseVertexLayout(unsigned int attributes);
+
+size_t GetVertexSize(eVertexLayout layout);
+
+// Packs vertices into layout. The result is GetVertexSize(layout) * count bytes.
+std::vector<unsigned char> EncodeVertices(eVertexLayout layout, const Vertex *vertices, size_t count);
+
+// Enables and points the attributes of layout at the bound GL_ARRAY_BUFFER.
+// Call with the target vertex array bound.
+void SetupVertexAttributes(eVertexLayout layout);
+
+// Enables and points the per-instance attributes at the bound GL_ARRAY_BUFFER of InstanceTransforms,
+// advancing once per instance. Call with the target vertex array bound.
+void SetupInstanceAttributes();
+
+// Unit vector to octahedral coordinates in snorm16, and back.
+void EncodeOctahedral(const glm::vec3 &v, int16_t out[2]);
+glm::vec3 DecodeOctahedral(const int16_t in[2]);
+
+#endif // ISLAND_UTILS_VERTEX_FORMAT_H_
@@ -5,80 +5,286 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "core.h"
+#include "gl_state.h"
+#include "uniform_buffers.h"
 #include "water_frame_buffers.h"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 
 // ----------- PUBLIC ----------- // 
 /*
-    Initialize buffers.
+    Initialize buffers for the current screen size.
 */
-WaterFrameBuffers::WaterFrameBuffers() {
-    InitReflectionFrameBuffer();
-    InitRefractionFrameBuffer();
+WaterFrameBuffers::WaterFrameBuffers(eRefractionMode refraction_mode)
+    : refraction_mode(refraction_mode), scale(kWaterStartScale), screen_width(static_cast<int>(g_screen_width_p)),
+      screen_height(static_cast<int>(g_screen_height_p)), reflection(), refraction(), scene(), layered() {
+    AcquireTargets();
 }
 
 /* 
-    Free all resources - frame buffers, render buffers, and textures. 
+    Free all resources - frame buffers and textures, pooled ones included. 
 */
 void WaterFrameBuffers::CleanUp() {
-    // reflection data 
-    glDeleteFramebuffers(1, &refl_frame_buffer);
-    glDeleteTextures(1, &refl_texture);
-    glDeleteRenderbuffers(1, &refl_depth_buffer);
-    // refraction data
-    glDeleteFramebuffers(1, &refr_frame_buffer);
-    glDeleteTextures(1, &refr_texture);
-    glDeleteTextures(1, &refr_depth_texture);
+    ReleaseTargets();
+    for (Target &target : pool)
+        DestroyTarget(target);
+    pool.clear();
 }
 
-void WaterFrameBuffers::BindReflectionFrameBuffer() {
-    BindFrameBuffer(refl_frame_buffer, kReflectionWidth, kReflectionHeight);
+/*
+    Swap the targets for ones of the new screen size if it changed, then
+    take on the scale. Only the viewport and the uv scale depend on it, so
+    changing it costs nothing.
+*/
+bool WaterFrameBuffers::Update(float scale) {
+    this->scale = std::clamp(scale, kWaterMinScale, kWaterMaxScale);
+    int width = static_cast<int>(g_screen_width_p), height = static_cast<int>(g_screen_height_p);
+    if (width == screen_width && height == screen_height)
+        return false;
+    ReleaseTargets();
+    screen_width = width;
+    screen_height = height;
+    AcquireTargets();
+    return true;
 }
 
-void WaterFrameBuffers::BindRefractionFrameBuffer() {
-    BindFrameBuffer(refr_frame_buffer, kRefractionWidth, kRefractionHeight);
+void WaterFrameBuffers::BindReflectionFrameBuffer(const glm::vec4 &rect) {
+    BindScaledFrameBuffer(reflection, rect);
+}
+
+void WaterFrameBuffers::BindRefractionFrameBuffer(const glm::vec4 &rect) {
+    BindScaledFrameBuffer(refraction, rect);
 }
 
 void WaterFrameBuffers::UnbindCurrentFrameBuffer() {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0); // 0 is default frame buffer id 
+    glDisable(GL_SCISSOR_TEST);
+    g_gl_state.BindFramebuffer(GL_FRAMEBUFFER, 0); // 0 is default frame buffer id 
     glViewport(0, 0, g_screen_width_p, g_screen_height_p); // YOU WILL REMEMBER THIS BUG (p)
 }
 
+void WaterFrameBuffers::BindLayeredFrameBuffer(const glm::vec4 &rect) {
+    BindScaledFrameBuffer(layered, rect);
+}
+
+void WaterFrameBuffers::BindSceneFrameBuffer() {
+    if (refraction_mode == REFRACTION_MODE_MAIN_PASS)
+        BindFrameBuffer(scene.frame_buffer, scene.width, scene.height);
+    else
+        UnbindCurrentFrameBuffer();
+}
+
+/*
+    Downsample the scene into the part of the refraction frame buffer in
+    use: color filtered, depth nearest (depth can only be blitted
+    unfiltered). Both depth textures are made by
+    CreateDepthTextureAttachment(), so their formats match as blitting
+    requires. The scissor test applies to blits too, so only rect is
+    written; it is turned off again before the main pass goes on.
+*/
+void WaterFrameBuffers::CopySceneToRefraction(const glm::vec4 &rect) {
+    if (refraction_mode != REFRACTION_MODE_MAIN_PASS)
+        return;
+    glm::ivec2 size = GetDrawSize(refraction);
+    refraction.drawn_size = size;
+    g_gl_state.BindFramebuffer(GL_READ_FRAMEBUFFER, scene.frame_buffer);
+    g_gl_state.BindFramebuffer(GL_DRAW_FRAMEBUFFER, refraction.frame_buffer);
+    SetScissor(refraction, rect);
+    glBlitFramebuffer(0, 0, scene.width, scene.height, 0, 0, size.x, size.y, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBlitFramebuffer(0, 0, scene.width, scene.height, 0, 0, size.x, size.y, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glDisable(GL_SCISSOR_TEST);
+    g_gl_state.BindFramebuffer(GL_FRAMEBUFFER, scene.frame_buffer);
+}
+
+void WaterFrameBuffers::ResolveSceneFrameBuffer() {
+    if (refraction_mode == REFRACTION_MODE_MAIN_PASS) {
+        g_gl_state.BindFramebuffer(GL_READ_FRAMEBUFFER, scene.frame_buffer);
+        g_gl_state.BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, scene.width, scene.height, 0, 0, g_screen_width_p, g_screen_height_p, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+    UnbindCurrentFrameBuffer();
+}
+
+bool WaterFrameBuffers::SetRefractionMode(eRefractionMode refraction_mode) {
+    if (refraction_mode == this->refraction_mode)
+        return false;
+    ReleaseTargets();
+    this->refraction_mode = refraction_mode;
+    AcquireTargets();
+    return true;
+}
+
+eRefractionMode WaterFrameBuffers::GetRefractionMode() const {
+    return refraction_mode;
+}
+
 unsigned int WaterFrameBuffers::GetReflectionTexture() {
-    return refl_texture;
+    return refraction_mode == REFRACTION_MODE_LAYERED ? layered.texture : reflection.texture;
 }
 
 unsigned int WaterFrameBuffers::GetRefractionTexture() {
-    return refr_texture;
+    return refraction_mode == REFRACTION_MODE_LAYERED ? layered.texture : refraction.texture;
 }
 
 unsigned int WaterFrameBuffers::GetRefractionDepthTexture() {
-    return refr_depth_texture;
+    return refraction_mode == REFRACTION_MODE_LAYERED ? layered.depth_texture : refraction.depth_texture;
+}
+
+GLenum WaterFrameBuffers::GetTextureTarget() const {
+    return refraction_mode == REFRACTION_MODE_LAYERED ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+}
+
+glm::vec2 WaterFrameBuffers::GetReflectionUvScale() const {
+    return GetUvScale(refraction_mode == REFRACTION_MODE_LAYERED ? layered : reflection);
+}
+
+glm::vec2 WaterFrameBuffers::GetRefractionUvScale() const {
+    return GetUvScale(refraction_mode == REFRACTION_MODE_LAYERED ? layered : refraction);
+}
+
+glm::vec4 WaterFrameBuffers::GetReflectionUvBounds() const {
+    return GetUvBounds(refraction_mode == REFRACTION_MODE_LAYERED ? layered : reflection);
+}
+
+glm::vec4 WaterFrameBuffers::GetRefractionUvBounds() const {
+    return GetUvBounds(refraction_mode == REFRACTION_MODE_LAYERED ? layered : refraction);
 }
 
 // ----------- PRIVATE ----------- // 
-void WaterFrameBuffers::InitReflectionFrameBuffer() {
-    refl_frame_buffer = CreateFrameBuffer();
-    refl_texture = CreateTextureAttachment(kReflectionWidth, kReflectionHeight);
-    refl_depth_buffer = CreateDepthBufferAttachment(kReflectionWidth, kReflectionHeight);
-    // check that framebuffer is complete 
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        std::cerr << "Framebuffer not complete!" << std::endl;
+/*
+    Take the targets the refraction mode needs for the current screen
+    size. Every attachment of a layered frame buffer has to be layered, so
+    its depth is an array too; it is also what the water shader samples
+    for the refraction depth.
+*/
+void WaterFrameBuffers::AcquireTargets() {
+    int width = std::max(static_cast<int>(screen_width * kWaterMaxScale), 1);
+    int height = std::max(static_cast<int>(screen_height * kWaterMaxScale), 1);
+    if (refraction_mode == REFRACTION_MODE_LAYERED) {
+        layered = AcquireTarget(width, height, NUM_WATER_LAYERS);
+        return;
     }
-    UnbindCurrentFrameBuffer();
+    reflection = AcquireTarget(width, height, 0);
+    refraction = AcquireTarget(width, height, 0);
+    if (refraction_mode == REFRACTION_MODE_MAIN_PASS)
+        scene = AcquireTarget(screen_width, screen_height, 0);
+}
+
+void WaterFrameBuffers::ReleaseTargets() {
+    ReleaseTarget(reflection);
+    ReleaseTarget(refraction);
+    ReleaseTarget(scene);
+    ReleaseTarget(layered);
+}
+
+/*
+    Reuse a pooled target of the same size and layer count, or make one.
+*/
+WaterFrameBuffers::Target WaterFrameBuffers::AcquireTarget(int width, int height, int layers) {
+    for (size_t i = 0; i < pool.size(); i++) {
+        if (pool[i].width == width && pool[i].height == height && pool[i].layers == layers) {
+            Target target = pool[i];
+            pool.erase(pool.begin() + i);
+            return target;
+        }
+    }
+    return CreateTarget(width, height, layers);
+}
+
+/*
+    Hand a target to the pool, dropping the oldest pooled one when it is
+    full. Targets that were never made are skipped.
+*/
+void WaterFrameBuffers::ReleaseTarget(Target &target) {
+    if (target.frame_buffer == 0)
+        return;
+    if (pool.size() == kWaterTargetPoolSize) {
+        DestroyTarget(pool.front());
+        pool.erase(pool.begin());
+    }
+    target.drawn_size = glm::ivec2(0);
+    pool.push_back(target);
+    target = Target();
+}
+
+void WaterFrameBuffers::DestroyTarget(Target &target) {
+    g_gl_state.DeleteFramebuffer(target.frame_buffer);
+    g_gl_state.DeleteTexture(target.texture);
+    g_gl_state.DeleteTexture(target.depth_texture);
+    target = Target();
 }
 
-void WaterFrameBuffers::InitRefractionFrameBuffer() {
-    refr_frame_buffer = CreateFrameBuffer();
-    refr_texture = CreateTextureAttachment(kRefractionWidth, kRefractionHeight);
-    refr_depth_texture = CreateDepthTextureAttachment(kRefractionWidth, kRefractionHeight);
+WaterFrameBuffers::Target WaterFrameBuffers::CreateTarget(int width, int height, int layers) {
+    Target target = { 0, 0, 0, width, height, layers, glm::ivec2(0) };
+    target.frame_buffer = CreateFrameBuffer();
+    if (layers > 0) {
+        target.texture = CreateTextureArrayAttachment(width, height, layers);
+        target.depth_texture = CreateDepthTextureArrayAttachment(width, height, layers);
+    } else {
+        target.texture = CreateTextureAttachment(width, height);
+        target.depth_texture = CreateDepthTextureAttachment(width, height);
+    }
     // check that framebuffer is complete 
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
         std::cerr << "Framebuffer not complete!" << std::endl;
     }
     UnbindCurrentFrameBuffer();
+    return target;
+}
+
+/*
+    Targets are allocated at kWaterMaxScale, so the current scale draws
+    scale / kWaterMaxScale of them per side.
+*/
+glm::ivec2 WaterFrameBuffers::GetDrawSize(const Target &target) const {
+    float fraction = scale / kWaterMaxScale;
+    return glm::ivec2(std::max(static_cast<int>(std::lround(target.width * fraction)), 1),
+                      std::max(static_cast<int>(std::lround(target.height * fraction)), 1));
+}
+
+glm::vec2 WaterFrameBuffers::GetUvScale(const Target &target) const {
+    if (target.width == 0 || target.height == 0)
+        return glm::vec2(1.0f);
+    glm::ivec2 size = target.drawn_size.x > 0 ? target.drawn_size : GetDrawSize(target);
+    return glm::vec2(size) / glm::vec2(target.width, target.height);
+}
+
+/*
+    Texel centers of the first and last drawn texels. A draw is at least a
+    texel wide, so the bounds never cross.
+*/
+glm::vec4 WaterFrameBuffers::GetUvBounds(const Target &target) const {
+    if (target.width == 0 || target.height == 0)
+        return kWaterFullRect;
+    glm::ivec2 size = target.drawn_size.x > 0 ? target.drawn_size : GetDrawSize(target);
+    glm::vec2 texel = 1.0f / glm::vec2(target.width, target.height);
+    return glm::vec4(0.5f * texel, (glm::vec2(size) - 0.5f) * texel);
+}
+
+void WaterFrameBuffers::BindScaledFrameBuffer(Target &target, const glm::vec4 &rect) {
+    target.drawn_size = GetDrawSize(target);
+    BindFrameBuffer(target.frame_buffer, target.drawn_size.x, target.drawn_size.y);
+    SetScissor(target, rect);
+}
+
+/*
+    Widen rect by the shader's reach and a texel for bilinear filtering,
+    rounding outwards to whole pixels.
+*/
+void WaterFrameBuffers::SetScissor(const Target &target, const glm::vec4 &rect) {
+    glm::vec2 size = glm::vec2(target.drawn_size);
+    glm::vec2 min = glm::max(glm::vec2(rect.x, rect.y) - kWaterRectMargin, 0.0f) * size - 1.0f;
+    glm::vec2 max = glm::min(glm::vec2(rect.z, rect.w) + kWaterRectMargin, 1.0f) * size + 1.0f;
+    glm::ivec2 pixel_min = glm::max(glm::ivec2(glm::floor(min)), glm::ivec2(0));
+    glm::ivec2 pixel_max = glm::min(glm::ivec2(glm::ceil(max)), target.drawn_size);
+    if (pixel_min == glm::ivec2(0) && pixel_max == target.drawn_size) {
+        glDisable(GL_SCISSOR_TEST);
+        return;
+    }
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(pixel_min.x, pixel_min.y, std::max(pixel_max.x - pixel_min.x, 0), std::max(pixel_max.y - pixel_min.y, 0));
 }
 
 /*
@@ -86,8 +292,8 @@ void WaterFrameBuffers::InitRefractionFrameBuffer() {
     resolution to width x height. 
 */
 void WaterFrameBuffers::BindFrameBuffer(unsigned int frame_buffer, int width, int height) {
-    glBindTexture(GL_TEXTURE_2D, 0); // unbind any currently bound textures
-    glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer);
+    g_gl_state.BindTexture(GL_TEXTURE_2D, 0); // unbind the active unit's texture (skipped if nothing is bound)
+    g_gl_state.BindFramebuffer(GL_FRAMEBUFFER, frame_buffer);
     glViewport(0, 0, width, height);
 }
 
@@ -97,7 +303,7 @@ void WaterFrameBuffers::BindFrameBuffer(unsigned int frame_buffer, int width, in
 unsigned int WaterFrameBuffers::CreateFrameBuffer() {
     unsigned int frame_buffer;
     glGenFramebuffers(1, &frame_buffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer);
+    g_gl_state.BindFramebuffer(GL_FRAMEBUFFER, frame_buffer);
     glDrawBuffer(GL_COLOR_ATTACHMENT0); 
     return frame_buffer;
 }
@@ -109,7 +315,7 @@ unsigned int WaterFrameBuffers::CreateFrameBuffer() {
 unsigned int WaterFrameBuffers::CreateTextureAttachment(int width, int height) {
     unsigned int texture;
     glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    g_gl_state.BindTexture(GL_TEXTURE_2D, texture);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -124,7 +330,7 @@ unsigned int WaterFrameBuffers::CreateTextureAttachment(int width, int height) {
 unsigned int WaterFrameBuffers::CreateDepthTextureAttachment(int width, int height) {
     unsigned int texture;
     glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    g_gl_state.BindTexture(GL_TEXTURE_2D, texture);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, (void*)0);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -133,17 +339,32 @@ unsigned int WaterFrameBuffers::CreateDepthTextureAttachment(int width, int heig
 }
 
 /*
-    Creates a render buffer object that stores depth information. Binds 
-    the depth buffer to the currently active frame buffer. Returns the 
-    depth buffer id.
+    Creates a 2D texture array object with layers layers and binds all of
+    them to the currently active frame buffer. Returns the texture id.
 */
-unsigned int WaterFrameBuffers::CreateDepthBufferAttachment(int width, int height) {
-    unsigned int depth_buffer;
-    glGenRenderbuffers(1, &depth_buffer);
-    glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, width, height);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_buffer);
-    return depth_buffer;
+unsigned int WaterFrameBuffers::CreateTextureArrayAttachment(int width, int height, int layers) {
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    g_gl_state.BindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB, width, height, layers, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture, 0);
+    return texture;
 }
 
-
+/*
+    Creates a 2D depth texture array object with layers layers and binds
+    all of them to the currently active frame buffer. Returns the texture
+    id.
+*/
+unsigned int WaterFrameBuffers::CreateDepthTextureArrayAttachment(int width, int height, int layers) {
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    g_gl_state.BindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT, width, height, layers, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, (void*)0);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0);
+    return texture;
+}
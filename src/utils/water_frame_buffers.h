@@ -6,45 +6,158 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <cstddef>
+#include <vector>
+
+// where the refraction texture comes from
+enum eRefractionMode {
+    REFRACTION_MODE_RENDER,    // a pass of its own, clipped to below the water
+    REFRACTION_MODE_MAIN_PASS, // copied from the main pass's opaque scene, see CopySceneToRefraction()
+    REFRACTION_MODE_LAYERED,   // drawn in the same pass as the reflection, see BindLayeredFrameBuffer()
+    NUM_REFRACTION_MODES
+};
+
+const char *const kRefractionModeNames[NUM_REFRACTION_MODES] = { "render", "main pass", "layered" };
+
+// water targets are a fraction of the screen per side: allocated at the most, drawn at the frame's scale
+const float kWaterMinScale = 0.125f;
+const float kWaterMaxScale = 0.5f;
+const float kWaterStartScale = 0.25f;
+// gpu time the water passes are held to, see ResolutionController
+const float kWaterGpuBudgetMs = 1.5f;
+// released targets kept for reuse, e.g. for when a window goes back to its old size
+const size_t kWaterTargetPoolSize = 4;
+
+// part of a target to draw, as min xy and max xy in texture coordinates; this one is all of it
+const glm::vec4 kWaterFullRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+// how far past the surface's own texture coordinates the water shader samples (its summed distortion)
+const float kWaterRectMargin = 0.02f;
+
+/*
+    Render targets of the water. With REFRACTION_MODE_MAIN_PASS the main
+    pass draws into a screen sized scene frame buffer instead of the
+    default one; once its opaque draws are done, its color and depth are
+    downsampled into the refraction frame buffer, which saves drawing the
+    scene a second time from the same camera. The water shader then keeps
+    to what lies behind the water surface by depth. The scene is copied to
+    the default frame buffer by ResolveSceneFrameBuffer().
+
+    With REFRACTION_MODE_LAYERED, reflection and refraction are the two
+    layers (eWaterLayer) of one texture array at a single resolution, so a
+    geometry shader can route each triangle to both views by gl_Layer and
+    the scene is submitted once for the two of them. The texture getters
+    then all return the array, which is bound as GetTextureTarget().
+
+    The water targets follow the screen's aspect. They are allocated at
+    kWaterMaxScale of its size and drawn in their lower left corner at the
+    scale given to Update(), so the scale can change every frame without
+    reallocating; the water shader scales its texture coordinates to the
+    part last drawn (Get*UvScale()), which stays right for a target kept
+    from an earlier frame, and clamps them half a texel inside it
+    (Get*UvBounds()) so filtering never reads past it. When the screen size changes, the targets are
+    released to a small pool and ones of the new size are taken from it,
+    or made when it has none.
+
+    Draws into a target and copies to it can be limited to a rect, where
+    the water lands in it (see ProjectBox()): the scissor test crops the
+    clear, the draws and the copy to that rect, widened by
+    kWaterRectMargin and a texel for the shader's distortion and
+    filtering. The rest of the target is left as it was, as the water
+    shader never samples it.
+*/
 class WaterFrameBuffers {
 public:
-    WaterFrameBuffers();
+    WaterFrameBuffers(eRefractionMode refraction_mode = REFRACTION_MODE_RENDER);
 
     void CleanUp();
 
-    void BindReflectionFrameBuffer();
-    void BindRefractionFrameBuffer();
+    // follows the screen size, and sets the scale the water targets are drawn at until the next call.
+    // true if the targets were replaced, which leaves their contents undefined.
+    bool Update(float scale);
+
+    // the Bind*FrameBuffer() calls crop draws to rect until the frame buffer is unbound
+    void BindReflectionFrameBuffer(const glm::vec4 &rect = kWaterFullRect);
+    void BindRefractionFrameBuffer(const glm::vec4 &rect = kWaterFullRect);
     void UnbindCurrentFrameBuffer();
+    // both water views at once, REFRACTION_MODE_LAYERED only; rect covers both
+    void BindLayeredFrameBuffer(const glm::vec4 &rect = kWaterFullRect);
+
+    // frame buffer the main pass draws into: the scene frame buffer, or the default one when refraction
+    // has a pass of its own
+    void BindSceneFrameBuffer();
+    // fills rect of the refraction frame buffer from the scene frame buffer, which stays bound; no-op when
+    // refraction has a pass of its own
+    void CopySceneToRefraction(const glm::vec4 &rect = kWaterFullRect);
+    // copies the scene's color to the default frame buffer and binds that
+    void ResolveSceneFrameBuffer();
+
+    // swaps the targets for the ones refraction_mode needs, through the pool. true if the mode changed, which
+    // leaves the targets' contents undefined.
+    bool SetRefractionMode(eRefractionMode refraction_mode);
+    eRefractionMode GetRefractionMode() const;
 
     unsigned int GetReflectionTexture();
     unsigned int GetRefractionTexture();
     unsigned int GetRefractionDepthTexture();
+    // GL_TEXTURE_2D_ARRAY when layered, else GL_TEXTURE_2D
+    GLenum GetTextureTarget() const;
+
+    // part of each texture its last draw covered, in texture coordinates
+    glm::vec2 GetReflectionUvScale() const;
+    glm::vec2 GetRefractionUvScale() const;
+    // the same part less half a texel on every side, as min xy and max xy: a bilinear tap at coordinates
+    // clamped to it reads no texel outside the draw
+    glm::vec4 GetReflectionUvBounds() const;
+    glm::vec4 GetRefractionUvBounds() const;
 
 
 private:
-    const unsigned int kReflectionWidth = 320;
-    const unsigned int kReflectionHeight = 180;
+    // a frame buffer with color and depth textures, texture arrays when layers > 0
+    struct Target {
+        unsigned int frame_buffer;
+        unsigned int texture;
+        unsigned int depth_texture;
+        int width;
+        int height;
+        int layers;
+        glm::ivec2 drawn_size; // viewport of its last draw, zero if none yet
+    };
 
-    const unsigned int kRefractionWidth = 320;
-    const unsigned int kRefractionHeight = 720;
+    eRefractionMode refraction_mode;
+    float scale;
+    // screen size the targets were made for
+    int screen_width;
+    int screen_height;
 
-    unsigned int refl_frame_buffer;
-    unsigned int refl_texture;
-    unsigned int refl_depth_buffer;
+    Target reflection; // not layered
+    Target refraction; // not layered
+    Target scene;      // REFRACTION_MODE_MAIN_PASS only, at the screen's size
+    Target layered;    // REFRACTION_MODE_LAYERED only, in place of reflection and refraction
+    std::vector<Target> pool;
 
-    unsigned int refr_frame_buffer;
-    unsigned int refr_texture;
-    unsigned int refr_depth_texture;
+    void AcquireTargets();
+    void ReleaseTargets();
+    Target AcquireTarget(int width, int height, int layers);
+    void ReleaseTarget(Target &target);
+    void DestroyTarget(Target &target);
+    Target CreateTarget(int width, int height, int layers);
 
-    void InitReflectionFrameBuffer();
-    void InitRefractionFrameBuffer();
+    // size a water target is drawn at under the current scale
+    glm::ivec2 GetDrawSize(const Target &target) const;
+    // binds target with its viewport at the current scale, cropped to rect
+    void BindScaledFrameBuffer(Target &target, const glm::vec4 &rect);
+    // enables the scissor test on rect of target's last draw, or disables it if rect is all of it
+    void SetScissor(const Target &target, const glm::vec4 &rect);
+    glm::vec2 GetUvScale(const Target &target) const;
+    glm::vec4 GetUvBounds(const Target &target) const;
 
     void BindFrameBuffer(unsigned int frame_buffer, int width, int height);
 
     unsigned int CreateFrameBuffer();
     unsigned int CreateTextureAttachment(int width, int height);
     unsigned int CreateDepthTextureAttachment(int width, int height);
-    unsigned int CreateDepthBufferAttachment(int width, int height);
+    unsigned int CreateTextureArrayAttachment(int width, int height, int layers);
+    unsigned int CreateDepthTextureArrayAttachment(int width, int height, int layers);
 };
-    
-#endif // ISLAND_UTILS_WATER_FRAME_BUFFERS_H_
\ No newline at end of file
+
+#endif // ISLAND_UTILS_WATER_FRAME_BUFFERS_H_
@@ -0,0 +1,114 @@
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <iostream>
+
+#include "water_view_cache.h"
+
+namespace {
+
+const char *const kLayerNames[NUM_WATER_LAYERS] = { "reflection", "refraction" };
+
+} // namespace
+
+// ----------- PUBLIC ----------- //
+WaterViewCache::WaterViewCache(eRefractionMode refraction_mode, bool enabled)
+    : refraction_mode(refraction_mode), enabled(enabled), visible(true), frame(0), camera_position(0.0f), camera_front(0.0f, 0.0f, -1.0f),
+      views(), frame_stats(), last_stats(), total_stats() {
+    for (View &view : views)
+        view.view_projection = glm::mat4(1.0f);
+}
+
+void WaterViewCache::SetRefractionMode(eRefractionMode refraction_mode) {
+    this->refraction_mode = refraction_mode;
+}
+
+/*
+    A view is due on its turn of the round robin (each layer on its own
+    frame of the interval, or both on the first when layered), once the camera has moved too far from where
+    it was drawn, or if it has nothing valid to reproject. Invalidations
+    hold over frames without water, until the views are drawn again.
+*/
+void WaterViewCache::BeginFrame(const glm::vec3 &camera_position, const glm::vec3 &camera_front, bool visible, bool invalidate) {
+    this->camera_position = camera_position;
+    this->camera_front = glm::normalize(camera_front);
+    this->visible = visible;
+    // the layered views are drawn by one pass, so they share its turn
+    bool layered = refraction_mode == REFRACTION_MODE_LAYERED;
+    for (size_t i = 0; i < NUM_WATER_LAYERS; i++) {
+        eWaterLayer layer = static_cast<eWaterLayer>(i);
+        View &view = views[i];
+        if (invalidate)
+            view.valid = false;
+        view.drawn = false;
+        bool turn = frame % kWaterViewRefreshInterval == (layered ? 0 : i % kWaterViewRefreshInterval);
+        bool moved = view.valid && !turn && HasMoved(layer);
+        view.due = visible && (!enabled || !view.valid || turn || moved);
+        if (view.due && moved)
+            frame_stats.moved[i]++;
+    }
+    if (refraction_mode == REFRACTION_MODE_MAIN_PASS)
+        views[WATER_LAYER_REFRACTION].due = visible;
+    if (layered) {
+        bool due = views[WATER_LAYER_REFLECTION].due || views[WATER_LAYER_REFRACTION].due;
+        views[WATER_LAYER_REFLECTION].due = due;
+        views[WATER_LAYER_REFRACTION].due = due;
+    }
+}
+
+bool WaterViewCache::IsDue(eWaterLayer layer) const {
+    return views[layer].due;
+}
+
+void WaterViewCache::MarkDrawn(eWaterLayer layer, const glm::mat4 &view_projection) {
+    View &view = views[layer];
+    view.view_projection = view_projection;
+    view.camera_position = camera_position;
+    view.camera_front = camera_front;
+    view.valid = true;
+    view.drawn = true;
+}
+
+const glm::mat4 &WaterViewCache::GetViewProjection(eWaterLayer layer) const {
+    return views[layer].view_projection;
+}
+
+void WaterViewCache::EndFrame() {
+    for (size_t i = 0; i < NUM_WATER_LAYERS; i++)
+        (!visible ? frame_stats.hidden : views[i].drawn ? frame_stats.drawn : frame_stats.reprojected)[i]++;
+    frame++;
+
+    frame_stats.frames = 1;
+    last_stats = frame_stats;
+    total_stats.frames += frame_stats.frames;
+    for (size_t i = 0; i < NUM_WATER_LAYERS; i++) {
+        total_stats.drawn[i] += frame_stats.drawn[i];
+        total_stats.moved[i] += frame_stats.moved[i];
+        total_stats.reprojected[i] += frame_stats.reprojected[i];
+        total_stats.hidden[i] += frame_stats.hidden[i];
+    }
+    frame_stats = WaterViewCacheStats();
+}
+
+const WaterViewCacheStats &WaterViewCache::GetStats() const {
+    return last_stats;
+}
+
+void WaterViewCache::PrintStats() const {
+    if (total_stats.frames == 0)
+        return;
+    for (size_t i = 0; i < NUM_WATER_LAYERS; i++) {
+        std::cout << "WATER_VIEW_CACHE:: " << kLayerNames[i] << " over " << total_stats.frames << " frames: " << total_stats.drawn[i]
+                  << " drawn (" << total_stats.moved[i] << " early, camera moved), " << total_stats.reprojected[i] << " reprojected, "
+                  << total_stats.hidden[i] << " hidden" << std::endl;
+    }
+}
+
+// ----------- PRIVATE ----------- //
+bool WaterViewCache::HasMoved(eWaterLayer layer) const {
+    const View &view = views[layer];
+    if (glm::length(camera_position - view.camera_position) > kWaterViewMaxDistance)
+        return true;
+    float min_cos = std::cos(glm::radians(kWaterViewMaxAngle));
+    return glm::dot(camera_front, view.camera_front) < min_cos;
+}
@@ -0,0 +1,97 @@
+#ifndef ISLAND_UTILS_WATER_VIEW_CACHE_H_
+#define ISLAND_UTILS_WATER_VIEW_CACHE_H_
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "uniform_buffers.h"
+#include "water_frame_buffers.h"
+
+// frames between scheduled redraws of a water view; the views take turns, one per frame, except layered
+// ones, which are drawn together on the first frame of the interval
+const uint64_t kWaterViewRefreshInterval = 2;
+// camera travel and turn since a view was drawn past which reprojecting it shows, so it is redrawn early
+const float kWaterViewMaxDistance = 0.5f;
+const float kWaterViewMaxAngle = 5.0f; // degrees
+
+struct WaterViewCacheStats {
+    uint64_t frames;
+    uint64_t drawn[NUM_WATER_LAYERS];       // views drawn
+    uint64_t moved[NUM_WATER_LAYERS];       // of those, off their turn because the camera moved too far
+    uint64_t reprojected[NUM_WATER_LAYERS]; // views reused from an earlier frame
+    uint64_t hidden[NUM_WATER_LAYERS];      // views not needed, the water being out of sight
+};
+
+/*
+    Decides which water views (eWaterLayer) are drawn each frame, and
+    keeps the view projection each texture was last drawn with. Views are
+    drawn in turns on a round robin of kWaterViewRefreshInterval frames,
+    or early once the camera has moved or turned past the limits above;
+    in between, the water shader reprojects the surface into the stale
+    texture with its own view projection instead of the current one. That
+    is exact for the surface itself and off only by how much the scene
+    behind it moved against it, and a frame or so of sky color.
+
+    The refraction mode sets what can be skipped: with
+    REFRACTION_MODE_MAIN_PASS the refraction comes from the main pass for
+    the price of a blit, so it is always drawn; with
+    REFRACTION_MODE_LAYERED both views share one pass, so they also share
+    one turn of the round robin, and are drawn together whenever either is
+    due; in between, both are reprojected. A disabled cache draws every view
+    every frame, and no view is drawn while the water is out of sight.
+*/
+class WaterViewCache {
+public:
+    WaterViewCache(eRefractionMode refraction_mode, bool enabled = true);
+
+    // takes effect at the next BeginFrame(), which should invalidate the views
+    void SetRefractionMode(eRefractionMode refraction_mode);
+
+    // picks the views to draw this frame, none if the water is not visible; invalidate (e.g. after the
+    // targets were replaced) redraws all once it is
+    void BeginFrame(const glm::vec3 &camera_position, const glm::vec3 &camera_front, bool visible = true, bool invalidate = false);
+
+    // the view is to be drawn this frame
+    bool IsDue(eWaterLayer layer) const;
+    // the view was drawn this frame through view_projection
+    void MarkDrawn(eWaterLayer layer, const glm::mat4 &view_projection);
+
+    // view projection the layer's texture was last drawn with
+    const glm::mat4 &GetViewProjection(eWaterLayer layer) const;
+
+    // rolls the frame's counters over
+    void EndFrame();
+
+    // counts of the last finished frame
+    const WaterViewCacheStats &GetStats() const;
+    void PrintStats() const;
+
+private:
+    struct View {
+        glm::mat4 view_projection;
+        // camera when last drawn
+        glm::vec3 camera_position;
+        glm::vec3 camera_front;
+        bool valid; // drawn since the last invalidation
+        bool due;
+        bool drawn; // this frame
+    };
+
+    eRefractionMode refraction_mode;
+    bool enabled;
+    bool visible; // this frame
+    uint64_t frame;
+    glm::vec3 camera_position;
+    glm::vec3 camera_front;
+    View views[NUM_WATER_LAYERS];
+
+    WaterViewCacheStats frame_stats;
+    WaterViewCacheStats last_stats;
+    WaterViewCacheStats total_stats;
+
+    // the camera left the limits of layer's last draw
+    bool HasMoved(eWaterLayer layer) const;
+};
+
+#endif // ISLAND_UTILS_WATER_VIEW_CACHE_H_